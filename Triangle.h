@@ -2,6 +2,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <array>
+#include <cstring>
+#include <fstream>
+#include <memory>
 #include <vulkan/vulkan.h>
 #include "base/VulkanBase.h"
 #include <glm/glm.hpp>
@@ -10,8 +13,6 @@
 
 #define ENABLE_VALIDATION false 
 
-#define MAX_CONCURRENT_FRAMES 2
-
 class VulkanExample : public VulkanBase
 {
 public:
@@ -21,31 +22,23 @@ public:
 		float color[3];
 	};
 
-    // 匿名结构体，并且声明 vertices 为一个结构体变量
-    struct {
-        VkDeviceMemory memory;
-        VkBuffer buffer;
-    } vertices;
-
-    // Index buffer
-    struct {
-        VkDeviceMemory memory;
-        VkBuffer buffer;
-        uint32_t count;
-    } indices;
-
-    // Uniform buffer block object
-	struct UniformBuffer {
-		VkDeviceMemory memory;
-		VkBuffer buffer;
-		// The descriptor set stores the resources bound to the binding points in a shader
-		// It connects the binding points of the different shaders with the buffers and images used for those bindings
-		VkDescriptorSet descriptorSet;
-		// We keep a pointer to the mapped buffer, so we can easily update it's contents via a memcpy
-		uint8_t* mapped{ nullptr };
-	};
+    // Vertex and index data of all meshes share a single buffer, draws select their mesh with firstIndex and vertexOffset
+    vks::GeometryPool geometry;
+    vks::GeometryPool::Mesh triangle;
+    // The geometry is streamed in on the transfer queue, the triangle is drawn once the upload is ready
+    vks::UploadToken geometryUpload;
+
+    // Layout of mesh files loaded with --geometry, the header is followed by vertexCount vertices and indexCount uint32_t indices
+    struct GeometryFileHeader {
+        char magic[4];
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t reserved;
+    };
 
-    std::array<UniformBuffer, MAX_CONCURRENT_FRAMES> uniformBuffers;
+    // The descriptor set stores the resources bound to the binding points in a shader
+    // A single set with a dynamic uniform buffer binding covers the whole uniform ring, every draw selects its block with a dynamic offset
+    VkDescriptorSet descriptorSet;
 
     struct ShaderData {
 		glm::mat4 projectionMatrix;
@@ -55,23 +48,17 @@ public:
 
     VkPipelineLayout pipelineLayout;
 
-    VkPipeline pipeline;
+    // Looked up in the base class's pipeline state cache while recording, the pipeline is owned by the pipeline compiler
+    vks::PipelineBuilder pipelineState{ VK_NULL_HANDLE, VK_NULL_HANDLE };
 
     VkDescriptorSetLayout descriptorSetLayout;
-    
-    std::array<VkSemaphore, MAX_CONCURRENT_FRAMES> presentCompleteSemaphores;
-    std::array<VkSemaphore, MAX_CONCURRENT_FRAMES> renderCompleteSemaphores;
-
-    VkCommandPool commandPool;
-    std::array<VkCommandBuffer, MAX_CONCURRENT_FRAMES> commandBuffers;
-    std::array<VkFence, MAX_CONCURRENT_FRAMES> waitFences;
-
-    uint32_t currentFrame = 0;
 
     VulkanExample() : VulkanBase(ENABLE_VALIDATION)
     {
         title = "Triangle";
         settings.overlay = false;
+        // Every draw of every frame in flight gets its own block of shader data from the frame ring's uniform space
+        frameUniformCapacity = settings.drawCount * std::max<VkDeviceSize>(sizeof(ShaderData), vks::UniformRing::maxAlignment);
         camera.type = Camera::CameraType::lookat;
 		camera.setPosition(glm::vec3(0.0f, 0.0f, -2.5f));
 		camera.setRotation(glm::vec3(0.0f));
@@ -80,64 +67,17 @@ public:
 
     ~VulkanExample()
     {
-		vkDestroyPipeline(device, pipeline, nullptr);
+		// The compilation may still be using the layout
+		pipelineCompiler.wait();
 
-        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
-
-        vkDestroyBuffer(device, vertices.buffer, nullptr);
-		vkFreeMemory(device, vertices.memory, nullptr);
-
-        vkDestroyBuffer(device, indices.buffer, nullptr);
-		vkFreeMemory(device, indices.memory, nullptr);
-
-        for (uint32_t i = 0; i < MAX_CONCURRENT_FRAMES; i++)
-        {
-            vkDestroyFence(device, waitFences[i], nullptr);
-            vkDestroySemaphore(device, presentCompleteSemaphores[i], nullptr);
-            vkDestroySemaphore(device, renderCompleteSemaphores[i], nullptr);
-            vkDestroyBuffer(device, uniformBuffers[i].buffer, nullptr);
-            vkFreeMemory(device, uniformBuffers[i].memory, nullptr);
-        }
+        vkDestroyPipelineLayout(device, pipelineLayout, vks::HostAllocator::callbacks());
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, vks::HostAllocator::callbacks());
 
-    }
+        geometry.destroy();
 
-	void createSynchronizationPrimitives()
-    {
-        for (uint32_t i = 0; i < MAX_CONCURRENT_FRAMES; i++) {
-			
-			// Semaphores (Used for correct command ordering)
-			VkSemaphoreCreateInfo semaphoreCI{};
-			semaphoreCI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-			// Semaphore used to ensure that image presentation is complete before starting to submit again
-			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCI, nullptr, &presentCompleteSemaphores[i]));
-			// Semaphore used to ensure that all commands submitted have been finished before submitting the image to the queue
-			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCI, nullptr, &renderCompleteSemaphores[i]));
-
-			// Fences (Used to check draw command buffer completion)
-			VkFenceCreateInfo fenceCI{};
-			fenceCI.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-			// Create in signaled state so we don't wait on first render of each command buffer
-			fenceCI.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-			VK_CHECK_RESULT(vkCreateFence(device, &fenceCI, nullptr, &waitFences[i]));
-
-		}
+        vkDestroyDescriptorPool(device, descriptorPool, vks::HostAllocator::callbacks());
     }
 
-    void createCommandBuffers()
-	{
-		// All command buffers are allocated from a command pool
-		VkCommandPoolCreateInfo commandPoolCI{};
-		commandPoolCI.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-		commandPoolCI.queueFamilyIndex = swapChain.queueNodeIndex;
-		commandPoolCI.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-		VK_CHECK_RESULT(vkCreateCommandPool(device, &commandPoolCI, nullptr, &commandPool));
-
-		// Allocate one command buffer per max. concurrent frame from above pool
-		VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, MAX_CONCURRENT_FRAMES);
-		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, commandBuffers.data()));
-	}
-
     uint32_t  getMemoryTypeIndex(uint32_t typeBits, VkMemoryPropertyFlags properties)
     {
         // Iterate over all memory types available for the device used in this example
@@ -156,6 +96,21 @@ public:
         throw "Could not find a suitable memory type!";
     }
 
+    // Maps a mesh file, returns null if the file can't be read or isn't a mesh file
+    std::shared_ptr<vks::MappedFile> loadGeometryFile(const std::string& fileName, GeometryFileHeader* header)
+    {
+        std::shared_ptr<vks::MappedFile> file = std::make_shared<vks::MappedFile>();
+        if (!file->open(fileName) || (file->size() < sizeof(GeometryFileHeader))) {
+            return nullptr;
+        }
+        memcpy(header, file->data(), sizeof(GeometryFileHeader));
+        const uint64_t size = sizeof(GeometryFileHeader) + static_cast<uint64_t>(header->vertexCount) * sizeof(Vertex) + static_cast<uint64_t>(header->indexCount) * sizeof(uint32_t);
+        if ((memcmp(header->magic, "VKGM", 4) != 0) || (header->vertexCount == 0) || (file->size() < size)) {
+            return nullptr;
+        }
+        return file;
+    }
+
     void createVertexBuffer()
     {
         std::vector<Vertex> vertexBuffer{
@@ -164,151 +119,56 @@ public:
             { {  0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } }
         };
 
-        uint32_t vertexBufferSize = static_cast<uint32_t>(vertexBuffer.size() * sizeof(Vertex));
-
         std::vector<uint32_t> indexBuffer{ 0, 1, 2 };
-		indices.count = static_cast<uint32_t>(indexBuffer.size());
-		uint32_t indexBufferSize = indices.count * sizeof(uint32_t);
-
-        VkMemoryAllocateInfo memAlloc {};
-        memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        VkMemoryRequirements memReqs;
 
-        struct StagingBuffer {
-            VkDeviceMemory memory;
-            VkBuffer buffer;
-        };
+        if (!settings.geometryFile.empty())
+        {
+            // A missing file is written from the built-in geometry, so the file path can be tried without a mesh exporter
+            std::ifstream existing(settings.geometryFile, std::ios::binary);
+            if (!existing.is_open())
+            {
+                GeometryFileHeader header{ { 'V', 'K', 'G', 'M' }, static_cast<uint32_t>(vertexBuffer.size()), static_cast<uint32_t>(indexBuffer.size()), 0 };
+                std::ofstream output(settings.geometryFile, std::ios::binary);
+                output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                output.write(reinterpret_cast<const char*>(vertexBuffer.data()), vertexBuffer.size() * sizeof(Vertex));
+                output.write(reinterpret_cast<const char*>(indexBuffer.data()), indexBuffer.size() * sizeof(uint32_t));
+            }
+            existing.close();
 
-        struct {
-            StagingBuffer vertices;
-            StagingBuffer indices;
-        } stagingBuffers;
-
-        void* data;
-
-        VkBufferCreateInfo vertexBufferInfoCI {};
-        vertexBufferInfoCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        vertexBufferInfoCI.size = vertexBufferSize;
-        vertexBufferInfoCI.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT; 
-        VK_CHECK_RESULT(vkCreateBuffer(device, &vertexBufferInfoCI, nullptr, &stagingBuffers.vertices.buffer));
-        vkGetBufferMemoryRequirements(device, stagingBuffers.vertices.buffer, &memReqs);
-        memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = getMemoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &stagingBuffers.vertices.memory));
-        VK_CHECK_RESULT(vkMapMemory(device, stagingBuffers.vertices.memory, 0, memAlloc.allocationSize, 0, &data));
-		memcpy(data, vertexBuffer.data(), vertexBufferSize);
-		vkUnmapMemory(device, stagingBuffers.vertices.memory);
-        VK_CHECK_RESULT(vkBindBufferMemory(device, stagingBuffers.vertices.buffer, stagingBuffers.vertices.memory, 0));
-
-        vertexBufferInfoCI.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-        VK_CHECK_RESULT(vkCreateBuffer(device, &vertexBufferInfoCI, nullptr, &vertices.buffer));
-        vkGetBufferMemoryRequirements(device, vertices.buffer, &memReqs);
-        memAlloc.allocationSize = memReqs.size;
-        memAlloc.memoryTypeIndex = getMemoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-        VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &vertices.memory));
-        VK_CHECK_RESULT(vkBindBufferMemory(device, vertices.buffer, vertices.memory, 0));
-
-        // Index buffer
-		VkBufferCreateInfo indexbufferCI{};
-		indexbufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		indexbufferCI.size = indexBufferSize;
-		indexbufferCI.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		// Copy index data to a buffer visible to the host (staging buffer)
-		VK_CHECK_RESULT(vkCreateBuffer(device, &indexbufferCI, nullptr, &stagingBuffers.indices.buffer));
-		vkGetBufferMemoryRequirements(device, stagingBuffers.indices.buffer, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = getMemoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &stagingBuffers.indices.memory));
-		VK_CHECK_RESULT(vkMapMemory(device, stagingBuffers.indices.memory, 0, indexBufferSize, 0, &data));
-		memcpy(data, indexBuffer.data(), indexBufferSize);
-		vkUnmapMemory(device, stagingBuffers.indices.memory);
-		VK_CHECK_RESULT(vkBindBufferMemory(device, stagingBuffers.indices.buffer, stagingBuffers.indices.memory, 0));
-
-        	// Create destination buffer with device only visibility
-		indexbufferCI.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-		VK_CHECK_RESULT(vkCreateBuffer(device, &indexbufferCI, nullptr, &indices.buffer));
-		vkGetBufferMemoryRequirements(device, indices.buffer, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = getMemoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &indices.memory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device, indices.buffer, indices.memory, 0));
-
-        VkCommandBuffer copyCmd;
-
-        VkCommandBufferAllocateInfo cmdBufAllocateInfo{};
-        cmdBufAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        cmdBufAllocateInfo.commandPool = commandPool;
-        cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        cmdBufAllocateInfo.commandBufferCount = 1;
-        VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &copyCmd));
-
-        VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-        VK_CHECK_RESULT(vkBeginCommandBuffer(copyCmd, &cmdBufInfo));
-
-        VkBufferCopy copyRegion{};
-
-        copyRegion.size = vertexBufferSize;
-        vkCmdCopyBuffer(copyCmd, stagingBuffers.vertices.buffer, vertices.buffer, 1, &copyRegion);
-
-        copyRegion.size = indexBufferSize;
-        vkCmdCopyBuffer(copyCmd, stagingBuffers.indices.buffer, indices.buffer, 1, &copyRegion);
-        VK_CHECK_RESULT(vkEndCommandBuffer(copyCmd));
-
-        VkSubmitInfo submitInfo{};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &copyCmd;
-
-        VkFenceCreateInfo fenceCI{};
-        fenceCI.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceCI.flags = 0;
-        VkFence fence;
-        VK_CHECK_RESULT(vkCreateFence(device, &fenceCI, nullptr, &fence));
-        VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
-        VK_CHECK_RESULT(vkWaitForFences(device, 1, &fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
-
-        vkDestroyFence(device, fence, nullptr);
-        vkFreeCommandBuffers(device, commandPool, 1, &copyCmd);
-
-        vkDestroyBuffer(device, stagingBuffers.vertices.buffer, nullptr);
-        vkFreeMemory(device, stagingBuffers.vertices.memory, nullptr);
-        vkDestroyBuffer(device, stagingBuffers.indices.buffer, nullptr);
-        vkFreeMemory(device, stagingBuffers.indices.memory,  nullptr);
-        
-    }
+            GeometryFileHeader header;
+            std::shared_ptr<vks::MappedFile> file = loadGeometryFile(settings.geometryFile, &header);
+            if (file)
+            {
+                geometry.create(vulkanDevice, sizeof(Vertex), header.vertexCount, header.indexCount);
+                // The vertex and index data go from the file's pages to the pool without being read into heap memory,
+                // if the device imports the mapped pages they aren't even written into the staging ring
+                vks::UploadBatch uploads(asyncUploader.stagingRing, asyncUploader.dstQueueFamilyIndex);
+                const VkDeviceSize vertexDataOffset = sizeof(GeometryFileHeader);
+                const VkDeviceSize indexDataOffset = vertexDataOffset + static_cast<VkDeviceSize>(header.vertexCount) * sizeof(Vertex);
+                geometry.add(fileUploader, uploads, file, vertexDataOffset, header.vertexCount, indexDataOffset, header.indexCount, &triangle);
+                geometryUpload = asyncUploader.submit(uploads);
+                // The file stays mapped (and its pages imported) until the upload has finished
+                fileUploader.retire(geometryUpload);
+                return;
+            }
+            std::cerr << "Could not load geometry file \"" << settings.geometryFile << "\", using the built-in geometry" << "\n";
+        }
 
-    void createUniformBuffers()
-    {
-        VkMemoryRequirements memReqs;
-
-        VkBufferCreateInfo bufferInfo{};
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.pNext = nullptr;
-        allocInfo.allocationSize = 0;
-        allocInfo.memoryTypeIndex = 0;
-
-        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferInfo.size = sizeof(ShaderData);
-        bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-
-        for (uint32_t i = 0; i < MAX_CONCURRENT_FRAMES; i++) {
-            VK_CHECK_RESULT(vkCreateBuffer(device, &bufferInfo, nullptr, &uniformBuffers[i].buffer));
-            vkGetBufferMemoryRequirements(device, uniformBuffers[i].buffer, &memReqs);
-            allocInfo.allocationSize = memReqs.size;
-            allocInfo.memoryTypeIndex = getMemoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-            VK_CHECK_RESULT(vkAllocateMemory(device, &allocInfo, nullptr, &(uniformBuffers[i].memory)));
-            VK_CHECK_RESULT(vkBindBufferMemory(device, uniformBuffers[i].buffer, uniformBuffers[i].memory, 0));
-            VK_CHECK_RESULT(vkMapMemory(device, uniformBuffers[i].memory, 0 , sizeof(ShaderData), 0, (void**)&uniformBuffers[i].mapped));
+        // A single device local buffer for the geometry, sized for the one mesh of this example
+        geometry.create(vulkanDevice, sizeof(Vertex), static_cast<uint32_t>(vertexBuffer.size()), static_cast<uint32_t>(indexBuffer.size()));
 
-        }
+        // The data is written straight into the uploader's persistently mapped staging ring, both copies go out in a single submission
+        // on the transfer queue (if the device has a dedicated one), the pool's buffer is shared with the graphics queue family
+        vks::UploadBatch uploads(asyncUploader.stagingRing, asyncUploader.dstQueueFamilyIndex);
+        geometry.add(uploads, vertexBuffer.data(), static_cast<uint32_t>(vertexBuffer.size()), indexBuffer.data(), static_cast<uint32_t>(indexBuffer.size()), &triangle);
+        // Nothing waits for the upload, the first frame submitted after it has finished takes it over (see AsyncUploader::acquire)
+        geometryUpload = asyncUploader.submit(uploads);
     }
 
     void createDescriptorSetLayout()
     {
         VkDescriptorSetLayoutBinding layoutBinding{};
-        layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         layoutBinding.descriptorCount = 1;
         layoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
         layoutBinding.pImmutableSamplers = nullptr;
@@ -318,7 +178,7 @@ public:
         descriptorLayoutCI.pNext = nullptr;
         descriptorLayoutCI.bindingCount = 1;
         descriptorLayoutCI.pBindings = &layoutBinding;
-        VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayout));
+        VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutCI, vks::HostAllocator::callbacks(), &descriptorSetLayout));
 
         VkPipelineLayoutCreateInfo pipelineLayoutCI{};
         pipelineLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -326,14 +186,14 @@ public:
         pipelineLayoutCI.setLayoutCount = 1;
         pipelineLayoutCI.pSetLayouts = &descriptorSetLayout;
         
-        VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+        VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, vks::HostAllocator::callbacks(), &pipelineLayout));
     }
 
     void createDescriptorPool()
     {
         VkDescriptorPoolSize descriptorTypeCounts[1];
-        descriptorTypeCounts[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptorTypeCounts[0].descriptorCount = MAX_CONCURRENT_FRAMES;
+        descriptorTypeCounts[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        descriptorTypeCounts[0].descriptorCount = 1;
 
 		VkDescriptorPoolCreateInfo descriptorPoolCI{};
 		descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -341,206 +201,56 @@ public:
         descriptorPoolCI.poolSizeCount = 1;
         descriptorPoolCI.pPoolSizes = descriptorTypeCounts;
 
-        descriptorPoolCI.maxSets = MAX_CONCURRENT_FRAMES;
-        VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCI, nullptr, &descriptorPool));
+        descriptorPoolCI.maxSets = 1;
+        VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCI, vks::HostAllocator::callbacks(), &descriptorPool));
 
     }
 
     void createDescriptorSets()
     {
-        for (uint32_t i = 0; i < MAX_CONCURRENT_FRAMES; i++)
-        {
-            VkDescriptorSetAllocateInfo allocInfo{};
-            allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-            allocInfo.descriptorPool = descriptorPool;
-            allocInfo.descriptorSetCount = 1;
-            allocInfo.pSetLayouts = &descriptorSetLayout;
-            VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &uniformBuffers[i].descriptorSet));
-
-            VkWriteDescriptorSet writeDescriptorSet{};
-
-            VkDescriptorBufferInfo bufferInfo{};
-            bufferInfo.buffer = uniformBuffers[i].buffer;
-            bufferInfo.range = sizeof(ShaderData);
-
-            writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            writeDescriptorSet.dstSet = uniformBuffers[i].descriptorSet;
-            writeDescriptorSet.descriptorCount = 1;
-            writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            writeDescriptorSet.pBufferInfo = &bufferInfo;
-            writeDescriptorSet.dstBinding = 0;
-            vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
-
-        }
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &descriptorSetLayout;
+        VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+        updateDescriptorSets();
     }
 
-    VkShaderModule loadSPIRVShader(std::string filename)
-	{
-		size_t shaderSize;
-		char* shaderCode{ nullptr };
-
-#if defined(__ANDROID__)
-		// Load shader from compressed asset
-		AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
-		assert(asset);
-		shaderSize = AAsset_getLength(asset);
-		assert(shaderSize > 0);
-
-		shaderCode = new char[shaderSize];
-		AAsset_read(asset, shaderCode, shaderSize);
-		AAsset_close(asset);
-#else
-		std::ifstream is(filename, std::ios::binary | std::ios::in | std::ios::ate);
-
-		if (is.is_open())
-		{
-			shaderSize = is.tellg();
-			is.seekg(0, std::ios::beg);
-			// Copy file contents into a buffer
-			shaderCode = new char[shaderSize];
-			is.read(shaderCode, shaderSize);
-			is.close();
-			assert(shaderSize > 0);
-		}
-#endif
-		if (shaderCode)
-		{
-			// Create a new shader module that will be used for pipeline creation
-			VkShaderModuleCreateInfo shaderModuleCI{};
-			shaderModuleCI.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-			shaderModuleCI.codeSize = shaderSize;
-			shaderModuleCI.pCode = (uint32_t*)shaderCode;
-
-			VkShaderModule shaderModule;
-			VK_CHECK_RESULT(vkCreateShaderModule(device, &shaderModuleCI, nullptr, &shaderModule));
-
-			delete[] shaderCode;
-
-			return shaderModule;
-		}
-		else
-		{
-			std::cerr << "Error: Could not open shader file \"" << filename << "\"" << std::endl;
-			return VK_NULL_HANDLE;
-		}
-	}
+    void updateDescriptorSets()
+    {
+        // The shader sees one ShaderData block at whatever dynamic offset is passed when binding the set
+        VkDescriptorBufferInfo bufferInfo = frameRing.uniforms.descriptor(sizeof(ShaderData));
+
+        VkWriteDescriptorSet writeDescriptorSet{};
+        writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSet.dstSet = descriptorSet;
+        writeDescriptorSet.descriptorCount = 1;
+        writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        writeDescriptorSet.pBufferInfo = &bufferInfo;
+        writeDescriptorSet.dstBinding = 0;
+        vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+    }
 
     void createPipelines() 
     {
-        VkGraphicsPipelineCreateInfo pipelineCI{};
-        pipelineCI.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        pipelineCI.layout = pipelineLayout;
-        pipelineCI.renderPass = renderPass;
-
-        VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI{};
-        inputAssemblyStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-        inputAssemblyStateCI.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-
-        VkPipelineRasterizationStateCreateInfo rasterizationStateCI{};
-        rasterizationStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-        rasterizationStateCI.polygonMode = VK_POLYGON_MODE_LINE;
-        rasterizationStateCI.cullMode = VK_CULL_MODE_NONE;
-        rasterizationStateCI.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-        rasterizationStateCI.depthClampEnable = VK_FALSE;
-        rasterizationStateCI.rasterizerDiscardEnable = VK_FALSE;
-        rasterizationStateCI.depthBiasEnable = VK_FALSE;
-        rasterizationStateCI.lineWidth = 1.0f;
-
-        VkPipelineColorBlendAttachmentState blendAttachmentState{};
-        blendAttachmentState.colorWriteMask = 0Xf;
-        blendAttachmentState.blendEnable = VK_FALSE;
-        
-        VkPipelineColorBlendStateCreateInfo colorBlendStateCI{};
-        colorBlendStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-        colorBlendStateCI.attachmentCount = 1;
-        colorBlendStateCI.pAttachments = &blendAttachmentState;
-
-        VkPipelineViewportStateCreateInfo viewportStateCI{};
-        viewportStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-        viewportStateCI.viewportCount = 1;
-        viewportStateCI.scissorCount = 1;
-
-        std::vector<VkDynamicState> dynamicStateEnable;
-        dynamicStateEnable.push_back(VK_DYNAMIC_STATE_VIEWPORT);
-        dynamicStateEnable.push_back(VK_DYNAMIC_STATE_SCISSOR);
-        VkPipelineDynamicStateCreateInfo dynamicStateCI{};
-        dynamicStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-        dynamicStateCI.pDynamicStates = dynamicStateEnable.data();
-        dynamicStateCI.dynamicStateCount = static_cast<uint32_t>(dynamicStateEnable.size());
-
-        VkPipelineDepthStencilStateCreateInfo depthStencilStateCI{};
-        depthStencilStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-        depthStencilStateCI.depthTestEnable = VK_TRUE;
-        depthStencilStateCI.depthWriteEnable = VK_TRUE;
-        depthStencilStateCI.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-        depthStencilStateCI.depthBoundsTestEnable = VK_FALSE;
-        depthStencilStateCI.back.failOp = VK_STENCIL_OP_KEEP;
-        depthStencilStateCI.back.passOp = VK_STENCIL_OP_KEEP;
-        depthStencilStateCI.back.compareOp = VK_COMPARE_OP_ALWAYS;
-        depthStencilStateCI.stencilTestEnable = VK_FALSE;
-        depthStencilStateCI.front = depthStencilStateCI.back;
-
-        VkPipelineMultisampleStateCreateInfo multisampleStateCI{};
-        multisampleStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-        multisampleStateCI.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-        multisampleStateCI.pSampleMask = nullptr;
-
-        VkVertexInputBindingDescription vertexInputBinding{};
-        vertexInputBinding.binding = 0;
-        vertexInputBinding.stride = sizeof(Vertex);
-        vertexInputBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-        std::array<VkVertexInputAttributeDescription, 2> vertexInputAttributs;
-        
-        vertexInputAttributs[0].binding = 0;
-        vertexInputAttributs[0].location = 0;
-        vertexInputAttributs[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-        vertexInputAttributs[0].offset = offsetof(Vertex, position);
-
-        vertexInputAttributs[1].binding = 0;
-        vertexInputAttributs[1].location = 1;
-        vertexInputAttributs[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-        vertexInputAttributs[1].offset = offsetof(Vertex, color);
-
-        VkPipelineVertexInputStateCreateInfo vertexInputStateCI{};
-        vertexInputStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vertexInputStateCI.vertexBindingDescriptionCount = 1;
-        vertexInputStateCI.pVertexBindingDescriptions = &vertexInputBinding;
-        vertexInputStateCI.vertexAttributeDescriptionCount = 2;
-        vertexInputStateCI.pVertexAttributeDescriptions = vertexInputAttributs.data();
-
-        std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{};
-
-        shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-        shaderStages[0].module = loadSPIRVShader(getShadersPath() + "triangle/triangle.vert.spv");
-        shaderStages[0].pName = "main";
-        assert(shaderStages[0].module != VK_NULL_HANDLE);
-
-        shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        shaderStages[1].module = loadSPIRVShader(getShadersPath() + "triangle/triangle.frag.spv");
-        shaderStages[1].pName = "main";
-        assert(shaderStages[1].module != VK_NULL_HANDLE);
-
-        pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
-        pipelineCI.pStages = shaderStages.data();
-        
-        pipelineCI.pVertexInputState = &vertexInputStateCI;
-        pipelineCI.pInputAssemblyState = &inputAssemblyStateCI;
-        pipelineCI.pRasterizationState = &rasterizationStateCI;
-        pipelineCI.pColorBlendState = &colorBlendStateCI;
-        pipelineCI.pMultisampleState = &multisampleStateCI;
-        pipelineCI.pViewportState = &viewportStateCI;
-        pipelineCI.pDepthStencilState = &depthStencilStateCI;
-        pipelineCI.pDynamicState = &dynamicStateCI;
-
-        VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
-
-        vkDestroyShaderModule(device, shaderStages[0].module, nullptr); 
-        vkDestroyShaderModule(device, shaderStages[1].module, nullptr); 
-
-
+        // Shared through the base class's shader module cache, their modules are only created if the pipeline isn't in the pipeline cache
+        const vks::ShaderId vertexShader = loadShaderDeferred(getShadersPath() + "triangle/triangle.vert.spv");
+        const vks::ShaderId fragmentShader = loadShaderDeferred(getShadersPath() + "triangle/triangle.frag.spv");
+
+        // Wireframe triangles with depth test, the defaults cover the rest (one opaque color attachment, dynamic viewport and scissor)
+        pipelineState = vks::PipelineBuilder(pipelineLayout, renderPass);
+        pipelineState
+            .shaderStage(VK_SHADER_STAGE_VERTEX_BIT, vertexShader)
+            .shaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShader)
+            .vertexBinding(0, sizeof(Vertex))
+            .vertexAttribute(0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position))
+            .vertexAttribute(1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color))
+            .rasterization(VK_POLYGON_MODE_LINE, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE)
+            .depthStencil(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+
+        // Compiled on a worker thread, frames are recorded without the triangle until it's ready
+        pipelineStates.request(pipelineState);
     }
     void setupFrameBuffer()
     {
@@ -564,7 +274,7 @@ public:
             frameBufferCI.height = height;
             frameBufferCI.layers = 1;
             // Create the framebuffer
-            VK_CHECK_RESULT(vkCreateFramebuffer(device, &frameBufferCI, nullptr, &frameBuffers[i]));
+            VK_CHECK_RESULT(vkCreateFramebuffer(device, &frameBufferCI, vks::HostAllocator::callbacks(), &frameBuffers[i]));
         }
     }
 
@@ -583,13 +293,13 @@ public:
         attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;                 // We don't use stencil, so don't care for load
         attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;               // Same for store
         attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;                       // Layout at render pass start. Initial doesn't matter, so we use undefined
-        attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;                   // Layout to which the attachment is transitioned when the render pass is finished
-                                                                                        // As we want to present the color buffer to the swapchain, we transition to PRESENT_KHR
+        attachments[0].finalLayout = swapChain.presentLayout();                         // Layout to which the attachment is transitioned when the render pass is finished
+                                                                                        // As we want to present the color buffer to the swapchain, we transition to PRESENT_KHR (TRANSFER_SRC when rendering offscreen)
         // Depth attachment
         attachments[1].format = depthFormat;                                           // A proper depth format is selected in the example base
         attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
         attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;                           // Clear depth at start of first subpass
-        attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;                     // We don't need depth after render pass has finished (DONT_CARE may result in better performance)
+        attachments[1].storeOp = vks::tools::attachmentStoreOp(depthStencil.usage);     // Depth isn't needed after the render pass unless the image is used otherwise (DONT_CARE saves the write back to memory)
         attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;                // No stencil
         attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;              // No Stencil
         attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;                      // Layout at render pass start. Initial doesn't matter, so we use undefined
@@ -651,16 +361,13 @@ public:
         renderPassCI.pSubpasses = &subpassDescription;                             // Description of that subpass
         renderPassCI.dependencyCount = static_cast<uint32_t>(dependencies.size()); // Number of subpass dependencies
         renderPassCI.pDependencies = dependencies.data();                          // Subpass dependencies used by the render pass
-        VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCI, nullptr, &renderPass));
+        VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCI, vks::HostAllocator::callbacks(), &renderPass));
     }
    
     void prepare()
     {
         VulkanBase::prepare();
-        createSynchronizationPrimitives();
-        createCommandBuffers();
         createVertexBuffer();
-    	createUniformBuffers();
         createDescriptorSetLayout();
         createDescriptorPool();
 		createDescriptorSets();
@@ -669,37 +376,30 @@ public:
 
     }
 
+    void framesInFlightChanged()
+    {
+        // The descriptor set points at the old ring's uniform buffer (the device is idle at this point)
+        updateDescriptorSets();
+    }
+
     virtual void render()
     {
         if (!prepared)
         {
             return;
         }
-        vkWaitForFences(device, 1, &waitFences[currentFrame], VK_TRUE, UINT64_MAX);
-
-        uint32_t imageIndex;
-        VkResult result = vkAcquireNextImageKHR(device, swapChain.swapChain, UINT64_MAX, presentCompleteSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
-        if (result == VK_ERROR_OUT_OF_DATE_KHR)
+        // Waits for the frame ring slot and acquires the next swap chain image into currentBuffer
+        if (!prepareFrame())
         {
-            /* windowResize();*/
             return;
         }
-        else if (result != VK_SUCCESS && (result != VK_SUBOPTIMAL_KHR)) {
-            throw "Could not acquire the next swap chian image";
-        }
-
-        ShaderData shaderData{};
-        shaderData.projectionMatrix = camera.matrices.perspective;
-        shaderData.viewMatrix = camera.matrices.view;
-        shaderData.modelMatrix = glm::mat4(1.0f);
-
-        memcpy(uniformBuffers[currentBuffer].mapped, &shaderData, sizeof(shaderData));
-        VK_CHECK_RESULT(vkResetFences(device, 1, &waitFences[currentFrame]));
 
-        vkResetCommandBuffer(commandBuffers[currentBuffer], 0);
+        VkCommandBuffer commandBuffer = frameRing.current().commandBuffer;
 
+        // The command buffer comes from the frame's transient pool, which was reset as a whole once the frame's fence signaled
         VkCommandBufferBeginInfo cmdBufInfo{};
         cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
         VkClearValue clearValues[2];
         clearValues[0].color = { {0.0f, 0.0f, 0.2f, 1.0f} };
@@ -715,65 +415,87 @@ public:
         renderPassBeginInfo.renderArea.extent.height = height;
         renderPassBeginInfo.clearValueCount = 2;
         renderPassBeginInfo.pClearValues = clearValues;
-        renderPassBeginInfo.framebuffer = frameBuffers[imageIndex];
-        VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffers[currentBuffer], &cmdBufInfo));
-
-        vkCmdBeginRenderPass(commandBuffers[currentBuffer], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-        VkViewport viewport{};
-        viewport.height = (float)height;
-        viewport.width = (float)width;
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-        vkCmdSetViewport(commandBuffers[currentBuffer], 0, 1, &viewport);
-
-        VkRect2D scissor{};
-        scissor.extent.width = width;
-        scissor.extent.height = height;
-        scissor.offset.x = 0;
-        scissor.offset.y = 0;
-
-        vkCmdSetScissor(commandBuffers[currentBuffer], 0, 1, &scissor);
-        vkCmdBindDescriptorSets(commandBuffers[currentBuffer], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &uniformBuffers[currentBuffer].descriptorSet, 0, nullptr);
-        vkCmdBindPipeline(commandBuffers[currentBuffer], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-        VkDeviceSize offsets[1]{ 0 };
-        vkCmdBindVertexBuffers(commandBuffers[currentBuffer], 0, 1, &vertices.buffer, offsets);
-        vkCmdBindIndexBuffer(commandBuffers[currentBuffer], indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-
-        vkCmdDrawIndexed(commandBuffers[currentBuffer], indices.count, 1, 0, 0, 1);
-        vkCmdEndRenderPass(commandBuffers[currentBuffer]);
-
-        VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffers[currentBuffer]));
-
-        VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.pWaitDstStageMask = &waitStageMask;               // Pointer to the list of pipeline stages that the semaphore waits will occur at
-        submitInfo.waitSemaphoreCount = 1;                           // One wait semaphore
-        submitInfo.signalSemaphoreCount = 1;                         // One signal semaphore
-        submitInfo.pCommandBuffers = &commandBuffers[currentBuffer]; // Command buffers(s) to execute in this batch (submission)
-        submitInfo.commandBufferCount = 1;
-
-        submitInfo.pWaitSemaphores = &presentCompleteSemaphores[currentFrame];
-        submitInfo.pSignalSemaphores = &renderCompleteSemaphores[currentFrame];
-
-        VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, waitFences[currentFrame]));
-
-        VkPresentInfoKHR presentInfo{};
-        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-        presentInfo.waitSemaphoreCount = 1;
-        presentInfo.pWaitSemaphores = &renderCompleteSemaphores[currentFrame];
-        presentInfo.swapchainCount = 1;
-        presentInfo.pSwapchains = &swapChain.swapChain;
-        presentInfo.pImageIndices = &imageIndex;
-        result = vkQueuePresentKHR(queue, &presentInfo);
-
-        if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
-            //windowResize();
-        }
-        else if (result != VK_SUCCESS) {
-            throw "Could not present the image to the swap chain!";
+        renderPassBeginInfo.framebuffer = frameBuffers[currentBuffer];
+        VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+        // Resets this frame's timestamp queries, has to be recorded before any profiler scope
+        profiler.beginFrame(commandBuffer);
+
+        // The draw list is recorded into secondary command buffers on all recording threads, each thread uses its own pool
+        // Dynamic state and bindings are not inherited, so every secondary command buffer has to set them up itself
+        // Draws are laid out on a grid, a single draw covers the whole view
+        const uint32_t gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(settings.drawCount))));
+        const float cellSize = 2.0f / gridSize;
+        // Checked once per frame, the acquire in submitFrame takes the finished upload over for the graphics queue without waiting
+        const bool geometryReady = asyncUploader.ready(geometryUpload);
+        // Nothing is kept per recording thread (the uniform ring is shared), so the ranges don't need the thread index
+        recorder.record(frameRing.currentFrame, renderPass, 0, frameBuffers[currentBuffer], settings.drawCount,
+            [=](VkCommandBuffer secondaryCommandBuffer, uint32_t firstDraw, uint32_t drawCount, uint32_t /*threadIndex*/)
+        {
+            VkViewport viewport{};
+            viewport.height = (float)height;
+            viewport.width = (float)width;
+            viewport.minDepth = 0.0f;
+            viewport.maxDepth = 1.0f;
+            vkCmdSetViewport(secondaryCommandBuffer, 0, 1, &viewport);
+
+            VkRect2D scissor{};
+            scissor.extent.width = width;
+            scissor.extent.height = height;
+            scissor.offset.x = 0;
+            scissor.offset.y = 0;
+            vkCmdSetScissor(secondaryCommandBuffer, 0, 1, &scissor);
+
+            // No placeholder pipeline or geometry, the draws are skipped while the pipeline is compiling or the geometry is still being uploaded
+            const VkPipeline currentPipeline = pipelineStates.get(pipelineState);
+            if ((currentPipeline != VK_NULL_HANDLE) && geometryReady) {
+                drawRange(secondaryCommandBuffer, currentPipeline, firstDraw, drawCount, gridSize, cellSize);
+            }
+
+            // Secondaries are executed in draw list order, so the overlay goes on top of the scene at the end of the last range
+            if (firstDraw + drawCount == settings.drawCount) {
+                drawUI(secondaryCommandBuffer);
+            }
+        });
+
+        // The primary command buffer only begins the render pass and executes the secondaries
+        // The render pass is wrapped in a profiler scope, which reports its GPU time to the benchmark and shows up as a debug label
+        {
+            vks::GpuProfiler::Scope sceneScope(profiler, commandBuffer, "Scene", glm::vec4(0.0f, 0.5f, 1.0f, 1.0f));
+            vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            recorder.execute(commandBuffer);
+            vkCmdEndRenderPass(commandBuffer);
         }
 
+        VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+
+        // Submits the frame, presents the image and moves the frame ring forward
+        submitFrame();
+    }
+
+    // Records draws [firstDraw, firstDraw + drawCount) of the grid, called concurrently from the recording threads
+    void drawRange(VkCommandBuffer secondaryCommandBuffer, VkPipeline currentPipeline, uint32_t firstDraw, uint32_t drawCount, uint32_t gridSize, float cellSize)
+    {
+        vkCmdBindPipeline(secondaryCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, currentPipeline);
+        // Bound once for all draws, whatever mesh they draw
+        geometry.bind(secondaryCommandBuffer);
+
+        ShaderData shaderData{};
+        shaderData.projectionMatrix = camera.matrices.perspective;
+        shaderData.viewMatrix = camera.matrices.view;
+        for (uint32_t i = firstDraw; i < firstDraw + drawCount; i++)
+        {
+            const glm::vec2 cell(static_cast<float>(i % gridSize), static_cast<float>(i / gridSize));
+            const glm::vec2 center = (cell + 0.5f) * cellSize - 1.0f;
+            shaderData.modelMatrix = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(center, 0.0f)), glm::vec3(1.0f / gridSize));
+            // The GPU is done with this frame's uniform region, so blocks can be written without affecting frames still in flight
+            // The region is sized for settings.drawCount, draws that don't fit are dropped
+            uint32_t dynamicOffset;
+            if (!frameRing.uniforms.push(shaderData, &dynamicOffset)) {
+                break;
+            }
+            vkCmdBindDescriptorSets(secondaryCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 1, &dynamicOffset);
+            geometry.draw(secondaryCommandBuffer, triangle, 1, 1);
+        }
     }
 
 };
\ No newline at end of file
@@ -0,0 +1,154 @@
+/*
+* Asynchronous uploader
+*
+* Streams resource data on the dedicated transfer queue and hands the resources over to the graphics queue
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanAsyncUploader.h"
+#include <algorithm>
+
+namespace vks
+{
+	/**
+	* Set up the uploader on the device's transfer queue
+	*
+	* @param device Device with the transfer queue family requested at device creation
+	* @param dstQueueFamilyIndex Family of the queue that uses the uploaded resources
+	* @param capacity (Optional) Size of the transfer queue's staging ring
+	*/
+	void AsyncUploader::create(vks::VulkanDevice* device, uint32_t dstQueueFamilyIndex, VkDeviceSize capacity)
+	{
+		this->dstQueueFamilyIndex = dstQueueFamilyIndex;
+		requiredValue = 0;
+		acquiredValue = 0;
+		submittedCount = 0;
+		acquiredCount = 0;
+		waitCount = 0;
+		maxAcquireLatency = 0.0;
+		pending.clear();
+		if (device->queueFamilyIndices.transfer != dstQueueFamilyIndex) {
+			VkQueue transferQueue;
+			vkGetDeviceQueue(device->logicalDevice, device->queueFamilyIndices.transfer, 0, &transferQueue);
+			transferRing.reset(new vks::StagingRing());
+			transferRing->create(device, transferQueue, device->queueFamilyIndices.transfer, capacity);
+			stagingRing = transferRing.get();
+		}
+		else {
+			stagingRing = &device->stagingRing;
+		}
+		timeline = stagingRing->queueTimeline();
+	}
+
+	/** @brief Wait for all uploads and release the transfer queue's staging ring */
+	void AsyncUploader::destroy()
+	{
+		if (transferRing) {
+			transferRing->destroy();
+			transferRing.reset();
+		}
+		stagingRing = nullptr;
+		pending.clear();
+	}
+
+	/** @brief True if uploads run on a queue family of their own */
+	bool AsyncUploader::dedicated() const
+	{
+		return transferRing != nullptr;
+	}
+
+	/**
+	* Submit a batch to the transfer queue
+	*
+	* @param batch Batch created with the uploader's stagingRing and dstQueueFamilyIndex
+	*
+	* @note Thread safe with respect to acquire(), batches are meant to be filled and submitted by a streaming thread
+	*
+	* @return Token of the batch, pass it to ready() or require() before using the resources in a frame
+	*/
+	UploadToken AsyncUploader::submit(vks::UploadBatch& batch)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		UploadToken token = batch.submit();
+		if (token.timeline != nullptr) {
+			submittedCount++;
+		}
+		// Batches on the transfer queue are always taken over by a frame, even without images the semaphore wait makes their buffer copies visible
+		if ((token.timeline != nullptr) && (dedicated() || !batch.imageAcquireBarriers.empty())) {
+			pending.push_back({ token.value, batch.imageAcquireBarriers, std::chrono::high_resolution_clock::now() });
+		}
+		return token;
+	}
+
+	/** @brief Make the next acquire() wait for the batch of the token, for resources the frame can't do without */
+	void AsyncUploader::require(const UploadToken& token)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		requiredValue = std::max(requiredValue, token.value);
+	}
+
+	/**
+	* Check if the resources of a batch can be used without making the graphics queue wait
+	*
+	* @return True if the batch has been acquired already or has finished, so the next acquire() takes it over without waiting
+	*/
+	bool AsyncUploader::ready(const UploadToken& token) const
+	{
+		// Batches on the graphics queue itself are ordered before every frame submitted after them
+		if (!dedicated()) {
+			return true;
+		}
+		return (token.value <= acquiredValue.load()) || token.done();
+	}
+
+	/**
+	* Acquire the resources of finished and required batches for the graphics family
+	*
+	* @param commands Allocator of the frame the acquire barriers are submitted with
+	* @param sync Submission of the frame, gets a wait on the transfer queue's timeline
+	*
+	* @return Command buffer with the acquire barriers to submit ahead of the frame's command buffers, VK_NULL_HANDLE if no images have to be acquired
+	*/
+	VkCommandBuffer AsyncUploader::acquire(vks::CommandAllocator& commands, vks::TimelineSubmit& sync)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (pending.empty()) {
+			return VK_NULL_HANDLE;
+		}
+		// Finished batches are taken over for free, unfinished ones only if a frame needs them
+		const uint64_t completedValue = timeline->completed();
+		const uint64_t value = std::max(requiredValue, completedValue);
+		if (pending.front().timelineValue > value) {
+			return VK_NULL_HANDLE;
+		}
+
+		std::vector<VkImageMemoryBarrier> imageBarriers;
+		uint64_t acquired = 0;
+		const auto now = std::chrono::high_resolution_clock::now();
+		while (!pending.empty() && (pending.front().timelineValue <= value)) {
+			imageBarriers.insert(imageBarriers.end(), pending.front().imageBarriers.begin(), pending.front().imageBarriers.end());
+			acquired = pending.front().timelineValue;
+			// Stalls and latency are reported to the benchmark, streaming should neither make frames wait nor take long to show up
+			acquiredCount++;
+			if (acquired > completedValue) {
+				waitCount++;
+			}
+			maxAcquireLatency = std::max(maxAcquireLatency, std::chrono::duration<double, std::milli>(now - pending.front().submitTime).count());
+			pending.pop_front();
+		}
+
+		// The release has to happen before the acquire, even if the host has seen the batch finish, which the semaphore wait guarantees
+		sync.waitTimeline(*timeline, acquired, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+		acquiredValue = acquired;
+		if (imageBarriers.empty()) {
+			return VK_NULL_HANDLE;
+		}
+
+		VkCommandBuffer commandBuffer = commands.begin(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr,
+			static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+		return commandBuffer;
+	}
+}
@@ -0,0 +1,81 @@
+/*
+* Asynchronous uploader
+*
+* Streams resource data on the dedicated transfer queue and hands the resources over to the graphics queue
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanDevice.h"
+#include "VulkanTimeline.h"
+#include "VulkanStagingRing.h"
+#include "VulkanUploadBatch.h"
+#include "VulkanCommandAllocator.h"
+
+namespace vks
+{
+	/**
+	* @brief Uploads on the transfer queue family, in the background of rendering
+	*
+	* Batches are filled and submitted to the transfer queue through a staging ring of its own, releasing their images to the
+	* graphics family (buffers have to be created with VulkanDevice::createSharedBuffer). Each frame acquire() takes over the batches
+	* that have finished in the meantime, recording the matching image acquire barriers, which needs no waiting at all. Only batches a frame explicitly requires (require()) make the graphics queue wait on
+	* the transfer queue's timeline, so streaming never stalls rendering unless something is needed right away
+	*
+	* @note Without a dedicated transfer family the uploader falls back to the device's staging ring on the graphics queue,
+	* batches then have to be submitted on the thread that submits frames
+	*/
+	class AsyncUploader
+	{
+	public:
+		/** @brief Ring the batches of the uploader have to be created with */
+		vks::StagingRing* stagingRing = nullptr;
+		/** @brief Family the uploaded resources are used on */
+		uint32_t dstQueueFamilyIndex = 0;
+
+		void create(vks::VulkanDevice* device, uint32_t dstQueueFamilyIndex, VkDeviceSize capacity = vks::StagingRing::defaultCapacity);
+		void destroy();
+
+		bool dedicated() const;
+		UploadToken submit(vks::UploadBatch& batch);
+		void require(const UploadToken& token);
+		bool ready(const UploadToken& token) const;
+		VkCommandBuffer acquire(vks::CommandAllocator& commands, vks::TimelineSubmit& sync);
+
+		/** @brief Number of batches submitted */
+		std::atomic<uint32_t> submittedCount{ 0 };
+		/** @brief Number of batches whose resources have been acquired by the graphics family */
+		uint32_t acquiredCount = 0;
+		/** @brief Number of batches acquired before they had finished, each one made the graphics queue wait on the transfer queue */
+		uint32_t waitCount = 0;
+		/** @brief Longest time in ms from submitting a batch to acquiring its resources */
+		double maxAcquireLatency = 0.0;
+
+	private:
+		/** @brief Submitted batch whose resources haven't been acquired by the graphics family yet */
+		struct PendingBatch {
+			uint64_t timelineValue;
+			std::vector<VkImageMemoryBarrier> imageBarriers;
+			std::chrono::high_resolution_clock::time_point submitTime;
+		};
+		std::unique_ptr<vks::StagingRing> transferRing;
+		vks::Timeline* timeline = nullptr;
+		std::deque<PendingBatch> pending;
+		/** @brief Highest batch value a frame has asked for */
+		uint64_t requiredValue = 0;
+		/** @brief Highest batch value whose resources have been acquired */
+		std::atomic<uint64_t> acquiredValue{ 0 };
+		std::mutex mutex;
+	};
+}
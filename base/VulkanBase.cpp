@@ -1,13 +1,166 @@
 #include "VulkanBase.h"
 
+std::vector<const char*> VulkanBase::args;
+
 VulkanBase::VulkanBase(bool enableValidation)
 {
 	settings.validation = enableValidation;
 
+	// Command line arguments
+	commandLineParser.add("help", { "--help" }, 0, "Show help");
+	commandLineParser.add("validation", { "-v", "--validation" }, 0, "Enable validation layers");
+	commandLineParser.add("vsync", { "-vs", "--vsync" }, 0, "Enable V-Sync");
+	commandLineParser.add("fullscreen", { "-f", "--fullscreen" }, 0, "Start in fullscreen mode");
+	commandLineParser.add("headless", { "-hl", "--headless" }, 0, "Render offscreen without a window (implies benchmark mode)");
+	commandLineParser.add("gpuselection", { "-g", "--gpu" }, 1, "Select GPU to run on");
+	commandLineParser.add("gpulist", { "-gl", "--listgpus" }, 0, "Display a list of available Vulkan devices");
+	commandLineParser.add("framesinflight", { "-fif", "--frames-in-flight" }, 1, "Number of frames the CPU may record ahead of the GPU (default 2)");
+	commandLineParser.add("recordthreads", { "-rt", "--record-threads" }, 1, "Number of threads recording command buffers (default: all hardware threads)");
+	commandLineParser.add("dynamicmemory", { "-dm", "--dynamic-memory" }, 1, "Memory for per-frame uniform data and UI geometry: auto, device (host visible device local) or host");
+	commandLineParser.add("hostallocator", { "-ha", "--host-allocator" }, 1, "Allocator for the driver's host memory: driver (default), tracking (counts allocations per scope, reported per frame in benchmark mode) or arena (counting, with a command scope arena and object scope pools)");
+	commandLineParser.add("pipelinecache", { "-pc", "--pipeline-cache" }, 1, "File the pipeline cache is loaded from and saved to (default: <sample name>.pipelinecache), shader module identifiers are kept next to it in <file>.identifiers");
+	commandLineParser.add("geometry", { "-geo", "--geometry" }, 1, "Mesh file the sample loads its geometry from, uploaded straight from the mapped file (written from the built-in geometry if it doesn't exist)");
+	commandLineParser.add("drawcount", { "-dc", "--draw-count" }, 1, "Number of draws per frame for stress testing");
+	commandLineParser.add("benchmark", { "-b", "--benchmark" }, 0, "Run example in benchmark mode (measures 1, 2 and 3 frames in flight)");
+	commandLineParser.add("benchmarkjobs", { "-bj", "--benchmarkjobs" }, 0, "Run the job system micro benchmarks (spawn/steal latency and throughput) in benchmark mode");
+	commandLineParser.add("benchmarkhostallocator", { "-bha", "--benchmarkhostallocator" }, 0, "Measure the create/destroy paths of prepare and the UI overlay with the allocator selected by --host-allocator in benchmark mode");
+	commandLineParser.add("benchmarkrecording", { "-brec", "--benchmarkrecording" }, 0, "Measure command buffer recording time per number of recording threads in benchmark mode");
+	commandLineParser.add("benchmarkwarmup", { "-bw", "--benchmarkwarmup" }, 1, "Set warmup time for benchmark mode in seconds");
+	commandLineParser.add("benchmarkruntime", { "-br", "--benchmarkruntime" }, 1, "Set duration time for benchmark mode in seconds");
+	commandLineParser.add("benchmarkresultfile", { "-bf", "--benchmarkresultfile" }, 1, "Set file name for benchmark results");
+	commandLineParser.add("benchmarkresultframes", { "-bt", "--benchmarkframetimes" }, 0, "Save frame times to benchmark results file");
+	commandLineParser.add("benchmarkframes", { "-bfs", "--benchmarkframes" }, 1, "Only render the given number of frames");
+	commandLineParser.parse(args);
+
+	if (commandLineParser.isSet("help")) {
+		commandLineParser.printHelp();
+		std::cin.get();
+		exit(0);
+	}
+	if (commandLineParser.isSet("validation")) {
+		settings.validation = true;
+	}
+	if (commandLineParser.isSet("vsync")) {
+		settings.vsync = true;
+	}
+	if (commandLineParser.isSet("fullscreen")) {
+		settings.fullscreen = true;
+	}
+	if (commandLineParser.isSet("headless")) {
+		settings.headless = true;
+	}
+#if !defined(_WIN32)
+	// There is no window system integration on other platforms, so they always render offscreen
+	settings.headless = true;
+#endif
+	if (commandLineParser.isSet("framesinflight")) {
+		settings.framesInFlight = static_cast<uint32_t>(commandLineParser.getValueAsInt("framesinflight", 2));
+	}
+	if (commandLineParser.isSet("recordthreads")) {
+		settings.recordThreads = static_cast<uint32_t>(commandLineParser.getValueAsInt("recordthreads", 0));
+	}
+	if (commandLineParser.isSet("dynamicmemory")) {
+		const std::string policy = commandLineParser.getValueAsString("dynamicmemory", "auto");
+		if (policy == "device") {
+			settings.dynamicMemory = vks::DynamicMemoryPolicy::DeviceLocal;
+		}
+		else if (policy == "host") {
+			settings.dynamicMemory = vks::DynamicMemoryPolicy::Host;
+		}
+		else {
+			settings.dynamicMemory = vks::DynamicMemoryPolicy::Auto;
+		}
+	}
+	if (commandLineParser.isSet("hostallocator")) {
+		const std::string hostAllocator = commandLineParser.getValueAsString("hostallocator", "driver");
+		if (hostAllocator == "tracking") {
+			settings.hostAllocator = vks::HostAllocator::Mode::Tracking;
+		}
+		else if (hostAllocator == "arena") {
+			settings.hostAllocator = vks::HostAllocator::Mode::Arena;
+		}
+		else {
+			settings.hostAllocator = vks::HostAllocator::Mode::Driver;
+		}
+	}
+	// Everything is created and destroyed with these callbacks, so they can't change once the instance exists
+	vks::HostAllocator::select(settings.hostAllocator);
+	if (commandLineParser.isSet("pipelinecache")) {
+		settings.pipelineCacheFile = commandLineParser.getValueAsString("pipelinecache", "");
+	}
+	if (commandLineParser.isSet("geometry")) {
+		settings.geometryFile = commandLineParser.getValueAsString("geometry", "");
+	}
+	if (commandLineParser.isSet("drawcount")) {
+		settings.drawCount = static_cast<uint32_t>(std::max(commandLineParser.getValueAsInt("drawcount", 1), 1));
+	}
+	if (commandLineParser.isSet("benchmark")) {
+		benchmark.active = true;
+		vks::tools::errorModeSilent = true;
+	}
+	// Without a window there is nothing to look at, so headless runs are benchmark runs (e.g. measuring CPU frame cost on a software implementation)
+	if (settings.headless) {
+		benchmark.active = true;
+		vks::tools::errorModeSilent = true;
+	}
+	if (commandLineParser.isSet("benchmarkwarmup")) {
+		benchmark.warmup = commandLineParser.getValueAsInt("benchmarkwarmup", 0);
+	}
+	if (commandLineParser.isSet("benchmarkruntime")) {
+		benchmark.duration = commandLineParser.getValueAsInt("benchmarkruntime", 10);
+	}
+	if (commandLineParser.isSet("benchmarkresultfile")) {
+		benchmark.filename = commandLineParser.getValueAsString("benchmarkresultfile", "");
+	}
+	if (commandLineParser.isSet("benchmarkresultframes")) {
+		benchmark.outputFrameTimes = true;
+	}
+	if (commandLineParser.isSet("benchmarkframes")) {
+		benchmark.outputFrames = commandLineParser.getValueAsInt("benchmarkframes", -1);
+	}
+	if (commandLineParser.isSet("benchmarkrecording")) {
+		benchmarkRecording = true;
+	}
+	if (commandLineParser.isSet("benchmarkhostallocator")) {
+		benchmarkHostAllocator = true;
+	}
+	if (commandLineParser.isSet("benchmarkjobs")) {
+		benchmarkJobs = true;
+	}
+
+	// Sized from the hardware thread count, the main thread takes part as thread 0
+	jobSystem.create();
+
+	// With fewer draws than every thread's minimum share the recorder never splits the draw list, so every thread count would measure the
+	// same single threaded recording. A few minimum shares per thread leave room for stealing to even out the ranges
+	if (benchmarkRecording) {
+		const uint32_t minDrawCount = jobSystem.threadCount() * recorder.minDrawsPerThread * 4;
+		if (settings.drawCount < minDrawCount) {
+			std::cout << "Recording benchmark needs at least " << minDrawCount << " draws, raising the draw count from " << settings.drawCount << "\n";
+			settings.drawCount = minDrawCount;
+		}
+	}
 }
 VulkanBase::~VulkanBase()
 {
-
+	// Runs the deleters of everything still retired, waiting on the timeline if necessary
+	deletionQueue.flush();
+	// Waits for pending compilations, which still reference the shader modules and the pipeline cache
+	pipelineStates.destroy();
+	pipelineCompiler.destroy();
+	for (VkShaderModule& shaderModule : shaderModules) {
+		vkDestroyShaderModule(device, shaderModule, vks::HostAllocator::callbacks());
+	}
+	shaderModules.clear();
+	shaderModuleCache.destroy();
+	pipelineCacheFile.destroy();
+	pipelineCache = VK_NULL_HANDLE;
+	fileUploader.destroy();
+	asyncUploader.destroy();
+	recorder.destroy();
+	profiler.destroy();
+	frameRing.destroy();
+	jobSystem.destroy();
 }
 
 bool VulkanBase::initVulkan()
@@ -85,19 +238,89 @@ uint32_t selectedDevice = 0;
 	// This is handled by a separate class that gets a logical device representation
 	// and encapsulates functions related to a device
 	vulkanDevice = new vks::VulkanDevice(physicalDevice);
+	vulkanDevice->dynamicMemoryPolicy = settings.dynamicMemory;
 	
 	// Derived examples can override this to set actual features (based on above readings) to enable for logical device creation
 	getEnabledFeatures();
 
-	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain);
+	// Uploads from mapped files can skip the staging copy if the device imports host pointers (see vks::FileUploader)
+	const bool externalMemory = (apiVersion >= VK_API_VERSION_1_1) || (vulkanDevice->extensionSupported(VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME)
+		&& std::find(supportedInstanceExtensions.begin(), supportedInstanceExtensions.end(), VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME) != supportedInstanceExtensions.end());
+	PFN_vkGetPhysicalDeviceProperties2KHR getPhysicalDeviceProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2KHR>(
+		vkGetInstanceProcAddr(instance, (apiVersion >= VK_API_VERSION_1_1) ? "vkGetPhysicalDeviceProperties2" : "vkGetPhysicalDeviceProperties2KHR"));
+	if (externalMemory && getPhysicalDeviceProperties2 && vulkanDevice->extensionSupported(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME)) {
+		VkPhysicalDeviceExternalMemoryHostPropertiesEXT externalMemoryHostProperties{};
+		externalMemoryHostProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT;
+		VkPhysicalDeviceProperties2KHR deviceProperties2{};
+		deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+		deviceProperties2.pNext = &externalMemoryHostProperties;
+		getPhysicalDeviceProperties2(physicalDevice, &deviceProperties2);
+		vulkanDevice->hostMemoryImport.minImportedHostPointerAlignment = externalMemoryHostProperties.minImportedHostPointerAlignment;
+		if (apiVersion < VK_API_VERSION_1_1) {
+			enabledDeviceExtensions.push_back(VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME);
+		}
+		enabledDeviceExtensions.push_back(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+	}
+	// Heap budgets reported by the driver let the allocator warn before allocations start to fail
+	PFN_vkGetPhysicalDeviceMemoryProperties2KHR getPhysicalDeviceMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(
+		vkGetInstanceProcAddr(instance, (apiVersion >= VK_API_VERSION_1_1) ? "vkGetPhysicalDeviceMemoryProperties2" : "vkGetPhysicalDeviceMemoryProperties2KHR"));
+	if (getPhysicalDeviceMemoryProperties2 && vulkanDevice->extensionSupported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+		vulkanDevice->getPhysicalDeviceMemoryProperties2 = getPhysicalDeviceMemoryProperties2;
+		enabledDeviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
+	// Pipelines found in the pipeline cache can be created from shader module identifiers instead of SPIR-V (see vks::PipelineCompiler)
+	// Failing such a creation instead of compiling needs pipeline creation cache control, core in 1.3
+	void* pNextChain = deviceCreatepNextChain;
+	VkPhysicalDeviceShaderModuleIdentifierFeaturesEXT shaderModuleIdentifierFeatures{};
+	shaderModuleIdentifierFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_MODULE_IDENTIFIER_FEATURES_EXT;
+	VkPhysicalDevicePipelineCreationCacheControlFeaturesEXT cacheControlFeatures{};
+	cacheControlFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_CREATION_CACHE_CONTROL_FEATURES_EXT;
+	const bool cacheControlCore = (apiVersion >= VK_API_VERSION_1_3) && (deviceProperties.apiVersion >= VK_API_VERSION_1_3);
+	PFN_vkGetPhysicalDeviceFeatures2KHR getPhysicalDeviceFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(
+		vkGetInstanceProcAddr(instance, (apiVersion >= VK_API_VERSION_1_1) ? "vkGetPhysicalDeviceFeatures2" : "vkGetPhysicalDeviceFeatures2KHR"));
+	if (getPhysicalDeviceFeatures2 && getPhysicalDeviceProperties2 && vulkanDevice->extensionSupported(VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME)
+		&& (cacheControlCore || vulkanDevice->extensionSupported(VK_EXT_PIPELINE_CREATION_CACHE_CONTROL_EXTENSION_NAME))) {
+		shaderModuleIdentifierFeatures.pNext = &cacheControlFeatures;
+		VkPhysicalDeviceFeatures2KHR deviceFeatures2{};
+		deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		deviceFeatures2.pNext = &shaderModuleIdentifierFeatures;
+		getPhysicalDeviceFeatures2(physicalDevice, &deviceFeatures2);
+		// Only if the sample doesn't chain features itself, these may already be part of its chain (e.g. in VkPhysicalDeviceVulkan13Features)
+		if (shaderModuleIdentifierFeatures.shaderModuleIdentifier && cacheControlFeatures.pipelineCreationCacheControl && (deviceCreatepNextChain == nullptr)) {
+			shaderModuleIdentifierFeatures.pNext = &cacheControlFeatures;
+			cacheControlFeatures.pNext = nullptr;
+			pNextChain = &shaderModuleIdentifierFeatures;
+			if (!cacheControlCore) {
+				enabledDeviceExtensions.push_back(VK_EXT_PIPELINE_CREATION_CACHE_CONTROL_EXTENSION_NAME);
+			}
+			enabledDeviceExtensions.push_back(VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME);
+			// Identifiers are persisted by the shader module cache, they can only be reused by implementations with the same algorithm
+			VkPhysicalDeviceShaderModuleIdentifierPropertiesEXT shaderModuleIdentifierProperties{};
+			shaderModuleIdentifierProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_MODULE_IDENTIFIER_PROPERTIES_EXT;
+			VkPhysicalDeviceProperties2KHR deviceProperties2{};
+			deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+			deviceProperties2.pNext = &shaderModuleIdentifierProperties;
+			getPhysicalDeviceProperties2(physicalDevice, &deviceProperties2);
+			memcpy(vulkanDevice->shaderModuleIdentifier.algorithmUUID, shaderModuleIdentifierProperties.shaderModuleIdentifierAlgorithmUUID, VK_UUID_SIZE);
+		}
+	}
+
+	// Offscreen rendering doesn't need the swap chain extension, which may not be supported by implementations without presentation support
+	const bool useSwapChain = !settings.headless || headlessSurface;
+	// A separate transfer queue (if the implementation has one) lets uploads run alongside rendering
+	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, pNextChain, useSwapChain, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT);
 	if (res != VK_SUCCESS) {
 		vks::tools::exitFatal("Could not create Vulkan device: \n" + vks::tools::errorString(res), res);
 		return false;
 	}
 	device = vulkanDevice->logicalDevice;
+	shaderModuleCache.create(vulkanDevice);
 
 	// Get a graphics queue from the device
 	vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.graphics, 0, &queue);
+	// All submissions to the graphics queue signal its timeline
+	queueTimeline = vulkanDevice->getTimeline(queue);
+	deletionQueue.create(queueTimeline);
 
 	// Find a suitable depth and/or stencil format
 	VkBool32 validFormat{ false };
@@ -111,26 +334,10 @@ uint32_t selectedDevice = 0;
 
 	swapChain.connect(instance, physicalDevice, device);
 
-	// Create synchronization objects
-	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-
-	// Create a semaphore used to synchronize image presentation
-	// Ensures that the image is displayed before we start submitting new commands to the queue
-	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.presentComplete));
-	// Create a semaphore used to synchronize command submission
-	// Ensures that the image is not presented until all commands have been submitted and executed
-	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.renderComplete));
-
-	submitInfo = vks::initializers::submitInfo();
-	submitInfo.pWaitDstStageMask = &submitPipelineStages;
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = &semaphores.presentComplete;
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = &semaphores.renderComplete;
-
 	return true;
 
 }
+#if defined(_WIN32)
 HWND VulkanBase::setupWindow(HINSTANCE hinstance, WNDPROC wndproc)
 {
 	this->windowInstance = hinstance;
@@ -246,21 +453,71 @@ HWND VulkanBase::setupWindow(HINSTANCE hinstance, WNDPROC wndproc)
 	return window;
 }
 
+void VulkanBase::handleMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+	switch (uMsg)
+	{
+	case WM_CLOSE:
+		prepared = false;
+		DestroyWindow(hWnd);
+		PostQuitMessage(0);
+		break;
+	case WM_PAINT:
+		ValidateRect(window, NULL);
+		// The render loop doesn't run while the window is being dragged, so keep rendering from here
+		if (prepared && resizing) {
+			render();
+		}
+		break;
+	case WM_SIZE:
+		if ((prepared) && (wParam != SIZE_MINIMIZED)) {
+			if ((resizing) || ((wParam == SIZE_MAXIMIZED) || (wParam == SIZE_RESTORED))) {
+				destWidth = LOWORD(lParam);
+				destHeight = HIWORD(lParam);
+				windowResize();
+			}
+		}
+		break;
+	case WM_GETMINMAXINFO:
+	{
+		LPMINMAXINFO minMaxInfo = (LPMINMAXINFO)lParam;
+		minMaxInfo->ptMinTrackSize.x = 64;
+		minMaxInfo->ptMinTrackSize.y = 64;
+		break;
+	}
+	case WM_ENTERSIZEMOVE:
+		resizing = true;
+		break;
+	case WM_EXITSIZEMOVE:
+		resizing = false;
+		break;
+	}
+}
+#endif
+
 void VulkanBase::prepare()
 {
+	prepareStart = std::chrono::high_resolution_clock::now();
 	initSwapchain();
-	createCommandPool();
 	setupSwapChain();
-	createCommandBuffers();
-	createSynchronizationPrimitives();
+	frameRing.create(vulkanDevice, queueTimeline, settings.framesInFlight, swapChain.queueNodeIndex, frameUniformCapacity);
+	profiler.create(vulkanDevice, swapChain.queueNodeIndex, settings.framesInFlight);
+	recorder.create(device, swapChain.queueNodeIndex, settings.framesInFlight, &jobSystem);
+	recorder.maxThreads = settings.recordThreads;
+	asyncUploader.create(vulkanDevice, swapChain.queueNodeIndex);
+	fileUploader.create(vulkanDevice);
 	setupDepthStencil();
 	setupRenderPass();
 	createPipelineCache();
 	setupFrameBuffer();
+	destWidth = width;
+	destHeight = height;
 	settings.overlay = settings.overlay && (!benchmark.active);
 	if (settings.overlay) {
 		UIOverlay.device = vulkanDevice;
 		UIOverlay.queue = queue;
+		UIOverlay.deletionQueue = &deletionQueue;
+		UIOverlay.pipelineCompiler = &pipelineCompiler;
 		UIOverlay.shaders = {
 			loadShader(getShadersPath() + "base/uioverlay.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
 			loadShader(getShadersPath() + "base/uioverlay.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT),
@@ -275,101 +532,446 @@ VkPipelineShaderStageCreateInfo VulkanBase::loadShader(std::string fileName, VkS
 	VkPipelineShaderStageCreateInfo shaderStage = {};
 	shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	shaderStage.stage = stage;
+	// Loading the same code twice returns the same module
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
-	shaderStage.module = vks::tools::loadShader(androidApp->activity->assetManager, fileName.c_str(), device);
+	shaderStage.module = shaderModuleCache.load(androidApp->activity->assetManager, fileName);
 #else
-	shaderStage.module = vks::tools::loadShader(fileName.c_str(), device);
+	shaderStage.module = shaderModuleCache.load(fileName);
 #endif
 	shaderStage.pName = "main";
 	assert(shaderStage.module != VK_NULL_HANDLE);
-	shaderModules.push_back(shaderStage.module);
 	return shaderStage;
 }
 
-void VulkanBase::initSwapchain()
+vks::ShaderId VulkanBase::loadShaderDeferred(std::string fileName)
 {
+	// Shaders with a stored identifier don't get a module, pipelines are looked up in the pipeline cache by the identifier
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+	const vks::ShaderId shader = shaderModuleCache.loadDeferred(androidApp->activity->assetManager, fileName);
+#else
+	const vks::ShaderId shader = shaderModuleCache.loadDeferred(fileName);
+#endif
+	assert(shader != vks::ShaderId::none);
+	return shader;
+}
+
+void VulkanBase::renderLoop()
+{
+	if (benchmark.active) {
+		// Results of --dynamic-memory runs are only comparable with the placement that was actually used
+		const bool dynamicDeviceLocal = (vulkanDevice->dynamicMemoryProperties() & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0;
+		std::cout << "dynamic memory: " << (dynamicDeviceLocal ? "device local" : "host") << "\n";
+		const char* hostAllocatorNames[] = { "driver", "tracking", "arena" };
+		std::cout << "host allocator: " << hostAllocatorNames[static_cast<uint32_t>(vks::HostAllocator::mode())] << "\n";
+		if (benchmarkJobs) {
+			runJobSystemBenchmark();
+		}
+		else if (benchmarkHostAllocator) {
+			runHostAllocatorBenchmark();
+		}
+		else if (benchmarkRecording) {
+			// Measure how recording time scales with the number of recording threads (1, 2, 4, ... up to all job system threads)
+			std::vector<uint32_t> threadCounts;
+			const uint32_t maxThreads = jobSystem.threadCount();
+			for (uint32_t threadCount = 1; threadCount < maxThreads; threadCount *= 2) {
+				threadCounts.push_back(threadCount);
+			}
+			threadCounts.push_back(maxThreads);
+			benchmark.runRecording(threadCounts, [=](uint32_t threadCount) { setRecordThreads(threadCount); }, [=] { render(); }, [=] { return recorder.lastRecordTime; }, vulkanDevice->properties);
+		}
+		else {
+			// Measure how much CPU/GPU overlap the frame ring buys at different depths
+			benchmark.runFramesInFlight({ 1, 2, 3 }, [=](uint32_t depth) { setFramesInFlight(depth); }, [=] { render(); }, vulkanDevice->properties);
+		}
+		vkDeviceWaitIdle(device);
+		// Renderers look up their pipelines while recording, every lookup after the first should be a hit
+		benchmark.setPipelineRequests(pipelineStates.hits, pipelineStates.misses);
+		// Streamed resources should have shown up without the graphics queue ever waiting for the transfer queue
+		benchmark.setAsyncUploads(asyncUploader.submittedCount, asyncUploader.waitCount, asyncUploader.maxAcquireLatency, asyncUploader.dedicated());
+		// Data loaded from mapped files should be copied from the imported pages rather than through the staging ring
+		benchmark.setFileUploads(fileUploader.importedBytes, fileUploader.stagedBytes, fileUploader.importSupported());
+		if (benchmark.filename != "") {
+			benchmark.saveResults();
+		}
+		return;
+	}
+
 #if defined(_WIN32)
-	swapChain.initSurface(windowInstance, window);
+	MSG msg;
+	bool quitMessageReceived = false;
+	while (!quitMessageReceived) {
+		while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+			TranslateMessage(&msg);
+			DispatchMessage(&msg);
+			if (msg.message == WM_QUIT) {
+				quitMessageReceived = true;
+				break;
+			}
+		}
+		if (prepared && !IsIconic(window)) {
+			render();
+		}
+	}
 #endif
+	// Flush device to make sure all resources can be freed
+	if (device != VK_NULL_HANDLE) {
+		vkDeviceWaitIdle(device);
+	}
 }
 
-std::string VulkanBase::getWindowTitle()
+bool VulkanBase::prepareFrame()
+{
+	// Make sure the GPU is done with the resources of the frame we are about to reuse
+	vks::Frame& frame = frameRing.wait();
+	// Destroy whatever has been retired by frames that have finished by now
+	deletionQueue.collect();
+	fileUploader.collect();
+	pipelineCacheFile.update();
+	// Everything up to the first frame with all pipelines compiled counts as startup, a warm pipeline cache saves compiling the sample's and the overlay's pipelines
+	if (!startupReported && pipelineCompiler.idle()) {
+		startupReported = true;
+		const double startupTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - prepareStart).count();
+		if (benchmark.active) {
+			std::cout << "startup: " << startupTime << " ms (" << (pipelineCacheFile.loaded ? "warm" : "cold") << " pipeline cache)" << "\n";
+			std::cout << "pipelines: " << pipelineCompiler.compiledCount << " created (" << pipelineCompiler.identifierCount << " from shader module identifiers), " << pipelineCompiler.deduplicatedCount << " deduplicated" << "\n";
+			std::cout << "shader modules: " << shaderModuleCache.moduleCount << " created, " << shaderModuleCache.deferredCount << " deferred by identifier, " << shaderModuleCache.sharedCount << " shared" << "\n";
+			benchmark.setStartupTime(startupTime, pipelineCacheFile.loaded);
+		}
+	}
+	// Refresh the heap budgets once per frame, the allocator extrapolates from its own allocations in between
+	vulkanDevice->memoryAllocator.updateBudget();
+	if (benchmark.active) {
+		for (uint32_t heap = 0; heap < vulkanDevice->memoryAllocator.heapCount(); heap++) {
+			const vks::MemoryAllocator::HeapBudget budget = vulkanDevice->memoryAllocator.heapBudget(heap);
+			const vks::MemoryAllocator::HeapStats stats = vulkanDevice->memoryAllocator.heapStats(heap);
+			benchmark.addMemoryUsage(heap, budget.usage, budget.budget, std::vector<VkDeviceSize>(stats.taggedSize, stats.taggedSize + vks::memoryTagCount));
+		}
+		// Driver host allocations since the last frame, only counted if the driver allocates through the callbacks
+		if (vks::HostAllocator::mode() != vks::HostAllocator::Mode::Driver) {
+			const vks::HostAllocationStats hostStats = vks::HostAllocator::stats();
+			for (uint32_t scope = 0; scope < vks::allocationScopeCount; scope++) {
+				const vks::HostAllocationStats::Scope& current = hostStats.scopes[scope];
+				const vks::HostAllocationStats::Scope& last = lastHostAllocationStats.scopes[scope];
+				benchmark.addHostAllocations(scope, current.allocations - last.allocations, current.allocatedBytes - last.allocatedBytes, current.peakBytes);
+			}
+			lastHostAllocationStats = hostStats;
+		}
+	}
+	// The GPU timings recorded the last time this slot was used are available now, without waiting on the queries
+	if (profiler.collect(frameRing.currentFrame) && benchmark.active) {
+		for (auto& passTime : profiler.results()) {
+			benchmark.addGpuPassTime(passTime.name, passTime.milliseconds);
+		}
+	}
+	updateOverlay();
+	// Acquire the next image from the swap chain
+	VkResult result = swapChain.acquireNextImage(frame.presentComplete, &currentBuffer);
+	// An out of date swap chain can no longer be rendered to, so it is recreated and the frame skipped, SUBOPTIMAL can still be presented
+	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+		windowResize();
+		return false;
+	}
+	else if (result != VK_SUBOPTIMAL_KHR) {
+		VK_CHECK_RESULT(result);
+	}
+	return true;
+}
+
+void VulkanBase::submitFrame()
+{
+	vks::Frame& frame = frameRing.current();
+
+	// Uploads recorded since the last frame go out first, the ring's batch ends with a barrier that makes them visible to the frame
+	vulkanDevice->stagingRing.flush();
+
+	// Rendering waits for the acquired image and signals the binary semaphore presentation waits on, completion of the frame is tracked on the queue's timeline
+	vks::TimelineSubmit sync;
+	if (!swapChain.offscreen) {
+		sync.waitBinary(frame.presentComplete, submitPipelineStages);
+		sync.signalBinary(swapChain.buffers[currentBuffer].renderComplete);
+	}
+	// Resources streamed in on the transfer queue are acquired ahead of the frame's own commands
+	VkCommandBuffer commandBuffers[2];
+	uint32_t commandBufferCount = 0;
+	VkCommandBuffer acquireCommandBuffer = asyncUploader.acquire(frame.commands, sync);
+	if (acquireCommandBuffer != VK_NULL_HANDLE) {
+		commandBuffers[commandBufferCount++] = acquireCommandBuffer;
+	}
+	commandBuffers[commandBufferCount++] = frame.commandBuffer;
+	frame.timelineValue = queueTimeline->submit(queue, commandBuffers, commandBufferCount, &sync);
+
+	// Uploads may submit to the same queue from other threads
+	VkResult result;
+	{
+		std::lock_guard<std::mutex> lock(queueTimeline->queueMutex);
+		result = swapChain.queuePresent(queue, currentBuffer, swapChain.buffers[currentBuffer].renderComplete);
+	}
+
+	// The host can start recording the next frame right away, it only blocks once it wraps around to a frame that is still in flight
+	frameRing.advance();
+
+	// The swap chain no longer matches the surface, recreate it before the next frame
+	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
+		windowResize();
+	}
+	else {
+		VK_CHECK_RESULT(result);
+	}
+}
+
+void VulkanBase::setFramesInFlight(uint32_t framesInFlight)
+{
+	vkDeviceWaitIdle(device);
+	settings.framesInFlight = framesInFlight;
+	frameRing.destroy();
+	frameRing.create(vulkanDevice, queueTimeline, settings.framesInFlight, swapChain.queueNodeIndex, frameUniformCapacity);
+	profiler.destroy();
+	profiler.create(vulkanDevice, swapChain.queueNodeIndex, settings.framesInFlight);
+	// The recorder keeps a set of pools per frame in flight
+	recorder.destroy();
+	recorder.create(device, swapChain.queueNodeIndex, settings.framesInFlight, &jobSystem);
+	framesInFlightChanged();
+}
+
+void VulkanBase::framesInFlightChanged() {}
+
+void VulkanBase::updateOverlay()
 {
-	std::string device(deviceProperties.deviceName);
-	std::string windowTitle;
-	windowTitle = title + " - " + device;
 	if (!settings.overlay) {
-		windowTitle += " - " + std::to_string(0) + " fps";
+		return;
 	}
-	return windowTitle;
+
+	ImGuiIO& io = ImGui::GetIO();
+	io.DisplaySize = ImVec2((float)width, (float)height);
+
+	ImGui::NewFrame();
+	ImGui::PushStyleVar(ImGuiStyleVar_WindowRounding, 0);
+	ImGui::SetNextWindowPos(ImVec2(10 * UIOverlay.scale, 10 * UIOverlay.scale));
+	ImGui::SetNextWindowSize(ImVec2(0, 0), ImGuiCond_FirstUseEver);
+	ImGui::Begin("Vulkan Example", nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove);
+	ImGui::TextUnformatted(title.c_str());
+	ImGui::TextUnformatted(deviceProperties.deviceName);
+	ImGui::PushItemWidth(110.0f * UIOverlay.scale);
+	OnUpdateUIOverlay(&UIOverlay);
+	if (UIOverlay.header("Memory")) {
+		for (uint32_t heap = 0; heap < vulkanDevice->memoryAllocator.heapCount(); heap++) {
+			const vks::MemoryAllocator::HeapBudget budget = vulkanDevice->memoryAllocator.heapBudget(heap);
+			const vks::MemoryAllocator::HeapStats stats = vulkanDevice->memoryAllocator.heapStats(heap);
+			UIOverlay.text("Heap %u: %.1f / %.1f MB%s", heap, budget.usage / 1048576.0, budget.budget / 1048576.0, budget.reported ? "" : " (est.)");
+			for (uint32_t tag = 0; tag < vks::memoryTagCount; tag++) {
+				if (stats.taggedSize[tag] > 0) {
+					UIOverlay.text("  %s: %.1f MB", vks::memoryTagName(static_cast<vks::MemoryTag>(tag)), stats.taggedSize[tag] / 1048576.0);
+				}
+			}
+		}
+	}
+	ImGui::PopItemWidth();
+	ImGui::End();
+	ImGui::PopStyleVar();
+	ImGui::Render();
+
+	// Called once the GPU is done with the current frame, so its overlay buffers can be rewritten
+	UIOverlay.update(frameRing.currentFrame);
 }
 
-void VulkanBase::setupSwapChain()
+void VulkanBase::drawUI(const VkCommandBuffer commandBuffer)
 {
-	swapChain.create(&width, &height, settings.vsync, settings.fullscreen);
+	if (settings.overlay && UIOverlay.visible) {
+		VkViewport viewport{};
+		viewport.width = (float)width;
+		viewport.height = (float)height;
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		VkRect2D scissor{};
+		scissor.extent.width = width;
+		scissor.extent.height = height;
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		UIOverlay.draw(commandBuffer, frameRing.currentFrame);
+	}
 }
 
-void VulkanBase::createCommandPool()
+void VulkanBase::OnUpdateUIOverlay(vks::UIOverlay* overlay)
 {
-	VkCommandPoolCreateInfo cmdPoolInfo = {};
-	cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	cmdPoolInfo.queueFamilyIndex = swapChain.queueNodeIndex;
-	cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-	VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &cmdPool));
+	profiler.drawUI(overlay);
 }
 
-void VulkanBase::createCommandBuffers()
+void VulkanBase::windowResize()
 {
-	// Create one command buffer for each swap chain image and reuse for rendering
-	drawCmdBuffers.resize(swapChain.imageCount);
+	if (!prepared) {
+		return;
+	}
+	// Nothing to render to while the window is minimized
+	if ((destWidth == 0) || (destHeight == 0)) {
+		return;
+	}
+	prepared = false;
+	resized = true;
+
+	// No vkDeviceWaitIdle here, frames in flight keep using the old resources and those are retired through the deletion queue once they have finished
+	width = destWidth;
+	height = destHeight;
+	setupSwapChain();
+
+	// Only size dependent resources are rebuilt, the render pass and pipelines stay (viewport and scissor are dynamic)
+	VkDevice device = this->device;
+	const VkImage oldDepthImage = depthStencil.image;
+	const VkImageView oldDepthView = depthStencil.view;
+	vks::Allocation oldDepthAllocation = depthStencil.allocation;
+	vks::VulkanDevice* vulkanDevice = this->vulkanDevice;
+	const std::vector<VkFramebuffer> oldFrameBuffers = frameBuffers;
+	deletionQueue.retire([=]() mutable {
+		for (auto frameBuffer : oldFrameBuffers) {
+			vkDestroyFramebuffer(device, frameBuffer, vks::HostAllocator::callbacks());
+		}
+		vkDestroyImageView(device, oldDepthView, vks::HostAllocator::callbacks());
+		vkDestroyImage(device, oldDepthImage, vks::HostAllocator::callbacks());
+		vulkanDevice->freeMemory(oldDepthAllocation);
+	});
+	setupDepthStencil();
+	setupFrameBuffer();
+
+	if ((width > 0.0f) && (height > 0.0f)) {
+		if (settings.overlay) {
+			UIOverlay.resize(width, height);
+		}
+		camera.updateAspectRatio((float)width / (float)height);
+	}
 
-	VkCommandBufferAllocateInfo cmdBufAllocateInfo =
-		vks::initializers::commandBufferAllocateInfo(
-			cmdPool,
-			VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-			static_cast<uint32_t>(drawCmdBuffers.size()));
+	// Notify derived class
+	windowResized();
 
-	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, drawCmdBuffers.data()));
+	prepared = true;
+}
+
+void VulkanBase::windowResized() {}
 
+void VulkanBase::setRecordThreads(uint32_t threadCount)
+{
+	settings.recordThreads = threadCount;
+	recorder.maxThreads = threadCount;
 }
 
-void VulkanBase::destroyCommandBuffers()
+void VulkanBase::runJobSystemBenchmark()
 {
-	vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(drawCmdBuffers.size()), drawCmdBuffers.data());
+	const uint32_t jobCount = 4096;
+	std::atomic<uint32_t> sink{ 0 };
+	std::cout << "job system threads: " << jobSystem.threadCount() << "\n";
+	// Round trip of a single job, measures how fast a sleeping worker picks up new work
+	benchmark.runMicro("spawn + wait latency", 1, [&] {
+		vks::JobSystem::Counter counter;
+		jobSystem.run([&] { sink.fetch_add(1, std::memory_order_relaxed); }, &counter);
+		jobSystem.wait(counter);
+	}, vulkanDevice->properties);
+	// All jobs land in the main thread's queue, so every job a worker executes has been stolen
+	benchmark.runMicro("spawn + steal throughput", jobCount, [&] {
+		vks::JobSystem::Counter counter;
+		for (uint32_t i = 0; i < jobCount; i++) {
+			jobSystem.run([&] { sink.fetch_add(1, std::memory_order_relaxed); }, &counter);
+		}
+		jobSystem.wait(counter);
+	}, vulkanDevice->properties);
+	// Chain of dependent jobs, measures the continuation overhead
+	benchmark.runMicro("dependency chain", 64, [&] {
+		vks::JobSystem::Counter counters[64];
+		jobSystem.run([&] { sink.fetch_add(1, std::memory_order_relaxed); }, &counters[0]);
+		for (uint32_t i = 1; i < 64; i++) {
+			jobSystem.runAfter(counters[i - 1], [&] { sink.fetch_add(1, std::memory_order_relaxed); }, &counters[i]);
+		}
+		jobSystem.wait(counters[63]);
+	}, vulkanDevice->properties);
+	benchmark.runMicro("parallelFor (1M elements)", 1 << 20, [&] {
+		jobSystem.parallelFor(1 << 20, 1024, [&](uint32_t begin, uint32_t end) { sink.fetch_add(end - begin, std::memory_order_relaxed); });
+	}, vulkanDevice->properties);
 }
-void VulkanBase::createSynchronizationPrimitives()
+
+void VulkanBase::runHostAllocatorBenchmark()
 {
-	// Wait fences to sync command buffer access
-	VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
-	waitFences.resize(drawCmdBuffers.size());
-	for (auto& fence : waitFences) {
-		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &fence));
+	// Depth attachment and frame buffers as created by prepare() and every resize, the objects in use are put back afterwards
+	benchmark.runMicro("depth stencil + frame buffers", 1, [&] {
+		const auto depthStencilInUse = depthStencil;
+		const std::vector<VkFramebuffer> frameBuffersInUse = frameBuffers;
+		setupDepthStencil();
+		setupFrameBuffer();
+		for (auto frameBuffer : frameBuffers) {
+			vkDestroyFramebuffer(device, frameBuffer, vks::HostAllocator::callbacks());
+		}
+		vkDestroyImageView(device, depthStencil.view, vks::HostAllocator::callbacks());
+		vkDestroyImage(device, depthStencil.image, vks::HostAllocator::callbacks());
+		vulkanDevice->freeMemory(depthStencil.allocation);
+		depthStencil = depthStencilInUse;
+		frameBuffers = frameBuffersInUse;
+	}, vulkanDevice->properties);
+	// Geometry buffers the UI overlay recreates whenever its vertex or index count changes
+	benchmark.runMicro("overlay geometry buffers", 2, [&] {
+		vks::Buffer vertexBuffer;
+		vks::Buffer indexBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createDynamicBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vertexBuffer, 64 * 1024, vks::MemoryTag::UI));
+		VK_CHECK_RESULT(vulkanDevice->createDynamicBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &indexBuffer, 32 * 1024, vks::MemoryTag::UI));
+		vertexBuffer.destroy();
+		indexBuffer.destroy();
+	}, vulkanDevice->properties);
+	// Sampler and descriptor objects of the UI overlay's font texture
+	benchmark.runMicro("overlay descriptors", 1, [&] {
+		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+		VkSampler sampler;
+		VK_CHECK_RESULT(vkCreateSampler(device, &samplerCI, vks::HostAllocator::callbacks(), &sampler));
+		std::vector<VkDescriptorPoolSize> poolSizes = { vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1) };
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
+		VkDescriptorPool descriptorPool;
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCI, vks::HostAllocator::callbacks(), &descriptorPool));
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = { vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0) };
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VkDescriptorSetLayout descriptorSetLayout;
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, vks::HostAllocator::callbacks(), &descriptorSetLayout));
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VkDescriptorSet descriptorSet;
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, vks::HostAllocator::callbacks());
+		vkDestroyDescriptorPool(device, descriptorPool, vks::HostAllocator::callbacks());
+		vkDestroySampler(device, sampler, vks::HostAllocator::callbacks());
+	}, vulkanDevice->properties);
+}
+
+void VulkanBase::initSwapchain()
+{
+	// Headless rendering uses a swap chain on a headless surface if available, and plain offscreen images otherwise
+	if (settings.headless) {
+#if defined(VK_USE_PLATFORM_HEADLESS_EXT)
+		if (headlessSurface) {
+			swapChain.initSurface(width, height);
+			return;
+		}
+#endif
+		swapChain.initOffscreen();
+		return;
 	}
+#if defined(_WIN32)
+	swapChain.initSurface(windowInstance, window);
+#endif
+}
+
+std::string VulkanBase::getWindowTitle()
+{
+	std::string device(deviceProperties.deviceName);
+	std::string windowTitle;
+	windowTitle = title + " - " + device;
+	if (!settings.overlay) {
+		windowTitle += " - " + std::to_string(0) + " fps";
+	}
+	return windowTitle;
+}
+
+void VulkanBase::setupSwapChain()
+{
+	// Recreating retires the old swap chain through the deletion queue instead of waiting for the device
+	swapChain.create(&width, &height, settings.vsync, settings.fullscreen, &deletionQueue);
 }
 
 void VulkanBase::setupDepthStencil()
 {
-	VkImageCreateInfo imageCI{};
-	imageCI.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-	imageCI.imageType = VK_IMAGE_TYPE_2D;
-	imageCI.format = depthFormat;
-	imageCI.extent ={width, height, 1};
-	imageCI.mipLevels = 1;
-	imageCI.arrayLayers = 1;
-	imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
-	imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-	imageCI.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-
-	VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &depthStencil.image));
-	VkMemoryRequirements memReqs{};
-	vkGetImageMemoryRequirements(device, depthStencil.image, &memReqs);
-
-	VkMemoryAllocateInfo memAlloc{};
-	memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
-	memAlloc.allocationSize = memReqs.size;
-	memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &depthStencil.mem))
-	VK_CHECK_RESULT(vkBindImageMemory(device, depthStencil.image, depthStencil.mem, 0));
+	// Unless a sample reads depth after the pass the image is transient, on tile based GPUs it then lives in tile memory only
+	VK_CHECK_RESULT(vulkanDevice->createAttachment(depthFormat, { width, height }, VK_SAMPLE_COUNT_1_BIT, depthStencil.usage, &depthStencil.image, &depthStencil.allocation));
 	
 	VkImageViewCreateInfo imageViewCI{};
 	imageViewCI.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -385,7 +987,7 @@ void VulkanBase::setupDepthStencil()
 	if (depthFormat >= VK_FORMAT_D16_UNORM_S8_UINT) {
 		imageViewCI.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
 	}
-	VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCI, nullptr, &depthStencil.view)); 
+	VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCI, vks::HostAllocator::callbacks(), &depthStencil.view)); 
 }
 
 void VulkanBase::setupRenderPass()
@@ -399,14 +1001,14 @@ void VulkanBase::setupRenderPass()
 	attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	attachments[0].finalLayout = swapChain.presentLayout();
 	// Depth attachment
 	attachments[1].format = depthFormat;
 	attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
 	attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachments[1].storeOp = vks::tools::attachmentStoreOp(depthStencil.usage);
 	attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[1].stencilStoreOp = vks::tools::attachmentStoreOp(depthStencil.usage);
 	attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 	attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
@@ -456,14 +1058,19 @@ void VulkanBase::setupRenderPass()
 	renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
 	renderPassInfo.pDependencies = dependencies.data();
 
-	VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass));
+	VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, vks::HostAllocator::callbacks(), &renderPass));
 }
 
 void VulkanBase::createPipelineCache()
 {
-	VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
-	pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-	VK_CHECK_RESULT(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
+	// Pipelines compiled by previous runs on the same device and driver don't have to be compiled again
+	const std::string pipelineCacheFileName = settings.pipelineCacheFile.empty() ? (name + ".pipelinecache") : settings.pipelineCacheFile;
+	pipelineCacheFile.create(vulkanDevice, pipelineCacheFileName);
+	pipelineCache = pipelineCacheFile.cache;
+	// Shaders whose pipelines are in the cache are loaded without creating their modules
+	shaderModuleCache.loadIdentifiers(pipelineCacheFileName + ".identifiers");
+	pipelineCompiler.create(device, pipelineCache, &jobSystem, &shaderModuleCache);
+	pipelineStates.create(&pipelineCompiler);
 }
 
 void VulkanBase::setupFrameBuffer()
@@ -488,7 +1095,7 @@ void VulkanBase::setupFrameBuffer()
 	for (uint32_t i = 0; i < frameBuffers.size(); i++)
 	{
 		attachments[0] = swapChain.buffers[i].view;
-		VK_CHECK_RESULT(vkCreateFramebuffer(device, &frameBufferCreateInfo, nullptr, &frameBuffers[i]));
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &frameBufferCreateInfo, vks::HostAllocator::callbacks(), &frameBuffers[i]));
 	}
 }
 
@@ -515,11 +1122,14 @@ VkResult VulkanBase::createInstance(bool enableValidation)
 	appInfo.pEngineName = name.c_str();
 	appInfo.apiVersion = apiVersion;
 
-	std::vector<const char*> instanceExtensions = { VK_KHR_SURFACE_EXTENSION_NAME };
+	std::vector<const char*> instanceExtensions;
 
+	if (!settings.headless) {
+		instanceExtensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
 #if defined(_WIN32)
-	instanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
 #endif
+	}
 
 	// Get extensions supported by the instance and store for later use
 	uint32_t extCount = 0;
@@ -552,6 +1162,27 @@ VkResult VulkanBase::createInstance(bool enableValidation)
 	instanceCreateInfo.pNext = NULL;
 	instanceCreateInfo.pApplicationInfo = &appInfo;
 
+#if defined(VK_USE_PLATFORM_HEADLESS_EXT)
+	// Prefer a headless surface so headless runs go through the same swap chain path as windowed ones (software implementations like lavapipe support it)
+	if (settings.headless) {
+		headlessSurface = (std::find(supportedInstanceExtensions.begin(), supportedInstanceExtensions.end(), VK_KHR_SURFACE_EXTENSION_NAME) != supportedInstanceExtensions.end())
+			&& (std::find(supportedInstanceExtensions.begin(), supportedInstanceExtensions.end(), VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME) != supportedInstanceExtensions.end());
+		if (headlessSurface) {
+			instanceExtensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
+			instanceExtensions.push_back(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
+		}
+	}
+#endif
+
+	// Device creation chains feature structures (e.g. for timeline semaphores), which needs VkPhysicalDeviceFeatures2 on 1.0 instances
+	if ((apiVersion < VK_API_VERSION_1_1) && std::find(supportedInstanceExtensions.begin(), supportedInstanceExtensions.end(), VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) != supportedInstanceExtensions.end()) {
+		instanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+	}
+	// Importing host memory builds on external memory, which is core in 1.1
+	if ((apiVersion < VK_API_VERSION_1_1) && std::find(supportedInstanceExtensions.begin(), supportedInstanceExtensions.end(), VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME) != supportedInstanceExtensions.end()) {
+		instanceExtensions.push_back(VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME);
+	}
+
 	// Enable the debug utils extension if available (e.g. when debugging tools are present)
 	if (settings.validation || std::find(supportedInstanceExtensions.begin(), supportedInstanceExtensions.end(), VK_EXT_DEBUG_UTILS_EXTENSION_NAME) != supportedInstanceExtensions.end()) {
 		instanceExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -588,7 +1219,7 @@ VkResult VulkanBase::createInstance(bool enableValidation)
 		}
 	}
 
-	VkResult result = vkCreateInstance(&instanceCreateInfo, nullptr, &instance);
+	VkResult result = vkCreateInstance(&instanceCreateInfo, vks::HostAllocator::callbacks(), &instance);
 
 	// If the debug utils extension is present we set up debug functions, so samples an label objects for debugging
 	if (std::find(supportedInstanceExtensions.begin(), supportedInstanceExtensions.end(), VK_EXT_DEBUG_UTILS_EXTENSION_NAME) != supportedInstanceExtensions.end()) {
@@ -17,6 +17,19 @@
 #include "VulkanTools.h"
 #include "VulkanSwapChain.h"
 #include "VulkanUIOverlay.h"
+#include "VulkanFrameRing.h"
+#include "VulkanDeletionQueue.h"
+#include "VulkanUploadBatch.h"
+#include "VulkanAsyncUploader.h"
+#include "VulkanFileUploader.h"
+#include "VulkanGeometryPool.h"
+#include "VulkanPipelineCacheFile.h"
+#include "VulkanPipelineCompiler.h"
+#include "VulkanPipelineBuilder.h"
+#include "VulkanShaderModuleCache.h"
+#include "VulkanJobSystem.h"
+#include "VulkanParallelRecorder.h"
+#include "VulkanProfiler.h"
 #include "camera.hpp"
 #include "benchmark.hpp"
 #include "CommandLineParser.hpp"
@@ -55,8 +68,38 @@ public:
 
 	virtual void setupFrameBuffer();
 
-		/** @brief Loads a SPIR-V shader file for the given shader stage */
+	/** @brief Loads a SPIR-V shader file for the given shader stage */
 	VkPipelineShaderStageCreateInfo loadShader(std::string fileName, VkShaderStageFlagBits stage);
+	/** @brief Loads a SPIR-V shader file for pipelineStates, its module is only created if a pipeline using it has to be compiled */
+	vks::ShaderId loadShaderDeferred(std::string fileName);
+
+	/** @brief Entry point for the main render loop (also runs the benchmark if requested) */
+	void renderLoop();
+
+	/** @brief Recreates the frame ring with a new number of frames in flight (waits for the device to become idle) */
+	void setFramesInFlight(uint32_t framesInFlight);
+
+	/** @brief (Virtual) Called after the frame ring has been recreated, derived samples need to update anything that references per-frame resources */
+	virtual void framesInFlightChanged();
+
+	/** @brief Limits the number of threads recording in parallel, 0 uses all job system threads */
+	void setRecordThreads(uint32_t threadCount);
+
+	/** @brief Builds the UI overlay's draw data for the current frame (only if the overlay is enabled) */
+	void updateOverlay();
+	/** @brief Records the UI overlay into the given command buffer, must be called inside the render pass (or in a secondary command buffer executed in it) after the scene */
+	void drawUI(const VkCommandBuffer commandBuffer);
+	/** @brief (Virtual) Called when the UI overlay is updated, derived samples can add their own UI elements (the default shows the GPU pass timings) */
+	virtual void OnUpdateUIOverlay(vks::UIOverlay* overlay);
+
+	/** @brief Recreates the swap chain and all size dependent resources without waiting for the device to become idle */
+	void windowResize();
+
+	/** @brief (Virtual) Called after the window has been resized, derived samples can recreate their own size dependent resources here */
+	virtual void windowResized();
+
+	/** @brief Command line arguments passed to the sample, need to be set before the sample is constructed */
+	static std::vector<const char*> args;
 
 public:
 	bool prepared = false;
@@ -67,8 +110,10 @@ public:
 
 	struct {
 		VkImage image;
-		VkDeviceMemory mem;
+		vks::Allocation allocation;
 		VkImageView view;
+		/** @brief Usage of the depth image, add e.g. VK_IMAGE_USAGE_SAMPLED_BIT before prepare() if depth is read after the render pass, else it's transient and never stored */
+		VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
 	} depthStencil;
 
 	vks::VulkanDevice* vulkanDevice;
@@ -77,6 +122,9 @@ public:
 
 	vks::Benchmark benchmark;
 
+	/** @brief Work stealing job system shared by the framework and the samples, one thread per hardware thread (the main thread is thread 0) */
+	vks::JobSystem jobSystem;
+
 	/** @brief Example settings that can be changed e.g. by command line arguments */
 	struct Settings {
 		/** @brief Activates validation layers (and message output) when set to true */
@@ -85,8 +133,24 @@ public:
 		bool fullscreen = false;
 		/** @brief Set to true if v-sync will be forced for the swapchain */
 		bool vsync = false;
+		/** @brief Render offscreen without a window and run the benchmark (set via --headless, always set on platforms without window system integration) */
+		bool headless = false;
 		/** @brief Enable UI overlay */
 		bool overlay = true;
+		/** @brief Number of frames the host may record ahead of the GPU (set via --frames-in-flight) */
+		uint32_t framesInFlight = 2;
+		/** @brief Number of threads recording secondary command buffers, 0 uses all job system threads (set via --record-threads) */
+		uint32_t recordThreads = 0;
+		/** @brief Number of draws per frame for samples that support stress testing (set via --draw-count) */
+		uint32_t drawCount = 1;
+		/** @brief Placement of per-frame uniform data and UI geometry (set via --dynamic-memory) */
+		vks::DynamicMemoryPolicy dynamicMemory = vks::DynamicMemoryPolicy::Auto;
+		/** @brief Allocation callbacks for the driver's host memory, run benchmarks once per allocator to compare them (set via --host-allocator) */
+		vks::HostAllocator::Mode hostAllocator = vks::HostAllocator::Mode::Driver;
+		/** @brief File the pipeline cache is kept in, empty for the sample's name with a .pipelinecache extension (set via --pipeline-cache) */
+		std::string pipelineCacheFile;
+		/** @brief Mesh file for samples that load their geometry from a file, empty for the built-in geometry (set via --geometry) */
+		std::string geometryFile;
 	} settings;
 
 	Camera camera;
@@ -130,16 +194,10 @@ protected:
 
 	VkFormat depthFormat;
 
-	VkCommandPool cmdPool;
-
 	VkPipelineStageFlags submitPipelineStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
-	VkSubmitInfo submitInfo;
-
 	VulkanSwapChain swapChain;
 
-	// Command buffers used for rendering
-	std::vector<VkCommandBuffer> drawCmdBuffers;
 	// Global render pass for frame buffer writes
 	VkRenderPass renderPass = VK_NULL_HANDLE;
 	// List of available frame buffers (same as number of swap chain images)
@@ -149,33 +207,68 @@ protected:
 
 	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
 
+	/** @brief Modules created by the sample itself, destroyed with the base class (modules from loadShader() belong to shaderModuleCache) */
 	std::vector<VkShaderModule> shaderModules;
+	/** @brief Shares modules between loads of the same SPIR-V code */
+	vks::ShaderModuleCache shaderModuleCache;
 
 	VkPipelineCache pipelineCache;	
+	/** @brief Keeps pipelineCache on disk, loaded in prepare(), saved periodically and on shutdown */
+	vks::PipelineCacheFile pipelineCacheFile;
+	/** @brief Compiles pipelines against pipelineCache on the job system, owns the pipelines it compiled */
+	vks::PipelineCompiler pipelineCompiler;
+	/** @brief Pipelines described with vks::PipelineBuilder, compiled by pipelineCompiler */
+	vks::PipelineStateCache pipelineStates;
 
-	struct {
-		// Swap chain image presentation
-		VkSemaphore presentComplete;
-		// Command buffer submission and execution
-		VkSemaphore renderComplete;
-	} semaphores;
-
-	std::vector<VkFence> waitFences;
 	bool requiresStencil{ false };
 
+	/** @brief Timeline of the graphics queue, every submission to it signals the next value */
+	vks::Timeline* queueTimeline = nullptr;
+	/** @brief Objects that submitted work may still reference, destroyed once the graphics queue's timeline has passed them */
+	vks::DeletionQueue deletionQueue;
+
+	/** @brief Per-frame timeline values, semaphores, command buffers and uniform space for all frames in flight */
+	vks::FrameRing frameRing;
+	/** @brief GPU timings of the passes samples wrap in profiler scopes, read back one frame ring cycle later */
+	vks::GpuProfiler profiler;
+	/** @brief Size of the dynamic uniform space per frame, set by derived samples before prepare() to allocate uniform blocks from frameRing.uniforms */
+	VkDeviceSize frameUniformCapacity = 0;
+	/** @brief Records draw lists into secondary command buffers on multiple threads, with separate command pools per thread and frame in flight */
+	vks::ParallelRecorder recorder;
+	/** @brief Streams uploads on the transfer queue, resources are handed over to the graphics queue with the frames submitted after them */
+	vks::AsyncUploader asyncUploader;
+	/** @brief Uploads from mapped asset files, copying straight from the file pages where host memory can be imported */
+	vks::FileUploader fileUploader;
+
+	/** @brief Waits for the current frame of the ring and acquires the next swap chain image into currentBuffer, returns false if the frame has to be skipped */
+	bool prepareFrame();
+	/** @brief Submits the current frame's command buffer, presents the image and advances the ring */
+	void submitFrame();
+
 
 private:
 	std::string getWindowTitle();
 	uint32_t destWidth;
 	uint32_t destHeight;
 	bool resizing = false;
+	/** @brief Set if headless rendering can present to a VK_EXT_headless_surface instead of plain offscreen images */
+	bool headlessSurface = false;
+	/** @brief Benchmark recording time per number of recording threads instead of frames in flight (set via --benchmarkrecording) */
+	bool benchmarkRecording = false;
+	/** @brief Run the job system micro benchmarks instead of the frame benchmarks (set via --benchmarkjobs) */
+	bool benchmarkJobs = false;
+	/** @brief Run the create/destroy micro benchmarks for comparing host allocators instead of the frame benchmarks (set via --benchmarkhostallocator) */
+	bool benchmarkHostAllocator = false;
+	/** @brief Driver host allocation counters at the start of the last frame, for the per-frame deltas reported to the benchmark */
+	vks::HostAllocationStats lastHostAllocationStats;
+	void runJobSystemBenchmark();
+	void runHostAllocatorBenchmark();
+	/** @brief Start of prepare(), the time until the first frame is reported as startup time */
+	std::chrono::high_resolution_clock::time_point prepareStart;
+	bool startupReported = false;
 	void initSwapchain();
 	void setupSwapChain();
 
-	void createCommandPool();
-	void createSynchronizationPrimitives();
-	void createCommandBuffers();
-	void destroyCommandBuffers();
 	void createPipelineCache();
 
 	std::string shaderDir = "glsl";
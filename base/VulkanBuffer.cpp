@@ -22,6 +22,14 @@ namespace vks
 	*/
 	VkResult Buffer::map(VkDeviceSize size, VkDeviceSize offset)
 	{
+		// Sub-allocated memory is shared with other resources and stays mapped by the allocator
+		if (allocation.valid()) {
+			if (!allocation.mapped) {
+				return VK_ERROR_MEMORY_MAP_FAILED;
+			}
+			mapped = static_cast<uint8_t*>(allocation.mapped) + offset;
+			return VK_SUCCESS;
+		}
 		return vkMapMemory(device, memory, offset, size, 0, &mapped);
 	}
 
@@ -34,7 +42,9 @@ namespace vks
 	{
 		if (mapped)
 		{
-			vkUnmapMemory(device, memory);
+			if (!allocation.valid()) {
+				vkUnmapMemory(device, memory);
+			}
 			mapped = nullptr;
 		}
 	}
@@ -48,7 +58,7 @@ namespace vks
 	*/
 	VkResult Buffer::bind(VkDeviceSize offset)
 	{
-		return vkBindBufferMemory(device, buffer, memory, offset);
+		return vkBindBufferMemory(device, buffer, memory, allocation.offset + offset);
 	}
 
 	/**
@@ -65,6 +75,40 @@ namespace vks
 		descriptor.range = size;
 	}
 
+	/**
+	* Get a view of a range of the buffer
+	*
+	* @param offset Byte offset of the range from the beginning of the buffer
+	* @param size Size of the range
+	*
+	* @return View with its descriptor set up for the whole range
+	*/
+	BufferView Buffer::view(VkDeviceSize offset, VkDeviceSize size) const
+	{
+		assert(offset + size <= this->size);
+		BufferView bufferView;
+		bufferView.buffer = buffer;
+		bufferView.offset = offset;
+		bufferView.size = size;
+		bufferView.mapped = mapped ? static_cast<uint8_t*>(mapped) + offset : nullptr;
+		bufferView.setupDescriptor();
+		return bufferView;
+	}
+
+	/**
+	* Setup the descriptor for a range of the view
+	*
+	* @param size (Optional) Size of the memory range of the descriptor, VK_WHOLE_SIZE covers the view up to its end (not the end of the buffer)
+	* @param offset (Optional) Byte offset from the beginning of the view
+	*/
+	void BufferView::setupDescriptor(VkDeviceSize size, VkDeviceSize offset)
+	{
+		assert(offset <= this->size);
+		descriptor.buffer = buffer;
+		descriptor.offset = this->offset + offset;
+		descriptor.range = (size == VK_WHOLE_SIZE) ? this->size - offset : size;
+	}
+
 	/**
 	* Copies the specified data to the mapped buffer
 	* 
@@ -93,8 +137,9 @@ namespace vks
 		VkMappedMemoryRange mappedRange = {};
 		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
 		mappedRange.memory = memory;
-		mappedRange.offset = offset;
-		mappedRange.size = size;
+		mappedRange.offset = allocation.offset + offset;
+		// The whole size would extend to the end of a shared memory block
+		mappedRange.size = (allocation.valid() && (size == VK_WHOLE_SIZE)) ? allocation.size - offset : size;
 		return vkFlushMappedMemoryRanges(device, 1, &mappedRange);
 	}
 
@@ -113,8 +158,9 @@ namespace vks
 		VkMappedMemoryRange mappedRange = {};
 		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
 		mappedRange.memory = memory;
-		mappedRange.offset = offset;
-		mappedRange.size = size;
+		mappedRange.offset = allocation.offset + offset;
+		// The whole size would extend to the end of a shared memory block
+		mappedRange.size = (allocation.valid() && (size == VK_WHOLE_SIZE)) ? allocation.size - offset : size;
 		return vkInvalidateMappedMemoryRanges(device, 1, &mappedRange);
 	}
 
@@ -125,11 +171,15 @@ namespace vks
 	{
 		if (buffer)
 		{
-			vkDestroyBuffer(device, buffer, nullptr);
+			vkDestroyBuffer(device, buffer, vks::HostAllocator::callbacks());
+		}
+		if (allocation.valid())
+		{
+			allocation.allocator->free(allocation);
 		}
-		if (memory)
+		else if (memory)
 		{
-			vkFreeMemory(device, memory, nullptr);
+			vkFreeMemory(device, memory, vks::HostAllocator::callbacks());
 		}
 	}
 };
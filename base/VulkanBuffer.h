@@ -14,9 +14,27 @@
 
 #include "vulkan/vulkan.h"
 #include "VulkanTools.h"
+#include "VulkanMemoryAllocator.h"
 
 namespace vks
 {	
+	/**
+	* @brief Range of a buffer, e.g. the data of a single mesh in a buffer shared by many
+	*
+	* Views don't own anything, the buffer they were taken from has to outlive them
+	*/
+	struct BufferView
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		/** @brief Start of the range in the buffer, pass it as the offset when binding the view */
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		/** @brief Host pointer to the start of the range if the buffer was mapped (from its start) when the view was taken */
+		void* mapped = nullptr;
+		VkDescriptorBufferInfo descriptor{};
+		void setupDescriptor(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+	};
+
 	/**
 	* @brief Encapsulates access to a Vulkan buffer backed up by device memory
 	* @note To be filled by an external source like the VulkanDevice
@@ -26,6 +44,8 @@ namespace vks
 		VkDevice device;
 		VkBuffer buffer = VK_NULL_HANDLE;
 		VkDeviceMemory memory = VK_NULL_HANDLE;
+		/** @brief Range of memory the buffer is bound to if it was sub-allocated by the device's allocator, offsets passed to the functions below are relative to it */
+		vks::Allocation allocation;
 		VkDescriptorBufferInfo descriptor;
 		VkDeviceSize size = 0;
 		VkDeviceSize alignment = 0;
@@ -38,6 +58,7 @@ namespace vks
 		void unmap();
 		VkResult bind(VkDeviceSize offset = 0);
 		void setupDescriptor(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+		BufferView view(VkDeviceSize offset, VkDeviceSize size) const;
 		void copyTo(void* data, VkDeviceSize size);
 		VkResult flush(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 		VkResult invalidate(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
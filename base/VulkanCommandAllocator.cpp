@@ -0,0 +1,96 @@
+/*
+* Transient command buffer allocator
+*
+* Hands out command buffers from a single transient pool that is reset as a whole
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanCommandAllocator.h"
+
+namespace vks
+{
+	/**
+	* Create the transient command pool
+	*
+	* @param device Logical device to create the pool on
+	* @param queueFamilyIndex Queue family the command buffers will be submitted to
+	*
+	* @note The pool is created without VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, individual command buffers can't be reset
+	*/
+	void CommandAllocator::create(VkDevice device, uint32_t queueFamilyIndex)
+	{
+		this->device = device;
+		VkCommandPoolCreateInfo cmdPoolInfo = vks::initializers::commandPoolCreateInfo();
+		cmdPoolInfo.queueFamilyIndex = queueFamilyIndex;
+		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, vks::HostAllocator::callbacks(), &pool));
+	}
+
+	/** @brief Destroy the pool, which also frees all command buffers allocated from it */
+	void CommandAllocator::destroy()
+	{
+		if (pool != VK_NULL_HANDLE) {
+			vkDestroyCommandPool(device, pool, vks::HostAllocator::callbacks());
+			pool = VK_NULL_HANDLE;
+		}
+		primary = List();
+		secondary = List();
+	}
+
+	/**
+	* Reset all command buffers allocated from this allocator at once
+	*
+	* @note Must only be called once the GPU has finished executing all of them (e.g. after the frame's fence signaled)
+	*/
+	void CommandAllocator::reset()
+	{
+		VK_CHECK_RESULT(vkResetCommandPool(device, pool, 0));
+		primary.used = 0;
+		secondary.used = 0;
+	}
+
+	/**
+	* Get a command buffer in the initial state
+	*
+	* @param level Level of the command buffer (primary or secondary)
+	*
+	* @return A command buffer that stays valid until the next reset()
+	*/
+	VkCommandBuffer CommandAllocator::get(VkCommandBufferLevel level)
+	{
+		List& list = (level == VK_COMMAND_BUFFER_LEVEL_PRIMARY) ? primary : secondary;
+		if (list.used == list.commandBuffers.size()) {
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(pool, level, 1);
+			VkCommandBuffer commandBuffer;
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &commandBuffer));
+			list.commandBuffers.push_back(commandBuffer);
+		}
+		return list.commandBuffers[list.used++];
+	}
+
+	/**
+	* Get a command buffer and start recording it for a single submission
+	*
+	* @param level Level of the command buffer (primary or secondary)
+	* @param inheritanceInfo (Optional) Inheritance info, required for secondary command buffers
+	*
+	* @return A command buffer in the recording state
+	*/
+	VkCommandBuffer CommandAllocator::begin(VkCommandBufferLevel level, const VkCommandBufferInheritanceInfo* inheritanceInfo)
+	{
+		VkCommandBuffer commandBuffer = get(level);
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		// Lets the driver skip tracking needed for resubmission
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		if (inheritanceInfo) {
+			cmdBufInfo.pInheritanceInfo = inheritanceInfo;
+			// Secondary command buffers that inherit a render pass are executed entirely inside it
+			if (inheritanceInfo->renderPass != VK_NULL_HANDLE) {
+				cmdBufInfo.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+			}
+		}
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		return commandBuffer;
+	}
+}
@@ -0,0 +1,45 @@
+/*
+* Transient command buffer allocator
+*
+* Hands out command buffers from a single transient pool that is reset as a whole
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Frame-local command buffer allocator backed by a VK_COMMAND_POOL_CREATE_TRANSIENT_BIT pool
+	*
+	* Command buffers are never reset individually, instead the whole pool is reset with vkResetCommandPool once
+	* the GPU is done with everything allocated from it. Buffers are kept in per-level lists and handed out again
+	* after a reset, so after the first few frames no further vkAllocateCommandBuffers calls happen
+	*/
+	class CommandAllocator
+	{
+	public:
+		VkDevice device = VK_NULL_HANDLE;
+		VkCommandPool pool = VK_NULL_HANDLE;
+
+		void create(VkDevice device, uint32_t queueFamilyIndex);
+		void destroy();
+		void reset();
+		VkCommandBuffer get(VkCommandBufferLevel level);
+		VkCommandBuffer begin(VkCommandBufferLevel level, const VkCommandBufferInheritanceInfo* inheritanceInfo = nullptr);
+
+	private:
+		struct List {
+			std::vector<VkCommandBuffer> commandBuffers;
+			uint32_t used = 0;
+		};
+		List primary;
+		List secondary;
+	};
+}
@@ -77,7 +77,7 @@ namespace vks
 			debugUtilsMessengerCI.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
 			debugUtilsMessengerCI.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT;
 			debugUtilsMessengerCI.pfnUserCallback = debugUtilsMessengerCallback;
-			VkResult result = vkCreateDebugUtilsMessengerEXT(instance, &debugUtilsMessengerCI, nullptr, &debugUtilsMessenger);
+			VkResult result = vkCreateDebugUtilsMessengerEXT(instance, &debugUtilsMessengerCI, vks::HostAllocator::callbacks(), &debugUtilsMessenger);
 			assert(result == VK_SUCCESS);
 		}
 
@@ -85,7 +85,7 @@ namespace vks
 		{
 			if (debugUtilsMessenger != VK_NULL_HANDLE)
 			{
-				vkDestroyDebugUtilsMessengerEXT(instance, debugUtilsMessenger, nullptr);
+				vkDestroyDebugUtilsMessengerEXT(instance, debugUtilsMessenger, vks::HostAllocator::callbacks());
 			}
 		}
 	}
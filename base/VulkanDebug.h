@@ -8,6 +8,7 @@
 
 #pragma once
 #include "vulkan/vulkan.h"
+#include "VulkanHostAllocator.h"
 
 #include <math.h>
 #include <stdlib.h>
@@ -0,0 +1,87 @@
+/*
+* Deletion queue
+*
+* Defers the destruction of Vulkan objects until the GPU is done with them
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanDeletionQueue.h"
+
+namespace vks
+{
+	/** @brief Set the timeline whose values the retired objects are tied to */
+	void DeletionQueue::create(vks::Timeline* timeline)
+	{
+		this->timeline = timeline;
+	}
+
+	/**
+	* Retire an object that may be referenced by any work submitted so far
+	*
+	* @param deleter Function destroying the object, called once everything submitted up to now has finished executing
+	*/
+	void DeletionQueue::retire(std::function<void()> deleter)
+	{
+		retire(timeline->submitted(), std::move(deleter));
+	}
+
+	/**
+	* Retire an object that is referenced by work up to the given timeline value
+	*
+	* @param timelineValue Timeline value that has to be reached before the object can be destroyed
+	* @param deleter Function destroying the object
+	*/
+	void DeletionQueue::retire(uint64_t timelineValue, std::function<void()> deleter)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		// Keep the queue sorted so collect() can stop at the first entry that isn't done yet
+		if (!entries.empty() && (entries.back().timelineValue > timelineValue)) {
+			timelineValue = entries.back().timelineValue;
+		}
+		entries.push_back({ timelineValue, std::move(deleter) });
+	}
+
+	/** @brief Run the deleters of all entries whose timeline value has been reached, never blocks */
+	void DeletionQueue::collect()
+	{
+		std::deque<Entry> done;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			while (!entries.empty() && timeline->reached(entries.front().timelineValue)) {
+				done.push_back(std::move(entries.front()));
+				entries.pop_front();
+			}
+		}
+		for (auto& entry : done) {
+			entry.deleter();
+		}
+	}
+
+	/**
+	* Run all remaining deleters
+	*
+	* @note Waits for the timeline to reach the last retired value, used on shutdown
+	*/
+	void DeletionQueue::flush()
+	{
+		std::deque<Entry> remaining;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			remaining.swap(entries);
+		}
+		if (!remaining.empty()) {
+			timeline->wait(remaining.back().timelineValue);
+		}
+		for (auto& entry : remaining) {
+			entry.deleter();
+		}
+	}
+
+	/** @brief Number of objects waiting to be destroyed */
+	size_t DeletionQueue::pending()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return entries.size();
+	}
+}
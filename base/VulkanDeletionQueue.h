@@ -0,0 +1,47 @@
+/*
+* Deletion queue
+*
+* Defers the destruction of Vulkan objects until the GPU is done with them
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <mutex>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTimeline.h"
+
+namespace vks
+{
+	/**
+	* @brief Queue of deleters that run once a queue's timeline has reached the value they were retired at
+	*
+	* Replaces vkDeviceWaitIdle before destroying objects that may still be referenced by submitted work
+	*/
+	class DeletionQueue
+	{
+	public:
+		void create(vks::Timeline* timeline);
+
+		void retire(std::function<void()> deleter);
+		void retire(uint64_t timelineValue, std::function<void()> deleter);
+		void collect();
+		void flush();
+
+		size_t pending();
+
+	private:
+		struct Entry {
+			uint64_t timelineValue;
+			std::function<void()> deleter;
+		};
+		vks::Timeline* timeline = nullptr;
+		/** @brief Entries in retirement order, values never decrease since they come from one timeline */
+		std::deque<Entry> entries;
+		std::mutex mutex;
+	};
+}
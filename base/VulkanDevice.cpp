@@ -64,13 +64,20 @@ namespace vks
 	*/
 	VulkanDevice::~VulkanDevice()
 	{
+		stagingRing.destroy();
+		for (auto& timeline : timelines)
+		{
+			timeline.second->destroy();
+		}
+		timelines.clear();
+		memoryAllocator.destroy();
 		if (commandPool)
 		{
-			vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
+			vkDestroyCommandPool(logicalDevice, commandPool, vks::HostAllocator::callbacks());
 		}
 		if (logicalDevice)
 		{
-			vkDestroyDevice(logicalDevice, nullptr);
+			vkDestroyDevice(logicalDevice, vks::HostAllocator::callbacks());
 		}
 	}
 
@@ -114,6 +121,105 @@ namespace vks
 		}
 	}
 
+	/**
+	* Get the size of the largest heap the host can write to directly that is device local
+	*
+	* @return Heap size in bytes, 0 if the device has no host visible (and coherent) device local memory
+	*
+	* @note Discrete GPUs without resizable BAR expose a 256 MB window, with it (or on unified memory) the heap covers all of device local memory
+	*/
+	VkDeviceSize VulkanDevice::hostVisibleDeviceLocalHeapSize() const
+	{
+		const VkMemoryPropertyFlags flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		VkDeviceSize heapSize = 0;
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+		{
+			if ((memoryProperties.memoryTypes[i].propertyFlags & flags) == flags)
+			{
+				heapSize = std::max(heapSize, memoryProperties.memoryHeaps[memoryProperties.memoryTypes[i].heapIndex].size);
+			}
+		}
+		return heapSize;
+	}
+
+	/**
+	* Get the memory properties to create buffers with that the host rewrites every frame
+	*
+	* @return Host visible and coherent properties, with the device local bit added if dynamicMemoryPolicy places dynamic data in device memory
+	*
+	* @note Device local host visible memory is usually write combined, write it sequentially (e.g. with memcpy) and never read from it.
+	* Static data should still be created device local and uploaded through the staging ring
+	*/
+	VkMemoryPropertyFlags VulkanDevice::dynamicMemoryProperties() const
+	{
+		// Anything up to the size of the legacy BAR window is a window, not all of device memory
+		const VkDeviceSize barWindowSize = 256ull * 1024 * 1024;
+		const VkDeviceSize heapSize = hostVisibleDeviceLocalHeapSize();
+		bool deviceLocal = false;
+		switch (dynamicMemoryPolicy)
+		{
+		case vks::DynamicMemoryPolicy::Auto:
+			deviceLocal = heapSize > barWindowSize;
+			break;
+		case vks::DynamicMemoryPolicy::DeviceLocal:
+			deviceLocal = heapSize > 0;
+			break;
+		case vks::DynamicMemoryPolicy::Host:
+			deviceLocal = false;
+			break;
+		}
+		const VkMemoryPropertyFlags hostFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		return deviceLocal ? (hostFlags | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) : hostFlags;
+	}
+
+	/**
+	* Get the index of the memory type for data the host rewrites every frame, with the properties of dynamicMemoryProperties()
+	*
+	* @param typeBits Bit mask with bits set for each memory type supported by the resource to request for (from VkMemoryRequirements)
+	* @param (Optional) memTypeFound Pointer to a bool that is set to true if a matching memory type has been found
+	*
+	* @return Index of the matching type with the fewest properties that weren't asked for, unlike getMemoryType() which returns the first match
+	* (so host placement doesn't land in a device local BAR type that happens to come first)
+	*
+	* @throw Throws an exception if memTypeFound is null and no memory type could be found that supports the requested properties
+	*/
+	uint32_t VulkanDevice::getDynamicMemoryType(uint32_t typeBits, VkBool32* memTypeFound) const
+	{
+		const VkMemoryPropertyFlags properties = dynamicMemoryProperties();
+		uint32_t bestType = VK_MAX_MEMORY_TYPES;
+		uint32_t bestExtraCount = UINT32_MAX;
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+		{
+			const VkMemoryPropertyFlags typeFlags = memoryProperties.memoryTypes[i].propertyFlags;
+			if (((typeBits >> i) & 1) == 0 || (typeFlags & properties) != properties)
+			{
+				continue;
+			}
+			uint32_t extraCount = 0;
+			for (VkMemoryPropertyFlags extra = typeFlags & ~properties; extra != 0; extra &= extra - 1)
+			{
+				extraCount++;
+			}
+			// Types with equal properties are ordered by performance, so ties go to the lower index
+			if (extraCount < bestExtraCount)
+			{
+				bestType = i;
+				bestExtraCount = extraCount;
+			}
+		}
+
+		if (memTypeFound)
+		{
+			*memTypeFound = (bestType != VK_MAX_MEMORY_TYPES);
+			return (bestType != VK_MAX_MEMORY_TYPES) ? bestType : 0;
+		}
+		if (bestType == VK_MAX_MEMORY_TYPES)
+		{
+			throw std::runtime_error("Could not find a matching memory type");
+		}
+		return bestType;
+	}
+
 	/**
 	* Get the index of a queue family that supports the requested queue flags
 	* SRS - support VkQueueFlags parameter for requesting multiple flags vs. VkQueueFlagBits for a single flag only
@@ -253,6 +359,25 @@ namespace vks
 			deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 		}
 
+		// All host/device synchronization is done with timeline semaphores, which are core in 1.2 and an extension before
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures{};
+		timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+		timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+		timelineSemaphoreFeatures.pNext = pNextChain;
+		if (extensionSupported(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME))
+		{
+			if (std::find_if(deviceExtensions.begin(), deviceExtensions.end(), [](const char* extension) { return strcmp(extension, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) == 0; }) == deviceExtensions.end())
+			{
+				deviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+			}
+		}
+		else if (properties.apiVersion < VK_API_VERSION_1_2)
+		{
+			std::cerr << "Timeline semaphores are not supported by the device\n";
+			return VK_ERROR_FEATURE_NOT_PRESENT;
+		}
+		pNextChain = &timelineSemaphoreFeatures;
+
 		VkDeviceCreateInfo deviceCreateInfo = {};
 		deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 		deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());;
@@ -292,18 +417,163 @@ namespace vks
 
 		this->enabledFeatures = enabledFeatures;
 
-		VkResult result = vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &logicalDevice);
+		VkResult result = vkCreateDevice(physicalDevice, &deviceCreateInfo, vks::HostAllocator::callbacks(), &logicalDevice);
 		if (result != VK_SUCCESS)
 		{
 			return result;
 		}
 
+		// Prefer the extension entry points, fall back to the core ones
+		timelineFunctions.getSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(vkGetDeviceProcAddr(logicalDevice, "vkGetSemaphoreCounterValueKHR"));
+		timelineFunctions.waitSemaphores = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(vkGetDeviceProcAddr(logicalDevice, "vkWaitSemaphoresKHR"));
+		timelineFunctions.signalSemaphore = reinterpret_cast<PFN_vkSignalSemaphoreKHR>(vkGetDeviceProcAddr(logicalDevice, "vkSignalSemaphoreKHR"));
+		if (!timelineFunctions.getSemaphoreCounterValue)
+		{
+			timelineFunctions.getSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(vkGetDeviceProcAddr(logicalDevice, "vkGetSemaphoreCounterValue"));
+			timelineFunctions.waitSemaphores = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(vkGetDeviceProcAddr(logicalDevice, "vkWaitSemaphores"));
+			timelineFunctions.signalSemaphore = reinterpret_cast<PFN_vkSignalSemaphoreKHR>(vkGetDeviceProcAddr(logicalDevice, "vkSignalSemaphore"));
+		}
+		if (!timelineFunctions.getSemaphoreCounterValue || !timelineFunctions.waitSemaphores || !timelineFunctions.signalSemaphore)
+		{
+			std::cerr << "Could not load the timeline semaphore functions\n";
+			return VK_ERROR_FEATURE_NOT_PRESENT;
+		}
+
+		if (std::find_if(deviceExtensions.begin(), deviceExtensions.end(), [](const char* extension) { return strcmp(extension, VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME) == 0; }) != deviceExtensions.end())
+		{
+			hostMemoryImport.getMemoryHostPointerProperties = reinterpret_cast<PFN_vkGetMemoryHostPointerPropertiesEXT>(vkGetDeviceProcAddr(logicalDevice, "vkGetMemoryHostPointerPropertiesEXT"));
+		}
+		if (!hostMemoryImport.getMemoryHostPointerProperties || (hostMemoryImport.minImportedHostPointerAlignment == 0))
+		{
+			hostMemoryImport.getMemoryHostPointerProperties = nullptr;
+			hostMemoryImport.minImportedHostPointerAlignment = 0;
+		}
+		if (std::find_if(deviceExtensions.begin(), deviceExtensions.end(), [](const char* extension) { return strcmp(extension, VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME) == 0; }) != deviceExtensions.end())
+		{
+			shaderModuleIdentifier.getShaderModuleIdentifier = reinterpret_cast<PFN_vkGetShaderModuleIdentifierEXT>(vkGetDeviceProcAddr(logicalDevice, "vkGetShaderModuleIdentifierEXT"));
+		}
+
 		// Create a default command pool for graphics command buffers
 		commandPool = createCommandPool(queueFamilyIndices.graphics);
 
+		// Budgets are only reported by the driver if the base enabled VK_EXT_memory_budget
+		const bool memoryBudget = std::find_if(deviceExtensions.begin(), deviceExtensions.end(), [](const char* extension) { return strcmp(extension, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0; }) != deviceExtensions.end();
+		memoryAllocator.create(physicalDevice, logicalDevice, memoryBudget ? getPhysicalDeviceMemoryProperties2 : nullptr);
+
+		// Uploads go through the same queue the examples render on, so later submissions see the data without further synchronization
+		VkQueue graphicsQueue;
+		vkGetDeviceQueue(logicalDevice, queueFamilyIndices.graphics, 0, &graphicsQueue);
+		stagingRing.create(this, graphicsQueue, queueFamilyIndices.graphics);
+
 		return result;
 	}
 
+	/**
+	* Allocate memory for a buffer from the device's allocator and bind it
+	*
+	* @param buffer Buffer to allocate memory for
+	* @param memoryPropertyFlags Memory properties the buffer's memory must have
+	* @param allocation Pointer to the allocation acquired by the function, release with freeMemory
+	* @param allocateFlags (Optional) Flags the memory has to be allocated with (e.g. VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT)
+	* @param tag (Optional) Category the memory is accounted to in the allocator's statistics
+	*
+	* @return VK_SUCCESS if memory has been allocated and bound
+	*/
+	VkResult VulkanDevice::allocateBufferMemory(VkBuffer buffer, VkMemoryPropertyFlags memoryPropertyFlags, vks::Allocation* allocation, VkMemoryAllocateFlags allocateFlags, vks::MemoryTag tag)
+	{
+		VkMemoryRequirements memReqs;
+		vkGetBufferMemoryRequirements(logicalDevice, buffer, &memReqs);
+		VkResult result = memoryAllocator.allocate(memReqs, getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags), vks::MemoryAllocator::ResourceType::Linear, allocation, allocateFlags, tag);
+		if (result != VK_SUCCESS) {
+			return result;
+		}
+		return vkBindBufferMemory(logicalDevice, buffer, allocation->memory, allocation->offset);
+	}
+
+	/**
+	* Allocate memory for an image from the device's allocator and bind it
+	*
+	* @param image Image to allocate memory for
+	* @param memoryPropertyFlags Memory properties the image's memory must have
+	* @param allocation Pointer to the allocation acquired by the function, release with freeMemory
+	* @param tiling (Optional) Tiling the image was created with, linear and optimal images are never placed next to each other
+	* @param tag (Optional) Category the memory is accounted to in the allocator's statistics
+	*
+	* @return VK_SUCCESS if memory has been allocated and bound
+	*/
+	VkResult VulkanDevice::allocateImageMemory(VkImage image, VkMemoryPropertyFlags memoryPropertyFlags, vks::Allocation* allocation, VkImageTiling tiling, vks::MemoryTag tag)
+	{
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(logicalDevice, image, &memReqs);
+		const vks::MemoryAllocator::ResourceType resourceType = (tiling == VK_IMAGE_TILING_LINEAR) ? vks::MemoryAllocator::ResourceType::Linear : vks::MemoryAllocator::ResourceType::Optimal;
+		VkResult result = memoryAllocator.allocate(memReqs, getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags), resourceType, allocation, 0, tag);
+		if (result != VK_SUCCESS) {
+			return result;
+		}
+		return vkBindImageMemory(logicalDevice, image, allocation->memory, allocation->offset);
+	}
+
+	/**
+	* Create a 2D attachment image (e.g. depth or multisampled color) and allocate its memory
+	*
+	* @param format Format of the attachment
+	* @param extent Size of the attachment
+	* @param samples Number of samples per texel
+	* @param usage Usage of the image, if it's only ever used as an attachment (see vks::tools::attachmentIsTransient) the image is created transient
+	* @param image Pointer to the image handle acquired by the function
+	* @param allocation Pointer to the memory allocation acquired by the function, release with freeMemory
+	*
+	* @note Transient images are backed by lazily allocated memory if the device has such a memory type, tile based GPUs then never
+	* have to commit memory for them as long as the attachment isn't loaded or stored (use vks::tools::attachmentStoreOp)
+	*
+	* @return VK_SUCCESS if the image has been created and memory bound to it
+	*/
+	VkResult VulkanDevice::createAttachment(VkFormat format, VkExtent2D extent, VkSampleCountFlagBits samples, VkImageUsageFlags usage, VkImage* image, vks::Allocation* allocation)
+	{
+		const bool transient = vks::tools::attachmentIsTransient(usage);
+		if (transient)
+		{
+			usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		}
+
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = format;
+		imageCI.extent = { extent.width, extent.height, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = samples;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = usage;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkResult result = vkCreateImage(logicalDevice, &imageCI, vks::HostAllocator::callbacks(), image);
+		if (result != VK_SUCCESS)
+		{
+			return result;
+		}
+
+		// Lazily allocated memory is optional (desktop GPUs usually don't have it), transient images work with regular device local memory as well
+		VkMemoryPropertyFlags memoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		if (transient)
+		{
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(logicalDevice, *image, &memReqs);
+			VkBool32 lazyTypeFound = VK_FALSE;
+			getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, &lazyTypeFound);
+			if (lazyTypeFound)
+			{
+				memoryPropertyFlags = VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+			}
+		}
+		return allocateImageMemory(*image, memoryPropertyFlags, allocation);
+	}
+
+	/** @brief Release memory acquired with allocateBufferMemory or allocateImageMemory, the resource bound to it must no longer be in use */
+	void VulkanDevice::freeMemory(vks::Allocation& allocation)
+	{
+		memoryAllocator.free(allocation);
+	}
+
 	/**
 	* Create a buffer on the device
 	*
@@ -311,55 +581,53 @@ namespace vks
 	* @param memoryPropertyFlags Memory properties for this buffer (i.e. device local, host visible, coherent)
 	* @param size Size of the buffer in byes
 	* @param buffer Pointer to the buffer handle acquired by the function
-	* @param memory Pointer to the memory handle acquired by the function
+	* @param allocation Pointer to the memory allocation acquired by the function, release with freeMemory
 	* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over)
+	* @param tag (Optional) Category the memory is accounted to in the allocator's statistics
+	*
+	* @note Data for memory that isn't host visible is copied through the staging ring, it is available to work submitted to the graphics queue after the next stagingRing.flush()
 	*
 	* @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been copied
 	*/
-	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer* buffer, VkDeviceMemory* memory, void* data)
+	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer* buffer, vks::Allocation* allocation, void* data, vks::MemoryTag tag)
 	{
+		// Data for memory the host can't write to is uploaded through the staging ring
+		const bool staged = (data != nullptr) && !(memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		if (staged)
+		{
+			usageFlags |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		}
+
 		// Create the buffer handle
 		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
 		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, buffer));
+		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, vks::HostAllocator::callbacks(), buffer));
 
-		// Create the memory backing up the buffer handle
-		VkMemoryRequirements memReqs;
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-		vkGetBufferMemoryRequirements(logicalDevice, *buffer, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		// Find a memory type index that fits the properties of the buffer
-		memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
+		// Sub-allocate the memory backing up the buffer handle and attach it to the buffer object
 		// If the buffer has VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set we also need to enable the appropriate flag during allocation
-		VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
-		if (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
-			allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR;
-			allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
-			memAlloc.pNext = &allocFlagsInfo;
-		}
-		VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, memory));
+		const VkMemoryAllocateFlags allocateFlags = (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) ? VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR : 0;
+		VK_CHECK_RESULT(allocateBufferMemory(*buffer, memoryPropertyFlags, allocation, allocateFlags, tag));
 
-		// If a pointer to the buffer data has been passed, map the buffer and copy over the data
-		if (data != nullptr)
+		// If a pointer to the buffer data has been passed, copy it over through the allocator's persistent mapping
+		if (staged)
 		{
-			void* mapped;
-			VK_CHECK_RESULT(vkMapMemory(logicalDevice, *memory, 0, size, 0, &mapped));
-			memcpy(mapped, data, size);
+			stagingRing.upload(*buffer, 0, data, size);
+		}
+		else if (data != nullptr)
+		{
+			assert(allocation->mapped);
+			memcpy(allocation->mapped, data, size);
 			// If host coherency hasn't been requested, do a manual flush to make writes visible
 			if ((memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
 			{
 				VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
-				mappedRange.memory = *memory;
-				mappedRange.offset = 0;
-				mappedRange.size = size;
+				mappedRange.memory = allocation->memory;
+				mappedRange.offset = allocation->offset;
+				mappedRange.size = allocation->size;
 				vkFlushMappedMemoryRanges(logicalDevice, 1, &mappedRange);
 			}
-			vkUnmapMemory(logicalDevice, *memory);
 		}
 
-		// Attach the memory to the buffer object
-		VK_CHECK_RESULT(vkBindBufferMemory(logicalDevice, *buffer, *memory, 0));
-
 		return VK_SUCCESS;
 	}
 
@@ -371,32 +639,34 @@ namespace vks
 	* @param buffer Pointer to a vk::Vulkan buffer object
 	* @param size Size of the buffer in bytes
 	* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over)
+	* @param tag (Optional) Category the memory is accounted to in the allocator's statistics
+	*
+	* @note Data for memory that isn't host visible is copied through the staging ring, it is available to work submitted to the graphics queue after the next stagingRing.flush()
 	*
 	* @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been copied
 	*/
-	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer* buffer, VkDeviceSize size, void* data)
+	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer* buffer, VkDeviceSize size, void* data, vks::MemoryTag tag)
 	{
 		buffer->device = logicalDevice;
 
+		// Data for memory the host can't write to is uploaded through the staging ring
+		const bool staged = (data != nullptr) && !(memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		if (staged)
+		{
+			usageFlags |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		}
+
 		// Create the buffer handle
 		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
-		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &buffer->buffer));
+		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, vks::HostAllocator::callbacks(), &buffer->buffer));
 
-		// Create the memory backing up the buffer handle
+		// Sub-allocate the memory backing up the buffer handle
 		VkMemoryRequirements memReqs;
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 		vkGetBufferMemoryRequirements(logicalDevice, buffer->buffer, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		// Find a memory type index that fits the properties of the buffer
-		memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
 		// If the buffer has VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set we also need to enable the appropriate flag during allocation
-		VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
-		if (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
-			allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR;
-			allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
-			memAlloc.pNext = &allocFlagsInfo;
-		}
-		VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, &buffer->memory));
+		const VkMemoryAllocateFlags allocateFlags = (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) ? VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR : 0;
+		VK_CHECK_RESULT(memoryAllocator.allocate(memReqs, getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags), vks::MemoryAllocator::ResourceType::Linear, &buffer->allocation, allocateFlags, tag));
+		buffer->memory = buffer->allocation.memory;
 
 		buffer->alignment = memReqs.alignment;
 		buffer->size = size;
@@ -404,7 +674,7 @@ namespace vks
 		buffer->memoryPropertyFlags = memoryPropertyFlags;
 
 		// If a pointer to the buffer data has been passed, map the buffer and copy over the data
-		if (data != nullptr)
+		if (data != nullptr && !staged)
 		{
 			VK_CHECK_RESULT(buffer->map());
 			memcpy(buffer->mapped, data, size);
@@ -418,7 +688,90 @@ namespace vks
 		buffer->setupDescriptor();
 
 		// Attach the memory to the buffer object
-		return buffer->bind();
+		VK_CHECK_RESULT(buffer->bind());
+
+		// Copies can only be recorded once the buffer is bound
+		if (staged)
+		{
+			stagingRing.upload(buffer->buffer, 0, data, size);
+		}
+
+		return VK_SUCCESS;
+	}
+
+	/**
+	* Create a persistently rewritten buffer (per-frame uniform data, UI geometry) in the memory type of getDynamicMemoryType()
+	*
+	* @param usageFlags Usage flag bit mask for the buffer
+	* @param buffer Pointer to a vk::Vulkan buffer object
+	* @param size Size of the buffer in bytes
+	* @param tag (Optional) Category the memory is accounted to in the allocator's statistics
+	*
+	* @return VK_SUCCESS if buffer handle and memory have been created
+	*/
+	VkResult VulkanDevice::createDynamicBuffer(VkBufferUsageFlags usageFlags, vks::Buffer* buffer, VkDeviceSize size, vks::MemoryTag tag)
+	{
+		buffer->device = logicalDevice;
+
+		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
+		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, vks::HostAllocator::callbacks(), &buffer->buffer));
+
+		VkMemoryRequirements memReqs;
+		vkGetBufferMemoryRequirements(logicalDevice, buffer->buffer, &memReqs);
+		const uint32_t memoryTypeIndex = getDynamicMemoryType(memReqs.memoryTypeBits);
+		VK_CHECK_RESULT(memoryAllocator.allocate(memReqs, memoryTypeIndex, vks::MemoryAllocator::ResourceType::Linear, &buffer->allocation, 0, tag));
+		buffer->memory = buffer->allocation.memory;
+
+		buffer->alignment = memReqs.alignment;
+		buffer->size = size;
+		buffer->usageFlags = usageFlags;
+		buffer->memoryPropertyFlags = memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+
+		buffer->setupDescriptor();
+		VK_CHECK_RESULT(buffer->bind());
+		return VK_SUCCESS;
+	}
+
+	/**
+	* Create a buffer that the graphics and the transfer queue families can access at the same time
+	*
+	* @param usageFlags Usage flag bit mask for the buffer
+	* @param memoryPropertyFlags Memory properties for this buffer
+	* @param buffer Pointer to a vk::Vulkan buffer object
+	* @param size Size of the buffer in bytes
+	* @param tag (Optional) Category the memory is accounted to in the allocator's statistics
+	*
+	* @note For buffers that are updated in parts on the transfer queue while the graphics queue uses other parts of them (see vks::AsyncUploader),
+	* which exclusive ownership would have to hand back and forth as a whole. Exclusive if both families are the same
+	*
+	* @return VK_SUCCESS if buffer handle and memory have been created
+	*/
+	VkResult VulkanDevice::createSharedBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer* buffer, VkDeviceSize size, vks::MemoryTag tag)
+	{
+		buffer->device = logicalDevice;
+
+		const uint32_t queueFamilies[] = { queueFamilyIndices.graphics, queueFamilyIndices.transfer };
+		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
+		if (queueFamilyIndices.transfer != queueFamilyIndices.graphics) {
+			bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			bufferCreateInfo.queueFamilyIndexCount = 2;
+			bufferCreateInfo.pQueueFamilyIndices = queueFamilies;
+		}
+		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, vks::HostAllocator::callbacks(), &buffer->buffer));
+
+		VkMemoryRequirements memReqs;
+		vkGetBufferMemoryRequirements(logicalDevice, buffer->buffer, &memReqs);
+		VK_CHECK_RESULT(memoryAllocator.allocate(memReqs, getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags), vks::MemoryAllocator::ResourceType::Linear, &buffer->allocation, 0, tag));
+		buffer->memory = buffer->allocation.memory;
+
+		buffer->alignment = memReqs.alignment;
+		buffer->size = size;
+		buffer->usageFlags = usageFlags;
+		buffer->memoryPropertyFlags = memoryPropertyFlags;
+
+		buffer->setupDescriptor();
+		VK_CHECK_RESULT(buffer->bind());
+		return VK_SUCCESS;
 	}
 
 	/**
@@ -430,6 +783,7 @@ namespace vks
 	* @param copyRegion (Optional) Pointer to a copy region, if NULL, the whole buffer is copied
 	*
 	* @note Source and destination pointers must have the appropriate transfer usage flags set (TRANSFER_SRC / TRANSFER_DST)
+	* @note Submits and waits for every single copy, use vks::UploadBatch to submit the copies of many resources at once without blocking
 	*/
 	void VulkanDevice::copyBuffer(vks::Buffer* src, vks::Buffer* dst, VkQueue queue, VkBufferCopy* copyRegion)
 	{
@@ -468,7 +822,7 @@ namespace vks
 		cmdPoolInfo.queueFamilyIndex = queueFamilyIndex;
 		cmdPoolInfo.flags = createFlags;
 		VkCommandPool cmdPool;
-		VK_CHECK_RESULT(vkCreateCommandPool(logicalDevice, &cmdPoolInfo, nullptr, &cmdPool));
+		VK_CHECK_RESULT(vkCreateCommandPool(logicalDevice, &cmdPoolInfo, vks::HostAllocator::callbacks(), &cmdPool));
 		return cmdPool;
 	}
 
@@ -500,6 +854,41 @@ namespace vks
 		return createCommandBuffer(level, commandPool, begin);
 	}
 
+	/**
+	* Get the timeline semaphore of a queue, creating it on first use
+	*
+	* @param queue Queue to get the timeline for
+	*
+	* @note Every submission to the queue should go through its timeline so the timeline values stay in submission order
+	*
+	* @return The queue's timeline
+	*/
+	vks::Timeline* VulkanDevice::getTimeline(VkQueue queue)
+	{
+		std::lock_guard<std::mutex> lock(timelinesMutex);
+		std::unique_ptr<vks::Timeline>& timeline = timelines[queue];
+		if (!timeline)
+		{
+			timeline.reset(new vks::Timeline());
+			timeline->create(logicalDevice, &timelineFunctions);
+		}
+		return timeline.get();
+	}
+
+	/**
+	* Finish command buffer recording and submit it to a queue without waiting for it
+	*
+	* @param commandBuffer Command buffer to submit
+	* @param queue Queue to submit the command buffer to
+	*
+	* @return Value of the queue's timeline that is reached once the command buffer has finished executing
+	*/
+	uint64_t VulkanDevice::submitCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue)
+	{
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+		return getTimeline(queue)->submit(queue, &commandBuffer, 1);
+	}
+
 	/**
 	* Finish command buffer recording and submit it to a queue
 	*
@@ -509,7 +898,7 @@ namespace vks
 	* @param free (Optional) Free the command buffer once it has been submitted (Defaults to true)
 	*
 	* @note The queue that the command buffer is submitted to must be from the same family index as the pool it was allocated from
-	* @note Uses a fence to ensure command buffer has finished executing
+	* @note Waits on the queue's timeline until the command buffer has finished executing
 	*/
 	void VulkanDevice::flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, VkCommandPool pool, bool free)
 	{
@@ -518,20 +907,8 @@ namespace vks
 			return;
 		}
 
-		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
-
-		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffer;
-		// Create fence to ensure that the command buffer has finished executing
-		VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
-		VkFence fence;
-		VK_CHECK_RESULT(vkCreateFence(logicalDevice, &fenceInfo, nullptr, &fence));
-		// Submit to the queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
-		// Wait for the fence to signal that command buffer has finished executing
-		VK_CHECK_RESULT(vkWaitForFences(logicalDevice, 1, &fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
-		vkDestroyFence(logicalDevice, fence, nullptr);
+		const uint64_t value = submitCommandBuffer(commandBuffer, queue);
+		VK_CHECK_RESULT(getTimeline(queue)->wait(value, DEFAULT_FENCE_TIMEOUT));
 		if (free)
 		{
 			vkFreeCommandBuffers(logicalDevice, pool, 1, &commandBuffer);
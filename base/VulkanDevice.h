@@ -12,13 +12,30 @@
 
 #include "VulkanBuffer.h"
 #include "VulkanTools.h"
+#include "VulkanTimeline.h"
+#include "VulkanMemoryAllocator.h"
+#include "VulkanStagingRing.h"
 #include "vulkan/vulkan.h"
 #include <algorithm>
 #include <assert.h>
 #include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
 
 namespace vks
 {
+/** @brief Placement of memory the host rewrites every frame (per-frame uniform data, UI geometry), see VulkanDevice::dynamicMemoryProperties */
+enum class DynamicMemoryPolicy
+{
+	/** @brief Device local memory if all of it is host visible (resizable BAR or unified memory), host memory otherwise */
+	Auto,
+	/** @brief Host visible device local memory whenever there is some, including a small (256 MB) BAR window */
+	DeviceLocal,
+	/** @brief Host memory the device reads over the bus */
+	Host
+};
+
 struct VulkanDevice
 {
 	/** @brief Physical device representation */
@@ -39,6 +56,32 @@ struct VulkanDevice
 	std::vector<std::string> supportedExtensions;
 	/** @brief Default command pool for the graphics queue family index */
 	VkCommandPool commandPool = VK_NULL_HANDLE;
+	/** @brief Timeline semaphore entry points (core in Vulkan 1.2, VK_KHR_timeline_semaphore before) */
+	vks::TimelineFunctions timelineFunctions;
+	/** @brief One timeline per queue, created on first use */
+	std::map<VkQueue, std::unique_ptr<vks::Timeline>> timelines;
+	std::mutex timelinesMutex;
+	/** @brief Importing host pointers as device memory (VK_EXT_external_memory_host), the entry point is only loaded if the extension has been enabled */
+	struct
+	{
+		VkDeviceSize minImportedHostPointerAlignment = 0;
+		PFN_vkGetMemoryHostPointerPropertiesEXT getMemoryHostPointerProperties = nullptr;
+	} hostMemoryImport;
+	/** @brief Shader module identifiers (VK_EXT_shader_module_identifier), the entry point is only loaded if the extension has been enabled */
+	struct
+	{
+		PFN_vkGetShaderModuleIdentifierEXT getShaderModuleIdentifier = nullptr;
+		/** @brief Identifiers stored with a different algorithm UUID don't match the modules of this device and driver */
+		uint8_t algorithmUUID[VK_UUID_SIZE] = {};
+	} shaderModuleIdentifier;
+	/** @brief vkGetPhysicalDeviceMemoryProperties2, set before device creation to have the allocator query VK_EXT_memory_budget (the extension has to be enabled as well) */
+	PFN_vkGetPhysicalDeviceMemoryProperties2KHR getPhysicalDeviceMemoryProperties2 = nullptr;
+	/** @brief Where dynamic data is placed, set before resources are created (e.g. from the command line for A/B comparisons) */
+	vks::DynamicMemoryPolicy dynamicMemoryPolicy = vks::DynamicMemoryPolicy::Auto;
+	/** @brief Sub-allocates resource memory from large blocks, created with the logical device */
+	vks::MemoryAllocator memoryAllocator;
+	/** @brief Persistently mapped upload ring, copies are submitted to the first graphics queue */
+	vks::StagingRing stagingRing;
 	/** @brief Contains queue family indices */
 	struct
 	{
@@ -53,14 +96,25 @@ struct VulkanDevice
 	explicit VulkanDevice(VkPhysicalDevice physicalDevice);
 	~VulkanDevice();
 	uint32_t        getMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties, VkBool32 *memTypeFound = nullptr) const;
+	VkDeviceSize    hostVisibleDeviceLocalHeapSize() const;
+	VkMemoryPropertyFlags dynamicMemoryProperties() const;
+	uint32_t        getDynamicMemoryType(uint32_t typeBits, VkBool32 *memTypeFound = nullptr) const;
 	uint32_t        getQueueFamilyIndex(VkQueueFlags queueFlags) const;
 	VkResult        createLogicalDevice(VkPhysicalDeviceFeatures enabledFeatures, std::vector<const char *> enabledExtensions, void *pNextChain, bool useSwapChain = true, VkQueueFlags requestedQueueTypes = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
-	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory, void *data = nullptr);
-	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data = nullptr);
+	VkResult        allocateBufferMemory(VkBuffer buffer, VkMemoryPropertyFlags memoryPropertyFlags, vks::Allocation *allocation, VkMemoryAllocateFlags allocateFlags = 0, vks::MemoryTag tag = vks::MemoryTag::Buffer);
+	VkResult        allocateImageMemory(VkImage image, VkMemoryPropertyFlags memoryPropertyFlags, vks::Allocation *allocation, VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL, vks::MemoryTag tag = vks::MemoryTag::Image);
+	void            freeMemory(vks::Allocation &allocation);
+	VkResult        createAttachment(VkFormat format, VkExtent2D extent, VkSampleCountFlagBits samples, VkImageUsageFlags usage, VkImage *image, vks::Allocation *allocation);
+	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, vks::Allocation *allocation, void *data = nullptr, vks::MemoryTag tag = vks::MemoryTag::Buffer);
+	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data = nullptr, vks::MemoryTag tag = vks::MemoryTag::Buffer);
+	VkResult        createDynamicBuffer(VkBufferUsageFlags usageFlags, vks::Buffer *buffer, VkDeviceSize size, vks::MemoryTag tag = vks::MemoryTag::Buffer);
+	VkResult        createSharedBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, vks::MemoryTag tag = vks::MemoryTag::Buffer);
 	void            copyBuffer(vks::Buffer *src, vks::Buffer *dst, VkQueue queue, VkBufferCopy *copyRegion = nullptr);
 	VkCommandPool   createCommandPool(uint32_t queueFamilyIndex, VkCommandPoolCreateFlags createFlags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 	VkCommandBuffer createCommandBuffer(VkCommandBufferLevel level, VkCommandPool pool, bool begin = false);
 	VkCommandBuffer createCommandBuffer(VkCommandBufferLevel level, bool begin = false);
+	vks::Timeline*  getTimeline(VkQueue queue);
+	uint64_t        submitCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue);
 	void            flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, VkCommandPool pool, bool free = true);
 	void            flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, bool free = true);
 	bool            extensionSupported(std::string extension);
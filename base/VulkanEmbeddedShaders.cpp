@@ -0,0 +1,40 @@
+/*
+* Embedded shaders
+*
+* SPIR-V compiled into the executable at build time (see shaders/CMakeLists.txt)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanEmbeddedShaders.h"
+
+#include <string.h>
+
+namespace vks
+{
+	/**
+	* Find the embedded SPIR-V for a shader file
+	*
+	* @param fileName Path the shader would be loaded from, shaders are matched by their path relative to the shaders directory (wherever that is)
+	*
+	* @return The embedded shader, nullptr if the shader has to be loaded from disk
+	*/
+	const EmbeddedShader* findEmbeddedShader(const std::string& fileName)
+	{
+		for (const EmbeddedShader* shader = embeddedShaders; shader->path != nullptr; shader++) {
+			const size_t pathLength = strlen(shader->path);
+			if ((fileName.size() < pathLength) || (fileName.compare(fileName.size() - pathLength, pathLength, shader->path) != 0)) {
+				continue;
+			}
+			// Only whole path components, so e.g. myglsl/... doesn't match glsl/...
+			if (fileName.size() == pathLength) {
+				return shader;
+			}
+			const char separator = fileName[fileName.size() - pathLength - 1];
+			if ((separator == '/') || (separator == '\\')) {
+				return shader;
+			}
+		}
+		return nullptr;
+	}
+}
@@ -0,0 +1,31 @@
+/*
+* Embedded shaders
+*
+* SPIR-V compiled into the executable at build time (see shaders/CMakeLists.txt)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace vks
+{
+	/** @brief SPIR-V of a shader embedded at build time */
+	struct EmbeddedShader
+	{
+		/** @brief Path relative to the shaders directory, e.g. glsl/triangle/triangle.vert.spv */
+		const char* path;
+		const uint32_t* code;
+		/** @brief Size of the code in bytes */
+		size_t size;
+	};
+
+	/** @brief All embedded shaders, generated at build time, the last entry has a null path */
+	extern const EmbeddedShader embeddedShaders[];
+
+	const EmbeddedShader* findEmbeddedShader(const std::string& fileName);
+}
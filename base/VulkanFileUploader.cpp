@@ -0,0 +1,212 @@
+/*
+* File uploader
+*
+* Uploads the contents of mapped files, importing the mapped pages as staging buffers where the device allows it
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanFileUploader.h"
+#include <algorithm>
+
+namespace vks
+{
+	/** @brief Set up the uploader, imports are only attempted if the device has VK_EXT_external_memory_host enabled */
+	void FileUploader::create(vks::VulkanDevice* device)
+	{
+		this->device = device;
+		importedBytes = 0;
+		stagedBytes = 0;
+	}
+
+	/** @brief Wait for all uploads from imported files and release the imports */
+	void FileUploader::destroy()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		// Imports that were never retired may still be read by a batch submitted without the uploader knowing
+		bool unretired = false;
+		for (Import& entry : imports) {
+			unretired = unretired || !entry.retired;
+		}
+		if (unretired) {
+			VK_CHECK_RESULT(vkDeviceWaitIdle(device->logicalDevice));
+		}
+		for (Import& entry : imports) {
+			entry.token.wait();
+			release(entry);
+		}
+		imports.clear();
+	}
+
+	/** @brief True if file pages can be imported as device memory */
+	bool FileUploader::importSupported() const
+	{
+		return (device != nullptr) && (device->hostMemoryImport.getMemoryHostPointerProperties != nullptr);
+	}
+
+	void FileUploader::release(Import& import)
+	{
+		if (import.buffer != VK_NULL_HANDLE) {
+			vkDestroyBuffer(device->logicalDevice, import.buffer, vks::HostAllocator::callbacks());
+			vkFreeMemory(device->logicalDevice, import.memory, vks::HostAllocator::callbacks());
+		}
+		import.buffer = VK_NULL_HANDLE;
+		import.memory = VK_NULL_HANDLE;
+		import.file.reset();
+	}
+
+	/** @brief Import of a file for the batch currently being filled, imports each file only once per batch */
+	FileUploader::Import FileUploader::import(const std::shared_ptr<vks::MappedFile>& file)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (const Import& entry : imports) {
+			if (!entry.retired && (entry.file == file)) {
+				return entry;
+			}
+		}
+
+		// Failed imports are remembered as well, so they aren't retried for every range of the file
+		Import entry{ file, VK_NULL_HANDLE, VK_NULL_HANDLE, 0, UploadToken(), false };
+		const VkDeviceSize alignment = importSupported() ? device->hostMemoryImport.minImportedHostPointerAlignment : 0;
+		// Only whole aligned blocks of the mapping can be imported, the remainder at the end of the file is staged
+		const VkDeviceSize importSize = (alignment > 0) ? (file->mappedSize() / alignment * alignment) : 0;
+		if ((importSize > 0) && (reinterpret_cast<uintptr_t>(file->data()) % alignment == 0)) {
+			void* hostPointer = const_cast<uint8_t*>(file->data());
+			VkMemoryHostPointerPropertiesEXT hostPointerProperties{};
+			hostPointerProperties.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT;
+			VkResult result = device->hostMemoryImport.getMemoryHostPointerProperties(device->logicalDevice, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT, hostPointer, &hostPointerProperties);
+
+			VkExternalMemoryBufferCreateInfo externalMemoryBufferCI{};
+			externalMemoryBufferCI.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO;
+			externalMemoryBufferCI.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+			VkBufferCreateInfo bufferCI = vks::initializers::bufferCreateInfo(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, importSize);
+			bufferCI.pNext = &externalMemoryBufferCI;
+			if ((result == VK_SUCCESS) && (vkCreateBuffer(device->logicalDevice, &bufferCI, vks::HostAllocator::callbacks(), &entry.buffer) == VK_SUCCESS)) {
+				VkMemoryRequirements memReqs;
+				vkGetBufferMemoryRequirements(device->logicalDevice, entry.buffer, &memReqs);
+				const uint32_t typeBits = memReqs.memoryTypeBits & hostPointerProperties.memoryTypeBits;
+				// Coherent memory needs no flush, the file contents are written by the kernel and never through a Vulkan mapping
+				VkBool32 typeFound = VK_FALSE;
+				uint32_t memoryTypeIndex = device->getMemoryType(typeBits, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &typeFound);
+				if (!typeFound) {
+					memoryTypeIndex = device->getMemoryType(typeBits, 0, &typeFound);
+				}
+				VkImportMemoryHostPointerInfoEXT importInfo{};
+				importInfo.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT;
+				importInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+				importInfo.pHostPointer = hostPointer;
+				VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+				memAlloc.pNext = &importInfo;
+				memAlloc.allocationSize = importSize;
+				memAlloc.memoryTypeIndex = memoryTypeIndex;
+				if (typeFound && (vkAllocateMemory(device->logicalDevice, &memAlloc, vks::HostAllocator::callbacks(), &entry.memory) == VK_SUCCESS)) {
+					if (vkBindBufferMemory(device->logicalDevice, entry.buffer, entry.memory, 0) == VK_SUCCESS) {
+						entry.size = importSize;
+					}
+				}
+				if (entry.size == 0) {
+					release(entry);
+					entry.file = file;
+				}
+			}
+			else {
+				entry.buffer = VK_NULL_HANDLE;
+			}
+		}
+		imports.push_back(entry);
+		return entry;
+	}
+
+	/**
+	* Add an upload of a range of a mapped file to a buffer
+	*
+	* @param batch Batch to add the copies to
+	* @param file Mapped file, kept mapped until the batch has finished
+	* @param fileOffset Start of the range in the file
+	* @param size Size of the range
+	* @param dst Buffer to copy to, needs VK_BUFFER_USAGE_TRANSFER_DST_BIT
+	* @param dstOffset Offset in the destination buffer
+	*/
+	void FileUploader::upload(vks::UploadBatch& batch, const std::shared_ptr<vks::MappedFile>& file, VkDeviceSize fileOffset, VkDeviceSize size, VkBuffer dst, VkDeviceSize dstOffset)
+	{
+		assert(fileOffset + size <= file->size());
+		const Import entry = import(file);
+		if (fileOffset < entry.size) {
+			VkBufferCopy copyRegion{};
+			copyRegion.srcOffset = fileOffset;
+			copyRegion.dstOffset = dstOffset;
+			copyRegion.size = std::min(size, entry.size - fileOffset);
+			batch.copyBuffer(entry.buffer, dst, copyRegion);
+			importedBytes += copyRegion.size;
+			fileOffset += copyRegion.size;
+			dstOffset += copyRegion.size;
+			size -= copyRegion.size;
+		}
+		if (size > 0) {
+			batch.upload(dst, dstOffset, file->data() + fileOffset, size);
+			stagedBytes += size;
+		}
+	}
+
+	/**
+	* Add an upload of a range of a mapped file to an image
+	*
+	* @param batch Batch to add the copies to
+	* @param file Mapped file, kept mapped until the batch has finished
+	* @param fileOffset Start of the texel data in the file
+	* @param size Size of the texel data
+	* @param dst Image to copy to, needs VK_IMAGE_USAGE_TRANSFER_DST_BIT
+	* @param regions Copy descriptions, their bufferOffset is relative to fileOffset
+	* @param subresourceRange Part of the image that is uploaded by the batch
+	* @param finalLayout Layout the image is left in after the batch
+	*
+	* @note The texel data is copied from the imported pages only if it is imported completely and fileOffset is 16 byte aligned (a multiple of every texel block size)
+	*/
+	void FileUploader::uploadImage(vks::UploadBatch& batch, const std::shared_ptr<vks::MappedFile>& file, VkDeviceSize fileOffset, VkDeviceSize size, VkImage dst, const std::vector<VkBufferImageCopy>& regions, const VkImageSubresourceRange& subresourceRange, VkImageLayout finalLayout)
+	{
+		assert(fileOffset + size <= file->size());
+		const Import entry = import(file);
+		if ((fileOffset + size <= entry.size) && (fileOffset % 16 == 0)) {
+			for (const VkBufferImageCopy& region : regions) {
+				VkBufferImageCopy copyRegion = region;
+				copyRegion.bufferOffset += fileOffset;
+				batch.copyBufferToImage(entry.buffer, dst, copyRegion, subresourceRange, finalLayout);
+			}
+			importedBytes += size;
+		}
+		else {
+			batch.uploadImage(dst, file->data() + fileOffset, size, regions, subresourceRange, finalLayout);
+			stagedBytes += size;
+		}
+	}
+
+	/**
+	* Tie the imports used since the last call to the batch they were added to
+	*
+	* @param token Token returned by submitting the batch (UploadBatch::submit or AsyncUploader::submit)
+	*
+	* @note Batches using the uploader have to be filled and submitted one after another
+	*/
+	void FileUploader::retire(const UploadToken& token)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (Import& entry : imports) {
+			if (!entry.retired) {
+				entry.token = token;
+				entry.retired = true;
+			}
+		}
+	}
+
+	/** @brief Release imports whose batches have finished, unmapping their files unless they are still referenced elsewhere */
+	void FileUploader::collect()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (Import& entry : imports) {
+			if (entry.retired && entry.token.done()) {
+				release(entry);
+			}
+		}
+		imports.erase(std::remove_if(imports.begin(), imports.end(), [](const Import& entry) { return !entry.file; }), imports.end());
+	}
+}
@@ -0,0 +1,70 @@
+/*
+* File uploader
+*
+* Uploads the contents of mapped files, importing the mapped pages as staging buffers where the device allows it
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanDevice.h"
+#include "VulkanMappedFile.h"
+#include "VulkanUploadBatch.h"
+
+namespace vks
+{
+	/**
+	* @brief Adds uploads from mapped files to upload batches without copying the file contents on the host
+	*
+	* With VK_EXT_external_memory_host the pages of a mapped file are imported as device memory and bound to a buffer
+	* the batch copies from directly, so the data goes from the page cache to the destination in a single device copy.
+	* Ranges that can't be imported (no extension, a mapping the driver rejects, or the tail of a file past the last
+	* aligned page) are written into the batch's staging ring instead, which still saves the read into heap memory
+	*
+	* Imported files are kept mapped until the batch they were used in has finished, hand the batch's token to retire()
+	*
+	* @note Import support depends on the driver accepting file backed pages, failed imports silently fall back to staging
+	*/
+	class FileUploader
+	{
+	public:
+		void create(vks::VulkanDevice* device);
+		void destroy();
+
+		bool importSupported() const;
+		void upload(vks::UploadBatch& batch, const std::shared_ptr<vks::MappedFile>& file, VkDeviceSize fileOffset, VkDeviceSize size, VkBuffer dst, VkDeviceSize dstOffset);
+		void uploadImage(vks::UploadBatch& batch, const std::shared_ptr<vks::MappedFile>& file, VkDeviceSize fileOffset, VkDeviceSize size, VkImage dst, const std::vector<VkBufferImageCopy>& regions, const VkImageSubresourceRange& subresourceRange, VkImageLayout finalLayout);
+		void retire(const UploadToken& token);
+		void collect();
+
+		/** @brief Bytes copied straight from imported file pages */
+		VkDeviceSize importedBytes = 0;
+		/** @brief Bytes that went through the staging ring */
+		VkDeviceSize stagedBytes = 0;
+
+	private:
+		/** @brief File imported as a staging buffer, buffer is VK_NULL_HANDLE if the import failed */
+		struct Import {
+			std::shared_ptr<vks::MappedFile> file;
+			VkBuffer buffer;
+			VkDeviceMemory memory;
+			/** @brief Bytes of the file covered by the buffer, from its start */
+			VkDeviceSize size;
+			UploadToken token;
+			bool retired;
+		};
+		vks::VulkanDevice* device = nullptr;
+		std::vector<Import> imports;
+		std::mutex mutex;
+
+		Import import(const std::shared_ptr<vks::MappedFile>& file);
+		void release(Import& import);
+	};
+}
@@ -0,0 +1,103 @@
+/*
+* Frame ring
+*
+* Owns the per-frame resources required to keep several frames in flight
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanFrameRing.h"
+
+namespace vks
+{
+	/**
+	* Create the synchronization primitives, command pools and uniform space for all frames of the ring
+	*
+	* @param device Device to create the resources on
+	* @param timeline Timeline of the queue the frames are submitted to
+	* @param depth Number of frames that may be in flight at the same time (at least 1)
+	* @param queueFamilyIndex Queue family the frame command buffers will be submitted to
+	* @param uniformCapacity (Optional) Size of the dynamic uniform space each frame can allocate from, no uniform buffer is created if 0
+	*/
+	void FrameRing::create(vks::VulkanDevice* device, vks::Timeline* timeline, uint32_t depth, uint32_t queueFamilyIndex, VkDeviceSize uniformCapacity)
+	{
+		assert(depth > 0);
+		this->device = device;
+		this->timeline = timeline;
+		currentFrame = 0;
+		frames.resize(depth);
+
+		// Binary semaphores are only used to talk to the presentation engine, which can't use timeline semaphores
+		VkSemaphoreCreateInfo semaphoreCI = vks::initializers::semaphoreCreateInfo();
+		for (auto& frame : frames) {
+			// Anything submitted before the ring was created counts as done for the first use of each frame
+			frame.timelineValue = 0;
+			VK_CHECK_RESULT(vkCreateSemaphore(device->logicalDevice, &semaphoreCI, vks::HostAllocator::callbacks(), &frame.presentComplete));
+			// Each frame gets its own pool, so recording a frame never touches a pool the GPU may still be reading from
+			frame.commands.create(device->logicalDevice, queueFamilyIndex);
+		}
+
+		// All frames share one persistently mapped allocation for their dynamic uniform blocks
+		if (uniformCapacity > 0) {
+			uniforms.create(device, depth, uniformCapacity);
+		}
+	}
+
+	/**
+	* Release all resources of the ring
+	*
+	* @note The caller has to make sure that none of the frames is still in use by the GPU
+	*/
+	void FrameRing::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		for (auto& frame : frames) {
+			vkDestroySemaphore(device->logicalDevice, frame.presentComplete, vks::HostAllocator::callbacks());
+			frame.commands.destroy();
+		}
+		frames.clear();
+		uniforms.destroy();
+		currentFrame = 0;
+	}
+
+	/** @brief Number of frames that may be in flight at the same time */
+	uint32_t FrameRing::depth() const
+	{
+		return static_cast<uint32_t>(frames.size());
+	}
+
+	/** @brief Frame that is currently being recorded */
+	Frame& FrameRing::current()
+	{
+		return frames[currentFrame];
+	}
+
+	/**
+	* Wait until the GPU has finished with the current frame's previous submission and recycle its command buffers and uniform blocks
+	*
+	* @note Only blocks if the timeline hasn't reached the value of the frame's last submission yet
+	*
+	* @return The current frame, whose resources can now be safely reused by the host
+	*/
+	Frame& FrameRing::wait()
+	{
+		Frame& frame = frames[currentFrame];
+		timeline->wait(frame.timelineValue);
+		// Everything recorded for this frame has finished executing, so the pool can be reset in one go
+		frame.commands.reset();
+		frame.commandBuffer = frame.commands.get(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+		// The same goes for the frame's uniform blocks
+		if (uniforms.frameCapacity > 0) {
+			uniforms.beginFrame(currentFrame);
+		}
+		return frame;
+	}
+
+	/** @brief Move on to the next frame of the ring */
+	void FrameRing::advance()
+	{
+		currentFrame = (currentFrame + 1) % depth();
+	}
+}
@@ -0,0 +1,65 @@
+/*
+* Frame ring
+*
+* Owns the per-frame resources required to keep several frames in flight
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+#include "VulkanCommandAllocator.h"
+#include "VulkanUniformRing.h"
+#include "VulkanTimeline.h"
+
+namespace vks
+{
+	/**
+	* @brief Resources owned by a single frame in flight
+	* @note Nothing in here may be touched by the host before the frame's timeline value has been waited on
+	*/
+	struct Frame
+	{
+		/** @brief Value of the queue's timeline that is reached once the GPU has finished executing the frame's last submission */
+		uint64_t timelineValue = 0;
+		/** @brief Signaled by the swap chain once the acquired image can be rendered to */
+		VkSemaphore presentComplete = VK_NULL_HANDLE;
+		/** @brief Transient command buffers for this frame, the whole pool is reset once the frame's timeline value has been reached */
+		vks::CommandAllocator commands;
+		/** @brief Primary command buffer submitted by the frame, taken from the frame's allocator (in initial state) after each wait */
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	};
+
+	/**
+	* @brief Ring of frames that lets the host record frame N+1 while the GPU is still busy with frame N
+	*
+	* The depth of the ring is the number of frames that may be in flight at the same time
+	* A depth of 1 fully serializes host and device
+	*/
+	class FrameRing
+	{
+	public:
+		vks::VulkanDevice* device = nullptr;
+		/** @brief Timeline of the queue the frames are submitted to */
+		vks::Timeline* timeline = nullptr;
+		std::vector<Frame> frames;
+		/** @brief Dynamic uniform space with one region per frame, rewound when the frame is waited on */
+		vks::UniformRing uniforms;
+		/** @brief Index of the frame currently being recorded */
+		uint32_t currentFrame = 0;
+
+		void create(vks::VulkanDevice* device, vks::Timeline* timeline, uint32_t depth, uint32_t queueFamilyIndex, VkDeviceSize uniformCapacity = 0);
+		void destroy();
+
+		uint32_t depth() const;
+		Frame& current();
+		Frame& wait();
+		void advance();
+	};
+}
@@ -0,0 +1,219 @@
+/*
+* Geometry pool
+*
+* Packs the vertex and index data of many meshes into a single buffer
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanGeometryPool.h"
+#include <iterator>
+
+namespace vks
+{
+	void GeometryPool::RangeAllocator::reset(uint32_t count)
+	{
+		freeRanges.clear();
+		if (count > 0) {
+			freeRanges[0] = count;
+		}
+	}
+
+	bool GeometryPool::RangeAllocator::allocate(uint32_t count, uint32_t* first)
+	{
+		for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+			if (it->second >= count) {
+				*first = it->first;
+				const uint32_t remainder = it->second - count;
+				freeRanges.erase(it);
+				if (remainder > 0) {
+					freeRanges[*first + count] = remainder;
+				}
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void GeometryPool::RangeAllocator::free(uint32_t first, uint32_t count)
+	{
+		auto next = freeRanges.lower_bound(first);
+		// Merge with the free range behind
+		if ((next != freeRanges.end()) && (next->first == first + count)) {
+			count += next->second;
+			next = freeRanges.erase(next);
+		}
+		// Merge with the free range in front
+		if (next != freeRanges.begin()) {
+			auto prev = std::prev(next);
+			if (prev->first + prev->second == first) {
+				prev->second += count;
+				return;
+			}
+		}
+		freeRanges[first] = count;
+	}
+
+	/**
+	* Create the pool's buffer
+	*
+	* @param device Device to create the buffer on
+	* @param vertexStride Size of a vertex in bytes, all meshes in the pool share the vertex layout
+	* @param maxVertexCount Number of vertices the pool can hold
+	* @param maxIndexCount Number of indices the pool can hold
+	* @param indexType (Optional) Type of the indices, all meshes in the pool share it
+	*/
+	void GeometryPool::create(vks::VulkanDevice* device, uint32_t vertexStride, uint32_t maxVertexCount, uint32_t maxIndexCount, VkIndexType indexType)
+	{
+		this->vertexStride = vertexStride;
+		this->indexType = indexType;
+		indexSize = (indexType == VK_INDEX_TYPE_UINT16) ? 2 : 4;
+		// The index region has to start at a multiple of the index size to be bound
+		indexRegionOffset = (static_cast<VkDeviceSize>(maxVertexCount) * vertexStride + 15) / 16 * 16;
+		// Shared with the transfer family, meshes can be streamed in there while the graphics queue draws the pool's other meshes
+		VK_CHECK_RESULT(device->createSharedBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&buffer,
+			indexRegionOffset + static_cast<VkDeviceSize>(maxIndexCount) * indexSize));
+		vertexRanges.reset(maxVertexCount);
+		indexRanges.reset(maxIndexCount);
+		meshCount = 0;
+		usedVertexCount = 0;
+		usedIndexCount = 0;
+	}
+
+	/** @brief Destroy the pool's buffer, the GPU must be done with all meshes */
+	void GeometryPool::destroy()
+	{
+		buffer.destroy();
+		buffer = vks::Buffer();
+		vertexRanges.reset(0);
+		indexRanges.reset(0);
+		meshCount = 0;
+	}
+
+	/** @brief Allocate the vertex and index ranges of a mesh and fill in its draw values, false if the mesh is empty or the pool has no room left */
+	bool GeometryPool::allocate(uint32_t vertexCount, uint32_t indexCount, Mesh* mesh)
+	{
+		// A mesh without vertices has no ranges to free, remove() treats it as not being in the pool
+		if (vertexCount == 0) {
+			return false;
+		}
+		uint32_t firstVertex = 0;
+		uint32_t firstIndex = 0;
+		if (!vertexRanges.allocate(vertexCount, &firstVertex)) {
+			return false;
+		}
+		if ((indexCount > 0) && !indexRanges.allocate(indexCount, &firstIndex)) {
+			vertexRanges.free(firstVertex, vertexCount);
+			return false;
+		}
+
+		mesh->vertexCount = vertexCount;
+		mesh->indexCount = indexCount;
+		mesh->vertexOffset = static_cast<int32_t>(firstVertex);
+		mesh->firstIndex = firstIndex;
+		mesh->vertices = buffer.view(static_cast<VkDeviceSize>(firstVertex) * vertexStride, static_cast<VkDeviceSize>(vertexCount) * vertexStride);
+		if (indexCount > 0) {
+			mesh->indices = buffer.view(indexRegionOffset + static_cast<VkDeviceSize>(firstIndex) * indexSize, static_cast<VkDeviceSize>(indexCount) * indexSize);
+		}
+		else {
+			mesh->indices = vks::BufferView();
+		}
+
+		meshCount++;
+		usedVertexCount += vertexCount;
+		usedIndexCount += indexCount;
+		return true;
+	}
+
+	/**
+	* Add a mesh to the pool
+	*
+	* @param batch Batch the data is uploaded with, the mesh can be drawn once the batch has been submitted (and its token reached for other queues)
+	* @param vertexData Vertex data of the mesh, vertexCount * vertexStride bytes
+	* @param vertexCount Number of vertices
+	* @param indexData Index data of the mesh, may be null for non-indexed meshes
+	* @param indexCount Number of indices, relative to the mesh's first vertex
+	* @param mesh Receives the ranges of the mesh
+	*
+	* @return False if the mesh has no vertices or the pool has no room left for it
+	*/
+	bool GeometryPool::add(vks::UploadBatch& batch, const void* vertexData, uint32_t vertexCount, const void* indexData, uint32_t indexCount, Mesh* mesh)
+	{
+		if (!allocate(vertexCount, indexCount, mesh)) {
+			return false;
+		}
+		batch.upload(buffer.buffer, mesh->vertices.offset, vertexData, mesh->vertices.size);
+		if (indexCount > 0) {
+			batch.upload(buffer.buffer, mesh->indices.offset, indexData, mesh->indices.size);
+		}
+		return true;
+	}
+
+	/**
+	* Add a mesh stored in a mapped file to the pool
+	*
+	* @param uploader Uploader copying from the file, straight from its pages if they can be imported
+	* @param batch Batch the data is uploaded with, retire its token with the uploader once submitted
+	* @param file Mapped file holding the mesh, kept mapped until the batch has finished
+	* @param vertexDataOffset Start of the vertex data in the file, vertexCount * vertexStride bytes
+	* @param vertexCount Number of vertices
+	* @param indexDataOffset Start of the index data in the file, ignored for non-indexed meshes
+	* @param indexCount Number of indices, relative to the mesh's first vertex
+	* @param mesh Receives the ranges of the mesh
+	*
+	* @return False if the mesh has no vertices or the pool has no room left for it
+	*/
+	bool GeometryPool::add(vks::FileUploader& uploader, vks::UploadBatch& batch, const std::shared_ptr<vks::MappedFile>& file, VkDeviceSize vertexDataOffset, uint32_t vertexCount, VkDeviceSize indexDataOffset, uint32_t indexCount, Mesh* mesh)
+	{
+		if (!allocate(vertexCount, indexCount, mesh)) {
+			return false;
+		}
+		uploader.upload(batch, file, vertexDataOffset, mesh->vertices.size, buffer.buffer, mesh->vertices.offset);
+		if (indexCount > 0) {
+			uploader.upload(batch, file, indexDataOffset, mesh->indices.size, buffer.buffer, mesh->indices.offset);
+		}
+		return true;
+	}
+
+	/**
+	* Remove a mesh from the pool, its ranges can be reused right away
+	*
+	* @note The GPU must be done with draws of the mesh (e.g. remove it from a vks::DeletionQueue deleter)
+	*/
+	void GeometryPool::remove(Mesh& mesh)
+	{
+		if (mesh.vertexCount == 0) {
+			return;
+		}
+		vertexRanges.free(static_cast<uint32_t>(mesh.vertexOffset), mesh.vertexCount);
+		if (mesh.indexCount > 0) {
+			indexRanges.free(mesh.firstIndex, mesh.indexCount);
+		}
+		meshCount--;
+		usedVertexCount -= mesh.vertexCount;
+		usedIndexCount -= mesh.indexCount;
+		mesh = Mesh();
+	}
+
+	/** @brief Bind the pool's vertex and index regions, once for all meshes drawn from it */
+	void GeometryPool::bind(VkCommandBuffer commandBuffer, uint32_t binding) const
+	{
+		const VkDeviceSize offset = 0;
+		vkCmdBindVertexBuffers(commandBuffer, binding, 1, &buffer.buffer, &offset);
+		vkCmdBindIndexBuffer(commandBuffer, buffer.buffer, indexRegionOffset, indexType);
+	}
+
+	/** @brief Draw a mesh of the pool, the pool has to be bound */
+	void GeometryPool::draw(VkCommandBuffer commandBuffer, const Mesh& mesh, uint32_t instanceCount, uint32_t firstInstance) const
+	{
+		if (mesh.indexCount > 0) {
+			vkCmdDrawIndexed(commandBuffer, mesh.indexCount, instanceCount, mesh.firstIndex, mesh.vertexOffset, firstInstance);
+		}
+		else {
+			vkCmdDraw(commandBuffer, mesh.vertexCount, instanceCount, static_cast<uint32_t>(mesh.vertexOffset), firstInstance);
+		}
+	}
+}
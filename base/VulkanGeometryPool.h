@@ -0,0 +1,86 @@
+/*
+* Geometry pool
+*
+* Packs the vertex and index data of many meshes into a single buffer
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <map>
+#include <memory>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+#include "VulkanUploadBatch.h"
+#include "VulkanFileUploader.h"
+
+namespace vks
+{
+	/**
+	* @brief Vertex and index data of many meshes (sharing one vertex layout) in a single device local buffer
+	*
+	* The buffer holds a vertex region followed by an index region, meshes get ranges of whole vertices and indices in both.
+	* Draw loops bind the pool once and draw each mesh with its firstIndex and vertexOffset, instead of binding separate buffers
+	* (each with its own memory) per mesh
+	*
+	* @note Not thread safe, add and remove meshes from one thread
+	*/
+	class GeometryPool
+	{
+	public:
+		/** @brief Mesh in the pool */
+		struct Mesh {
+			/** @brief Vertex data of the mesh in the pool's buffer */
+			vks::BufferView vertices;
+			/** @brief Index data of the mesh in the pool's buffer */
+			vks::BufferView indices;
+			uint32_t vertexCount = 0;
+			uint32_t indexCount = 0;
+			/** @brief Values for vkCmdDrawIndexed with the pool bound, indices stay relative to the mesh's own vertices */
+			int32_t vertexOffset = 0;
+			uint32_t firstIndex = 0;
+		};
+
+		vks::Buffer buffer;
+		uint32_t vertexStride = 0;
+		VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+
+		void create(vks::VulkanDevice* device, uint32_t vertexStride, uint32_t maxVertexCount, uint32_t maxIndexCount, VkIndexType indexType = VK_INDEX_TYPE_UINT32);
+		void destroy();
+
+		bool add(vks::UploadBatch& batch, const void* vertexData, uint32_t vertexCount, const void* indexData, uint32_t indexCount, Mesh* mesh);
+		bool add(vks::FileUploader& uploader, vks::UploadBatch& batch, const std::shared_ptr<vks::MappedFile>& file, VkDeviceSize vertexDataOffset, uint32_t vertexCount, VkDeviceSize indexDataOffset, uint32_t indexCount, Mesh* mesh);
+		void remove(Mesh& mesh);
+		void bind(VkCommandBuffer commandBuffer, uint32_t binding = 0) const;
+		void draw(VkCommandBuffer commandBuffer, const Mesh& mesh, uint32_t instanceCount = 1, uint32_t firstInstance = 0) const;
+
+		/** @brief Number of meshes in the pool */
+		uint32_t meshCount = 0;
+		/** @brief Number of vertices and indices in use by meshes */
+		uint32_t usedVertexCount = 0;
+		uint32_t usedIndexCount = 0;
+
+	private:
+		/** @brief First fit allocator for ranges of elements, free ranges are kept by start and merged with their neighbours */
+		class RangeAllocator
+		{
+		public:
+			void reset(uint32_t count);
+			bool allocate(uint32_t count, uint32_t* first);
+			void free(uint32_t first, uint32_t count);
+		private:
+			std::map<uint32_t, uint32_t> freeRanges;
+		};
+		RangeAllocator vertexRanges;
+		RangeAllocator indexRanges;
+		/** @brief Start of the index region in the buffer */
+		VkDeviceSize indexRegionOffset = 0;
+		uint32_t indexSize = 4;
+
+		bool allocate(uint32_t vertexCount, uint32_t indexCount, Mesh* mesh);
+	};
+}
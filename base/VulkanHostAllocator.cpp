@@ -0,0 +1,384 @@
+/*
+* Host allocator
+*
+* Allocation callbacks for the host memory the driver allocates on behalf of the application
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanHostAllocator.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+namespace vks
+{
+	namespace
+	{
+		struct ScopeCounters {
+			std::atomic<uint64_t> allocations;
+			std::atomic<uint64_t> frees;
+			std::atomic<uint64_t> allocatedBytes;
+			std::atomic<uint64_t> currentBytes;
+			std::atomic<uint64_t> peakBytes;
+			std::atomic<uint64_t> internalBytes;
+		};
+		ScopeCounters counters[allocationScopeCount];
+		HostAllocator::Mode selectedMode = HostAllocator::Mode::Driver;
+
+		/** @brief Where an allocation was served from */
+		enum class Source : uint8_t {
+			Heap,
+			Arena,
+			Pool
+		};
+
+		/** @brief Stored in front of every allocation, as pfnFree gets neither the size nor the scope */
+		struct Header {
+			uint64_t size;
+			/** @brief Distance from the start of the malloc'd block, arena or pool block to the returned pointer */
+			uint32_t offset;
+			uint8_t scope;
+			Source source;
+			uint16_t sizeClass;
+		};
+		static_assert(sizeof(Header) == 16, "Allocation header has to keep 16 byte alignment");
+
+		uint32_t scopeIndex(VkSystemAllocationScope scope)
+		{
+			return std::min(static_cast<uint32_t>(scope), allocationScopeCount - 1);
+		}
+
+		void countAllocation(uint32_t scope, uint64_t size)
+		{
+			ScopeCounters& scopeCounters = counters[scope];
+			scopeCounters.allocations.fetch_add(1, std::memory_order_relaxed);
+			scopeCounters.allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+			const uint64_t current = scopeCounters.currentBytes.fetch_add(size, std::memory_order_relaxed) + size;
+			uint64_t peak = scopeCounters.peakBytes.load(std::memory_order_relaxed);
+			while ((current > peak) && !scopeCounters.peakBytes.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+			}
+		}
+
+		void countFree(uint32_t scope, uint64_t size)
+		{
+			counters[scope].frees.fetch_add(1, std::memory_order_relaxed);
+			counters[scope].currentBytes.fetch_sub(size, std::memory_order_relaxed);
+		}
+
+		uint8_t* writeHeader(uint8_t* memory, uint8_t* block, uint64_t size, VkSystemAllocationScope allocationScope, Source source, uint16_t sizeClass)
+		{
+			Header* header = reinterpret_cast<Header*>(memory) - 1;
+			header->size = size;
+			header->offset = static_cast<uint32_t>(memory - block);
+			header->scope = static_cast<uint8_t>(scopeIndex(allocationScope));
+			header->source = source;
+			header->sizeClass = sizeClass;
+			return memory;
+		}
+
+		uint8_t* heapAllocate(size_t size, size_t alignment, VkSystemAllocationScope allocationScope)
+		{
+			uint8_t* block = static_cast<uint8_t*>(malloc(size + sizeof(Header) + alignment - 1));
+			if (block == nullptr) {
+				return nullptr;
+			}
+			const uintptr_t address = (reinterpret_cast<uintptr_t>(block) + sizeof(Header) + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+			return writeHeader(reinterpret_cast<uint8_t*>(address), block, size, allocationScope, Source::Heap, 0);
+		}
+
+		/** @brief Size of a thread's command scope arena, larger command allocations go to the heap */
+		const size_t arenaSize = 256 * 1024;
+		/** @brief Start of an arena block, allocations follow it */
+		struct ArenaBlock {
+			/** @brief Allocations not yet freed, may be decremented from other threads */
+			std::atomic<uint32_t> live;
+		};
+		const size_t arenaDataOffset = 64;
+
+		/**
+		* @brief Bump allocator owned by a single thread, only the owner allocates from it
+		*
+		* @note Command scope allocations are freed before the command that made them returns, so no allocation can be live once the
+		* owning thread exits. A live one would be a driver leak, the block is then leaked along with it rather than freed under it
+		*/
+		struct ThreadArena {
+			uint8_t* block = nullptr;
+			size_t head = arenaDataOffset;
+			~ThreadArena()
+			{
+				if (block == nullptr) {
+					return;
+				}
+				ArenaBlock* arenaBlock = reinterpret_cast<ArenaBlock*>(block);
+				assert(arenaBlock->live.load(std::memory_order_acquire) == 0);
+				if (arenaBlock->live.load(std::memory_order_acquire) == 0) {
+					arenaBlock->~ArenaBlock();
+					free(block);
+				}
+			}
+		};
+		thread_local ThreadArena threadArena;
+
+		uint8_t* arenaAllocate(size_t size, size_t alignment, VkSystemAllocationScope allocationScope)
+		{
+			ThreadArena& arena = threadArena;
+			if (arena.block == nullptr) {
+				arena.block = static_cast<uint8_t*>(malloc(arenaSize));
+				if (arena.block == nullptr) {
+					return nullptr;
+				}
+				new (arena.block) ArenaBlock{ { 0 } };
+			}
+			ArenaBlock* arenaBlock = reinterpret_cast<ArenaBlock*>(arena.block);
+			// Everything the previous call allocated has been freed again, so the arena starts over
+			if (arenaBlock->live.load(std::memory_order_acquire) == 0) {
+				arena.head = arenaDataOffset;
+			}
+			const uintptr_t base = reinterpret_cast<uintptr_t>(arena.block);
+			const uintptr_t address = (base + arena.head + sizeof(Header) + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+			if (address + size > base + arenaSize) {
+				return nullptr;
+			}
+			arena.head = static_cast<size_t>(address + size - base);
+			arenaBlock->live.fetch_add(1, std::memory_order_relaxed);
+			return writeHeader(reinterpret_cast<uint8_t*>(address), arena.block, size, allocationScope, Source::Arena, 0);
+		}
+
+		/** @brief Object scope size classes hold blocks of 32 to 4096 bytes (including the header) */
+		const uint32_t poolClassCount = 8;
+		const size_t poolMinBlockSize = 32;
+		const size_t poolSlabSize = 64 * 1024;
+
+		/** @brief Free list of one size class, refilled a slab at a time */
+		struct SizeClassPool {
+			std::mutex mutex;
+			void* freeList = nullptr;
+		};
+
+		SizeClassPool* sizeClassPools()
+		{
+			// Never destroyed, objects may still be freed after static destruction has started (e.g. by a global sample instance)
+			static SizeClassPool* pools = new SizeClassPool[poolClassCount];
+			return pools;
+		}
+
+		uint8_t* poolAllocate(size_t size, size_t alignment, VkSystemAllocationScope allocationScope)
+		{
+			// Pool blocks are only aligned to the header size
+			if (alignment > sizeof(Header)) {
+				return nullptr;
+			}
+			uint16_t sizeClass = 0;
+			while ((sizeClass < poolClassCount) && ((poolMinBlockSize << sizeClass) < size + sizeof(Header))) {
+				sizeClass++;
+			}
+			if (sizeClass == poolClassCount) {
+				return nullptr;
+			}
+			SizeClassPool& pool = sizeClassPools()[sizeClass];
+			const size_t blockSize = poolMinBlockSize << sizeClass;
+			uint8_t* block;
+			{
+				std::lock_guard<std::mutex> lock(pool.mutex);
+				if (pool.freeList == nullptr) {
+					uint8_t* slab = static_cast<uint8_t*>(malloc(poolSlabSize));
+					if (slab == nullptr) {
+						return nullptr;
+					}
+					for (size_t offset = 0; offset + blockSize <= poolSlabSize; offset += blockSize) {
+						*reinterpret_cast<void**>(slab + offset) = pool.freeList;
+						pool.freeList = slab + offset;
+					}
+				}
+				block = static_cast<uint8_t*>(pool.freeList);
+				pool.freeList = *reinterpret_cast<void**>(block);
+			}
+			return writeHeader(block + sizeof(Header), block, size, allocationScope, Source::Pool, sizeClass);
+		}
+
+		void* allocate(size_t size, size_t alignment, VkSystemAllocationScope allocationScope, bool pooled)
+		{
+			if (size == 0) {
+				return nullptr;
+			}
+			alignment = std::max(alignment, sizeof(Header));
+			uint8_t* memory = nullptr;
+			if (pooled && (allocationScope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND)) {
+				memory = arenaAllocate(size, alignment, allocationScope);
+			}
+			else if (pooled && (allocationScope == VK_SYSTEM_ALLOCATION_SCOPE_OBJECT)) {
+				memory = poolAllocate(size, alignment, allocationScope);
+			}
+			// Anything the arena or pools can't serve goes to the heap
+			if (memory == nullptr) {
+				memory = heapAllocate(size, alignment, allocationScope);
+			}
+			if (memory != nullptr) {
+				countAllocation(scopeIndex(allocationScope), size);
+			}
+			return memory;
+		}
+
+		VKAPI_ATTR void VKAPI_CALL freeCallback(void* /*userData*/, void* memory)
+		{
+			if (memory == nullptr) {
+				return;
+			}
+			const Header* header = static_cast<const Header*>(memory) - 1;
+			countFree(header->scope, header->size);
+			uint8_t* block = static_cast<uint8_t*>(memory) - header->offset;
+			switch (header->source) {
+			case Source::Heap:
+				free(block);
+				break;
+			case Source::Arena:
+				reinterpret_cast<ArenaBlock*>(block)->live.fetch_sub(1, std::memory_order_release);
+				break;
+			case Source::Pool: {
+				SizeClassPool& pool = sizeClassPools()[header->sizeClass];
+				std::lock_guard<std::mutex> lock(pool.mutex);
+				*reinterpret_cast<void**>(block) = pool.freeList;
+				pool.freeList = block;
+				break;
+			}
+			}
+		}
+
+		void* reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope allocationScope, bool pooled)
+		{
+			if (original == nullptr) {
+				return allocate(size, alignment, allocationScope, pooled);
+			}
+			if (size == 0) {
+				freeCallback(nullptr, original);
+				return nullptr;
+			}
+			// The original allocation has to stay valid if the new one fails
+			void* memory = allocate(size, alignment, allocationScope, pooled);
+			if (memory != nullptr) {
+				const Header* header = static_cast<const Header*>(original) - 1;
+				memcpy(memory, original, static_cast<size_t>(std::min(header->size, static_cast<uint64_t>(size))));
+				freeCallback(nullptr, original);
+			}
+			return memory;
+		}
+
+		VKAPI_ATTR void* VKAPI_CALL trackingAllocate(void* /*userData*/, size_t size, size_t alignment, VkSystemAllocationScope allocationScope)
+		{
+			return allocate(size, alignment, allocationScope, false);
+		}
+
+		VKAPI_ATTR void* VKAPI_CALL trackingReallocate(void* /*userData*/, void* original, size_t size, size_t alignment, VkSystemAllocationScope allocationScope)
+		{
+			return reallocate(original, size, alignment, allocationScope, false);
+		}
+
+		VKAPI_ATTR void* VKAPI_CALL arenaAllocateCallback(void* /*userData*/, size_t size, size_t alignment, VkSystemAllocationScope allocationScope)
+		{
+			return allocate(size, alignment, allocationScope, true);
+		}
+
+		VKAPI_ATTR void* VKAPI_CALL arenaReallocateCallback(void* /*userData*/, void* original, size_t size, size_t alignment, VkSystemAllocationScope allocationScope)
+		{
+			return reallocate(original, size, alignment, allocationScope, true);
+		}
+
+		VKAPI_ATTR void VKAPI_CALL internalAllocation(void* /*userData*/, size_t size, VkInternalAllocationType /*allocationType*/, VkSystemAllocationScope allocationScope)
+		{
+			counters[scopeIndex(allocationScope)].internalBytes.fetch_add(size, std::memory_order_relaxed);
+		}
+
+		VKAPI_ATTR void VKAPI_CALL internalFree(void* /*userData*/, size_t size, VkInternalAllocationType /*allocationType*/, VkSystemAllocationScope allocationScope)
+		{
+			counters[scopeIndex(allocationScope)].internalBytes.fetch_sub(size, std::memory_order_relaxed);
+		}
+
+		const VkAllocationCallbacks trackingCallbacks = {
+			nullptr,
+			trackingAllocate,
+			trackingReallocate,
+			freeCallback,
+			internalAllocation,
+			internalFree
+		};
+
+		const VkAllocationCallbacks arenaCallbacks = {
+			nullptr,
+			arenaAllocateCallback,
+			arenaReallocateCallback,
+			freeCallback,
+			internalAllocation,
+			internalFree
+		};
+	}
+
+	/** @brief Name of an allocation scope for output */
+	const char* allocationScopeName(uint32_t scope)
+	{
+		switch (scope) {
+		case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND:
+			return "command";
+		case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT:
+			return "object";
+		case VK_SYSTEM_ALLOCATION_SCOPE_CACHE:
+			return "cache";
+		case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE:
+			return "device";
+		case VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE:
+			return "instance";
+		default:
+			return "unknown";
+		}
+	}
+
+	/**
+	* Select the callbacks used from now on
+	*
+	* @param mode Allocator the driver's host allocations go to
+	*
+	* @note Has to be called before the instance is created and not changed afterwards
+	*/
+	void HostAllocator::select(Mode mode)
+	{
+		selectedMode = mode;
+	}
+
+	HostAllocator::Mode HostAllocator::mode()
+	{
+		return selectedMode;
+	}
+
+	/** @brief Callbacks to pass as pAllocator, nullptr if the driver allocates itself */
+	const VkAllocationCallbacks* HostAllocator::callbacks()
+	{
+		switch (selectedMode) {
+		case Mode::Tracking:
+			return &trackingCallbacks;
+		case Mode::Arena:
+			return &arenaCallbacks;
+		default:
+			return nullptr;
+		}
+	}
+
+	/** @brief Snapshot of the counters, all zero if the driver allocates itself */
+	HostAllocationStats HostAllocator::stats()
+	{
+		HostAllocationStats stats;
+		for (uint32_t scope = 0; scope < allocationScopeCount; scope++) {
+			stats.scopes[scope].allocations = counters[scope].allocations.load(std::memory_order_relaxed);
+			stats.scopes[scope].frees = counters[scope].frees.load(std::memory_order_relaxed);
+			stats.scopes[scope].allocatedBytes = counters[scope].allocatedBytes.load(std::memory_order_relaxed);
+			stats.scopes[scope].currentBytes = counters[scope].currentBytes.load(std::memory_order_relaxed);
+			stats.scopes[scope].peakBytes = counters[scope].peakBytes.load(std::memory_order_relaxed);
+			stats.scopes[scope].internalBytes = counters[scope].internalBytes.load(std::memory_order_relaxed);
+		}
+		return stats;
+	}
+}
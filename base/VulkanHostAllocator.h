@@ -0,0 +1,70 @@
+/*
+* Host allocator
+*
+* Allocation callbacks for the host memory the driver allocates on behalf of the application
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	/** @brief Number of VkSystemAllocationScope values (COMMAND to INSTANCE) */
+	const uint32_t allocationScopeCount = 5;
+
+	const char* allocationScopeName(uint32_t scope);
+
+	/** @brief Host memory the driver allocated through vks::HostAllocator, per VkSystemAllocationScope */
+	struct HostAllocationStats
+	{
+		struct Scope {
+			/** @brief Number of allocations, a reallocation counts as an allocation and a free */
+			uint64_t allocations = 0;
+			uint64_t frees = 0;
+			/** @brief Bytes allocated in total */
+			uint64_t allocatedBytes = 0;
+			/** @brief Bytes currently allocated */
+			uint64_t currentBytes = 0;
+			/** @brief High-water mark of currentBytes */
+			uint64_t peakBytes = 0;
+			/** @brief Bytes the driver currently holds from its own allocator (reported through the internal allocation notifications) */
+			uint64_t internalBytes = 0;
+		} scopes[allocationScopeCount];
+	};
+
+	/**
+	* @brief Allocation callbacks passed to every vkCreate* / vkDestroy* and vkAllocateMemory / vkFreeMemory call of the framework
+	*
+	* Defaults to the driver's own allocator (callbacks() returns nullptr). The tracking mode routes the driver's host allocations
+	* through malloc and counts allocations, bytes and the high-water mark per allocation scope, so allocations in the frame loop
+	* (e.g. COMMAND scope allocations while recording, or OBJECT scope allocations from objects created per frame) show up in the stats
+	*
+	* The arena mode counts the same way, but serves COMMAND scope allocations from a per-thread bump arena that starts over once all
+	* allocations of the previous call have been freed, and OBJECT scope allocations of up to 4 KB from size-class free lists refilled
+	* in 64 KB slabs. Everything else (and whatever doesn't fit) still goes to malloc
+	*
+	* @note Objects have to be destroyed with the callbacks they were created with, so the mode is selected once before the instance is created
+	*/
+	class HostAllocator
+	{
+	public:
+		enum class Mode {
+			/** @brief No callbacks, the driver uses its own allocator */
+			Driver,
+			/** @brief malloc based callbacks that count the driver's allocations */
+			Tracking,
+			/** @brief Counting callbacks with a command scope arena and object scope size-class pools */
+			Arena
+		};
+
+		static void select(Mode mode);
+		static Mode mode();
+		static const VkAllocationCallbacks* callbacks();
+		static HostAllocationStats stats();
+	};
+}
@@ -0,0 +1,320 @@
+/*
+* Job system
+*
+* Work stealing task scheduler with per-thread queues, completion counters and a parallel for helper
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanJobSystem.h"
+#include <algorithm>
+
+namespace vks
+{
+	namespace
+	{
+		// Job system owning the calling thread and the index of the thread's queue in it
+		thread_local const JobSystem* currentJobSystem = nullptr;
+		thread_local uint32_t currentThreadIndex = JobSystem::externalThread;
+	}
+
+	JobSystem::~JobSystem()
+	{
+		destroy();
+	}
+
+	/**
+	* Create the queues and start the worker threads
+	*
+	* @param threadCount (Optional) Number of threads including the calling thread, defaults to the number of hardware threads
+	*
+	* @note The calling thread becomes thread 0 and should be the one waiting on counters, it can only be thread 0 of one job system at a time
+	*/
+	void JobSystem::create(uint32_t threadCount)
+	{
+		if (threadCount == 0) {
+			threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+		shutdown = false;
+		for (uint32_t i = 0; i < threadCount; i++) {
+			queues.push_back(std::unique_ptr<Queue>(new Queue()));
+		}
+		currentJobSystem = this;
+		currentThreadIndex = 0;
+		for (uint32_t i = 1; i < threadCount; i++) {
+			workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+		}
+	}
+
+	/**
+	* Stop all worker threads
+	*
+	* @note Jobs still sitting in the queues are dropped, wait on their counters first
+	*/
+	void JobSystem::destroy()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			shutdown = true;
+		}
+		sleepCondition.notify_all();
+		for (auto& worker : workers) {
+			worker.join();
+		}
+		workers.clear();
+		queues.clear();
+		backgroundQueue.tasks.clear();
+		queuedTasks = 0;
+		queuedBackgroundTasks = 0;
+		if (currentJobSystem == this) {
+			currentJobSystem = nullptr;
+			currentThreadIndex = externalThread;
+		}
+	}
+
+	/** @brief Number of threads executing jobs, including the thread that created the job system */
+	uint32_t JobSystem::threadCount() const
+	{
+		return static_cast<uint32_t>(queues.size());
+	}
+
+	/**
+	* Index of the calling thread inside the job system, can be used to index per-thread resources
+	*
+	* @return 0 for the creating thread, 1 to threadCount() - 1 for the worker threads and externalThread for any other thread
+	*/
+	uint32_t JobSystem::threadIndex() const
+	{
+		return (currentJobSystem == this) ? currentThreadIndex : externalThread;
+	}
+
+	/**
+	* Schedule a job
+	*
+	* @param job Function to execute on any of the job system's threads
+	* @param counter (Optional) Counter incremented now and decremented once the job has finished
+	*/
+	void JobSystem::run(Job job, Counter* counter)
+	{
+		if (counter) {
+			counter->value.fetch_add(1, std::memory_order_relaxed);
+		}
+		push({ std::move(job), counter });
+	}
+
+	/**
+	* Schedule a job that starts once all jobs of another counter have finished
+	*
+	* @param dependency Counter the job waits for
+	* @param job Function to execute on any of the job system's threads
+	* @param counter (Optional) Counter incremented now and decremented once the job has finished
+	*/
+	void JobSystem::runAfter(Counter& dependency, Job job, Counter* counter)
+	{
+		if (counter) {
+			counter->value.fetch_add(1, std::memory_order_relaxed);
+		}
+		{
+			// finish() decrements under the same lock, so the continuation is either queued before or scheduled after the transition to zero
+			std::lock_guard<std::mutex> lock(dependency.mutex);
+			if (!dependency.done()) {
+				dependency.continuations.push_back(std::make_pair(std::move(job), counter));
+				return;
+			}
+		}
+		push({ std::move(job), counter });
+	}
+
+	/**
+	* Schedule a low priority job, executed by a worker thread once it has nothing else to do
+	*
+	* @param job Function to execute on one of the worker threads
+	* @param counter (Optional) Counter incremented now and decremented once the job has finished
+	*
+	* @note Needs worker threads, with a thread count of 1 the job would never run
+	*/
+	void JobSystem::runBackground(Job job, Counter* counter)
+	{
+		if (counter) {
+			counter->value.fetch_add(1, std::memory_order_relaxed);
+		}
+		{
+			std::lock_guard<std::mutex> lock(backgroundQueue.mutex);
+			backgroundQueue.tasks.push_back({ std::move(job), counter });
+		}
+		queuedBackgroundTasks.fetch_add(1, std::memory_order_release);
+		wake();
+	}
+
+	/**
+	* Wait until all jobs of the given counter have finished
+	*
+	* @note The calling thread executes queued jobs while waiting instead of blocking, but never background jobs
+	*/
+	void JobSystem::wait(Counter& counter)
+	{
+		const uint32_t index = threadIndex();
+		Task task;
+		while (!counter.done()) {
+			if (pop(index, task)) {
+				execute(task);
+			}
+			else {
+				std::this_thread::yield();
+			}
+		}
+		// Synchronize with the thread that finished the last job, it may still hold the counter's lock
+		std::lock_guard<std::mutex> lock(counter.mutex);
+	}
+
+	/**
+	* Split the range [0, count) into chunks and process them in parallel, returns once all chunks are done
+	*
+	* @param count Number of elements
+	* @param grainSize Minimum number of elements per chunk, keeps the scheduling overhead low for cheap elements
+	* @param func Function processing the elements [begin, end), called concurrently from several threads
+	*/
+	void JobSystem::parallelFor(uint32_t count, uint32_t grainSize, std::function<void(uint32_t begin, uint32_t end)> func)
+	{
+		if (count == 0) {
+			return;
+		}
+		grainSize = std::max(grainSize, 1u);
+		// A few chunks per thread so stealing can even out chunks of uneven cost
+		const uint32_t chunkCount = std::max(std::min((count + grainSize - 1) / grainSize, threadCount() * 4), 1u);
+		if (chunkCount == 1) {
+			func(0, count);
+			return;
+		}
+		const uint32_t chunkSize = (count + chunkCount - 1) / chunkCount;
+		Counter counter;
+		for (uint32_t begin = chunkSize; begin < count; begin += chunkSize) {
+			const uint32_t end = std::min(begin + chunkSize, count);
+			run([&func, begin, end] { func(begin, end); }, &counter);
+		}
+		// The first chunk is processed right away on the calling thread
+		func(0, std::min(chunkSize, count));
+		wait(counter);
+	}
+
+	void JobSystem::push(Task task)
+	{
+		// Worker threads push to their own queue, other threads spread their jobs over all queues
+		uint32_t index = threadIndex();
+		if (index == externalThread) {
+			index = nextExternalQueue.fetch_add(1, std::memory_order_relaxed) % threadCount();
+		}
+		{
+			std::lock_guard<std::mutex> lock(queues[index]->mutex);
+			queues[index]->tasks.push_back(std::move(task));
+		}
+		queuedTasks.fetch_add(1, std::memory_order_release);
+		wake();
+	}
+
+	void JobSystem::wake()
+	{
+		// Taking the sleep mutex orders the increment against a worker that just checked the predicate and is about to block
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+		sleepCondition.notify_one();
+	}
+
+	bool JobSystem::pop(uint32_t threadIndex, Task& task)
+	{
+		if (queuedTasks.load(std::memory_order_acquire) == 0) {
+			return false;
+		}
+		// Own queue first (newest job), then steal the oldest job from the other queues
+		const uint32_t count = threadCount();
+		uint32_t first = 1;
+		if (threadIndex == externalThread) {
+			// No queue of its own, steal from all of them
+			threadIndex = 0;
+			first = 0;
+		}
+		else {
+			Queue& queue = *queues[threadIndex];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (!queue.tasks.empty()) {
+				task = std::move(queue.tasks.back());
+				queue.tasks.pop_back();
+				queuedTasks.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		for (uint32_t i = first; i < count; i++) {
+			Queue& queue = *queues[(threadIndex + i) % count];
+			std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+			if (lock.owns_lock() && !queue.tasks.empty()) {
+				task = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+				queuedTasks.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool JobSystem::popBackground(Task& task)
+	{
+		if (queuedBackgroundTasks.load(std::memory_order_acquire) == 0) {
+			return false;
+		}
+		// Oldest first, background jobs are started in the order they were scheduled
+		std::lock_guard<std::mutex> lock(backgroundQueue.mutex);
+		if (backgroundQueue.tasks.empty()) {
+			return false;
+		}
+		task = std::move(backgroundQueue.tasks.front());
+		backgroundQueue.tasks.pop_front();
+		queuedBackgroundTasks.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	void JobSystem::execute(Task& task)
+	{
+		task.job();
+		task.job = nullptr;
+		finish(task.counter);
+	}
+
+	void JobSystem::finish(Counter* counter)
+	{
+		if (!counter) {
+			return;
+		}
+		std::vector<std::pair<Job, Counter*>> continuations;
+		{
+			// Decrementing under the lock keeps wait() from returning (and the counter from being destroyed) while the lock is still held
+			std::lock_guard<std::mutex> lock(counter->mutex);
+			if (counter->value.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				// Last job of the counter, release everything that depends on it
+				continuations.swap(counter->continuations);
+			}
+		}
+		for (auto& continuation : continuations) {
+			push({ std::move(continuation.first), continuation.second });
+		}
+	}
+
+	void JobSystem::workerLoop(uint32_t threadIndex)
+	{
+		currentJobSystem = this;
+		currentThreadIndex = threadIndex;
+		Task task;
+		while (true) {
+			if (pop(threadIndex, task) || popBackground(task)) {
+				execute(task);
+				continue;
+			}
+			// Nothing to do, sleep until new jobs are pushed
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			sleepCondition.wait(lock, [this] { return shutdown || (queuedTasks.load(std::memory_order_acquire) > 0) || (queuedBackgroundTasks.load(std::memory_order_acquire) > 0); });
+			if (shutdown) {
+				return;
+			}
+		}
+	}
+}
@@ -0,0 +1,112 @@
+/*
+* Job system
+*
+* Work stealing task scheduler with per-thread queues, completion counters and a parallel for helper
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+namespace vks
+{
+	/**
+	* @brief Work stealing job scheduler
+	*
+	* Every thread owns a queue. A thread pushes and pops its own jobs at the back (LIFO, cache friendly), idle threads
+	* steal the oldest jobs from the front of other threads' queues. The thread that creates the job system takes part as
+	* thread 0 whenever it waits on a counter, so waiting never blocks a core that could be executing jobs
+	*
+	* Any other thread (including the workers of another job system) is external: threadIndex() returns externalThread for it,
+	* it owns no queue and no per-thread resources, and only steals jobs when it waits on a counter
+	*
+	* Long running jobs that nothing waits on soon (e.g. pipeline compilations) go to a separate background queue with runBackground().
+	* Only worker threads that found no other job pop from it, a thread waiting on a counter never does, so it can't get stuck in one
+	*/
+	class JobSystem
+	{
+	public:
+		typedef std::function<void()> Job;
+
+		/** @brief Value of threadIndex() for threads that are not owned by the job system, never a valid index for per-thread resources */
+		static const uint32_t externalThread = UINT32_MAX;
+
+		/**
+		* @brief Tracks completion of a group of jobs
+		*
+		* The counter is incremented when a job is scheduled with it and decremented once the job has finished. Jobs
+		* scheduled with runAfter() start once the counter they depend on reaches zero
+		* @note Must outlive all jobs scheduled with it, only destroy it after wait() has returned
+		*/
+		class Counter
+		{
+		public:
+			Counter() {}
+			Counter(const Counter&) = delete;
+			Counter& operator=(const Counter&) = delete;
+			/** @brief Returns true once all jobs scheduled with this counter have finished */
+			bool done() const { return value.load(std::memory_order_acquire) == 0; }
+		private:
+			friend class JobSystem;
+			std::atomic<uint32_t> value{ 0 };
+			std::mutex mutex;
+			/** @brief Jobs (and their own counters) to schedule once the value drops to zero */
+			std::vector<std::pair<Job, Counter*>> continuations;
+		};
+
+		~JobSystem();
+
+		void create(uint32_t threadCount = 0);
+		void destroy();
+
+		uint32_t threadCount() const;
+		uint32_t threadIndex() const;
+
+		void run(Job job, Counter* counter = nullptr);
+		void runAfter(Counter& dependency, Job job, Counter* counter = nullptr);
+		void runBackground(Job job, Counter* counter = nullptr);
+		void wait(Counter& counter);
+		void parallelFor(uint32_t count, uint32_t grainSize, std::function<void(uint32_t begin, uint32_t end)> func);
+
+	private:
+		struct Task {
+			Job job;
+			Counter* counter;
+		};
+		struct Queue {
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		std::vector<std::unique_ptr<Queue>> queues;
+		/** @brief Low priority jobs, only popped by idle worker threads */
+		Queue backgroundQueue;
+		std::vector<std::thread> workers;
+		/** @brief Number of tasks sitting in any of the queues, lets idle workers sleep */
+		std::atomic<uint32_t> queuedTasks{ 0 };
+		/** @brief Number of tasks sitting in the background queue */
+		std::atomic<uint32_t> queuedBackgroundTasks{ 0 };
+		std::atomic<uint32_t> nextExternalQueue{ 0 };
+		std::mutex sleepMutex;
+		std::condition_variable sleepCondition;
+		bool shutdown = false;
+
+		void push(Task task);
+		void wake();
+		bool pop(uint32_t threadIndex, Task& task);
+		bool popBackground(Task& task);
+		void execute(Task& task);
+		void finish(Counter* counter);
+		void workerLoop(uint32_t threadIndex);
+	};
+}
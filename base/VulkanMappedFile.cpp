@@ -0,0 +1,122 @@
+/*
+* Mapped file
+*
+* Read only memory mapping of a whole file
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanMappedFile.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vks
+{
+	MappedFile::MappedFile(const std::string& fileName)
+	{
+		open(fileName);
+	}
+
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+	/** @brief Granularity of memory mappings */
+	size_t MappedFile::pageSize()
+	{
+#if defined(_WIN32)
+		SYSTEM_INFO systemInfo;
+		GetSystemInfo(&systemInfo);
+		return systemInfo.dwPageSize;
+#else
+		return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+	}
+
+	/**
+	* Map a file, replacing the current mapping
+	*
+	* @param fileName Path of the file
+	*
+	* @return True if the file could be mapped, false if it doesn't exist, can't be read or is empty
+	*/
+	bool MappedFile::open(const std::string& fileName)
+	{
+		close();
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || (size.QuadPart == 0)) {
+			CloseHandle(file);
+			return false;
+		}
+		HANDLE fileMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (fileMapping == nullptr) {
+			CloseHandle(file);
+			return false;
+		}
+		mapping = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+		if (mapping == nullptr) {
+			CloseHandle(fileMapping);
+			CloseHandle(file);
+			return false;
+		}
+		fileHandle = file;
+		mappingHandle = fileMapping;
+		fileSize = static_cast<size_t>(size.QuadPart);
+#else
+		int fd = ::open(fileName.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat status;
+		if ((fstat(fd, &status) != 0) || (status.st_size == 0)) {
+			::close(fd);
+			return false;
+		}
+		fileSize = static_cast<size_t>(status.st_size);
+		void* address = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+		// The mapping keeps its own reference to the file
+		::close(fd);
+		if (address == MAP_FAILED) {
+			fileSize = 0;
+			return false;
+		}
+		mapping = address;
+#endif
+		const size_t page = pageSize();
+		mappingSize = (fileSize + page - 1) / page * page;
+		return true;
+	}
+
+	/** @brief Unmap the file, pointers into the mapping become invalid */
+	void MappedFile::close()
+	{
+		if (mapping == nullptr) {
+			return;
+		}
+#if defined(_WIN32)
+		UnmapViewOfFile(mapping);
+		CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+		mappingHandle = nullptr;
+		fileHandle = nullptr;
+#else
+		munmap(mapping, fileSize);
+#endif
+		mapping = nullptr;
+		fileSize = 0;
+		mappingSize = 0;
+	}
+}
@@ -0,0 +1,57 @@
+/*
+* Mapped file
+*
+* Read only memory mapping of a whole file
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace vks
+{
+	/**
+	* @brief Maps a file into the address space instead of reading it into heap memory
+	*
+	* The contents are paged in from the page cache on first access, so loading a file costs no copy at all. The mapping
+	* starts at a page boundary and covers whole pages, which allows importing it as device memory (see vks::FileUploader)
+	*
+	* @note The mapping is private and read only, writing to data() is undefined
+	*/
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		explicit MappedFile(const std::string& fileName);
+		~MappedFile();
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool open(const std::string& fileName);
+		void close();
+
+		/** @brief True if a file is mapped (empty files can't be mapped) */
+		bool isOpen() const { return mapping != nullptr; }
+		/** @brief Start of the file contents, aligned to the page size */
+		const uint8_t* data() const { return static_cast<const uint8_t*>(mapping); }
+		/** @brief Size of the file in bytes */
+		size_t size() const { return fileSize; }
+		/** @brief Size of the mapping, the file size rounded up to whole pages (the bytes past the end of the file read as zero) */
+		size_t mappedSize() const { return mappingSize; }
+
+		static size_t pageSize();
+
+	private:
+		void* mapping = nullptr;
+		size_t fileSize = 0;
+		size_t mappingSize = 0;
+#if defined(_WIN32)
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#endif
+	};
+}
@@ -0,0 +1,598 @@
+/*
+* Device memory allocator
+*
+* Sub-allocates resources from large per-memory-type blocks using a two level segregated fit (TLSF) scheme
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanMemoryAllocator.h"
+#include <algorithm>
+#include <iostream>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace vks
+{
+	const uint32_t MemoryBlock::subLevelBits;
+	const uint32_t MemoryBlock::subLevelCount;
+	const uint32_t MemoryBlock::firstLevelCount;
+	const VkDeviceSize MemoryBlock::minRegionSize;
+
+	/** @brief Name of a memory tag as shown in statistics */
+	const char* memoryTagName(MemoryTag tag)
+	{
+		switch (tag) {
+		case MemoryTag::Buffer: return "buffer";
+		case MemoryTag::Image: return "image";
+		case MemoryTag::Staging: return "staging";
+		case MemoryTag::UI: return "ui";
+		}
+		return "unknown";
+	}
+
+	namespace
+	{
+		const uint32_t invalidRegion = UINT32_MAX;
+
+		/** @brief Index of the most significant set bit, value must not be zero */
+		inline uint32_t highestBit(uint64_t value)
+		{
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanReverse64(&index, value);
+			return index;
+#else
+			return 63 - __builtin_clzll(value);
+#endif
+		}
+
+		/** @brief Index of the least significant set bit, value must not be zero */
+		inline uint32_t lowestBit(uint64_t value)
+		{
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanForward64(&index, value);
+			return index;
+#else
+			return __builtin_ctzll(value);
+#endif
+		}
+
+		inline VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		/** @brief First and second level list of a size, sizes are at least minRegionSize so the first level is always >= subLevelBits */
+		inline void mapping(VkDeviceSize size, uint32_t* firstLevel, uint32_t* secondLevel)
+		{
+			*firstLevel = highestBit(size);
+			*secondLevel = static_cast<uint32_t>(size >> (*firstLevel - MemoryBlock::subLevelBits)) & (MemoryBlock::subLevelCount - 1);
+		}
+	}
+
+	/**
+	* Take over a device memory block, initially the whole block is a single free range
+	*
+	* @param memory Device memory of the block
+	* @param size Size of the block, a multiple of minRegionSize
+	* @param memoryTypeIndex Memory type the block was allocated from
+	* @param mapped Host pointer to the start of the block if it is host visible
+	*/
+	MemoryBlock::MemoryBlock(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex, void* mapped) : memory(memory), size(size), memoryTypeIndex(memoryTypeIndex), mapped(mapped)
+	{
+		for (uint32_t i = 0; i < firstLevelCount; i++) {
+			for (uint32_t j = 0; j < subLevelCount; j++) {
+				freeLists[i][j] = invalidRegion;
+			}
+		}
+		insertFree(newRegion(0, size));
+	}
+
+	uint32_t MemoryBlock::newRegion(VkDeviceSize offset, VkDeviceSize size)
+	{
+		uint32_t index;
+		if (!unusedRegions.empty()) {
+			index = unusedRegions.back();
+			unusedRegions.pop_back();
+		}
+		else {
+			index = static_cast<uint32_t>(regions.size());
+			regions.push_back({});
+		}
+		Region& region = regions[index];
+		region.offset = offset;
+		region.size = size;
+		region.prevPhysical = invalidRegion;
+		region.nextPhysical = invalidRegion;
+		region.prevFree = invalidRegion;
+		region.nextFree = invalidRegion;
+		region.free = false;
+		return index;
+	}
+
+	void MemoryBlock::insertFree(uint32_t index)
+	{
+		Region& region = regions[index];
+		uint32_t firstLevel, secondLevel;
+		mapping(region.size, &firstLevel, &secondLevel);
+		region.free = true;
+		region.prevFree = invalidRegion;
+		region.nextFree = freeLists[firstLevel][secondLevel];
+		if (region.nextFree != invalidRegion) {
+			regions[region.nextFree].prevFree = index;
+		}
+		freeLists[firstLevel][secondLevel] = index;
+		firstLevelBitmap |= (1ull << firstLevel);
+		secondLevelBitmaps[firstLevel] |= (1u << secondLevel);
+	}
+
+	void MemoryBlock::removeFree(uint32_t index)
+	{
+		Region& region = regions[index];
+		uint32_t firstLevel, secondLevel;
+		mapping(region.size, &firstLevel, &secondLevel);
+		if (region.prevFree != invalidRegion) {
+			regions[region.prevFree].nextFree = region.nextFree;
+		}
+		else {
+			freeLists[firstLevel][secondLevel] = region.nextFree;
+		}
+		if (region.nextFree != invalidRegion) {
+			regions[region.nextFree].prevFree = region.prevFree;
+		}
+		if (freeLists[firstLevel][secondLevel] == invalidRegion) {
+			secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+			if (secondLevelBitmaps[firstLevel] == 0) {
+				firstLevelBitmap &= ~(1ull << firstLevel);
+			}
+		}
+		region.free = false;
+	}
+
+	/** @brief Find a free range of at least the given size, returns invalidRegion if there is none */
+	uint32_t MemoryBlock::findFree(VkDeviceSize size)
+	{
+		// Round up to the next list so every range in the list found is large enough (good fit instead of best fit)
+		uint32_t exactFirstLevel, exactSecondLevel;
+		mapping(size, &exactFirstLevel, &exactSecondLevel);
+		const VkDeviceSize roundedSize = size + (1ull << (exactFirstLevel - subLevelBits)) - 1;
+		uint32_t firstLevel, secondLevel;
+		mapping(roundedSize, &firstLevel, &secondLevel);
+
+		uint32_t secondLevelMap = (firstLevel < firstLevelCount) ? (secondLevelBitmaps[firstLevel] & (~0u << secondLevel)) : 0;
+		if (secondLevelMap == 0) {
+			// Nothing left in this power of two range, take the smallest non-empty larger one
+			const uint64_t firstLevelMap = (firstLevel + 1 < firstLevelCount) ? (firstLevelBitmap & (~0ull << (firstLevel + 1))) : 0;
+			if (firstLevelMap == 0) {
+				// Last resort, the first range of the request's own list may still be large enough (e.g. a request for the whole block)
+				const uint32_t candidate = freeLists[exactFirstLevel][exactSecondLevel];
+				return ((candidate != invalidRegion) && (regions[candidate].size >= size)) ? candidate : invalidRegion;
+			}
+			firstLevel = lowestBit(firstLevelMap);
+			secondLevelMap = secondLevelBitmaps[firstLevel];
+		}
+		secondLevel = lowestBit(secondLevelMap);
+		return freeLists[firstLevel][secondLevel];
+	}
+
+	/** @brief Shrink a range that isn't in a free list to the given size and put the remainder into the free lists */
+	void MemoryBlock::split(uint32_t index, VkDeviceSize size)
+	{
+		const VkDeviceSize remainder = regions[index].size - size;
+		const uint32_t next = newRegion(regions[index].offset + size, remainder);
+		// newRegion may have reallocated the region storage
+		Region& region = regions[index];
+		region.size = size;
+		regions[next].prevPhysical = index;
+		regions[next].nextPhysical = region.nextPhysical;
+		if (region.nextPhysical != invalidRegion) {
+			regions[region.nextPhysical].prevPhysical = next;
+		}
+		region.nextPhysical = next;
+		insertFree(next);
+	}
+
+	/**
+	* Carve a range from the block
+	*
+	* @param size Requested size
+	* @param alignment Required alignment of the offset
+	* @param region Index of the range to pass to free()
+	* @param offset Offset of the range in the block
+	* @param allocatedSize Size actually taken from the block (rounded up to minRegionSize)
+	*
+	* @return False if the block doesn't have a large enough free range
+	*/
+	bool MemoryBlock::allocate(VkDeviceSize size, VkDeviceSize alignment, uint32_t* region, VkDeviceSize* offset, VkDeviceSize* allocatedSize)
+	{
+		// All range offsets and sizes are multiples of minRegionSize, so smaller alignments are always met
+		// Larger (power of two) alignments are multiples of it as well, so the padding in front can always become a free range of its own
+		size = alignUp(std::max(size, minRegionSize), minRegionSize);
+		const VkDeviceSize padding = (alignment > minRegionSize) ? alignment - minRegionSize : 0;
+
+		uint32_t index = findFree(size + padding);
+		if (index == invalidRegion) {
+			return false;
+		}
+		removeFree(index);
+
+		const VkDeviceSize alignedOffset = alignUp(regions[index].offset, alignment);
+		if (alignedOffset != regions[index].offset) {
+			// The padding stays free, the allocation continues with the range behind it
+			const uint32_t padRegion = index;
+			split(padRegion, alignedOffset - regions[padRegion].offset);
+			index = regions[padRegion].nextPhysical;
+			removeFree(index);
+			insertFree(padRegion);
+		}
+		if (regions[index].size > size) {
+			split(index, size);
+		}
+
+		allocationCount++;
+		usedSize += regions[index].size;
+		*region = index;
+		*offset = regions[index].offset;
+		*allocatedSize = regions[index].size;
+		return true;
+	}
+
+	/** @brief Return a range to the block, merging it with free neighbours */
+	void MemoryBlock::free(uint32_t index)
+	{
+		assert(!regions[index].free);
+		allocationCount--;
+		usedSize -= regions[index].size;
+
+		const uint32_t next = regions[index].nextPhysical;
+		if ((next != invalidRegion) && regions[next].free) {
+			removeFree(next);
+			regions[index].size += regions[next].size;
+			regions[index].nextPhysical = regions[next].nextPhysical;
+			if (regions[next].nextPhysical != invalidRegion) {
+				regions[regions[next].nextPhysical].prevPhysical = index;
+			}
+			unusedRegions.push_back(next);
+		}
+		const uint32_t prev = regions[index].prevPhysical;
+		if ((prev != invalidRegion) && regions[prev].free) {
+			removeFree(prev);
+			regions[prev].size += regions[index].size;
+			regions[prev].nextPhysical = regions[index].nextPhysical;
+			if (regions[index].nextPhysical != invalidRegion) {
+				regions[regions[index].nextPhysical].prevPhysical = prev;
+			}
+			unusedRegions.push_back(index);
+			index = prev;
+		}
+		insertFree(index);
+	}
+
+	/**
+	* Set up the allocator for a device
+	*
+	* @param physicalDevice Physical device the device was created from
+	* @param device Logical device to allocate from
+	* @param getMemoryProperties2 (Optional) vkGetPhysicalDeviceMemoryProperties2, pass it if VK_EXT_memory_budget has been enabled to get budgets reported by the driver
+	*/
+	void MemoryAllocator::create(VkPhysicalDevice physicalDevice, VkDevice device, PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2)
+	{
+		this->device = device;
+		this->physicalDevice = physicalDevice;
+		this->getMemoryProperties2 = getMemoryProperties2;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		nonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+		pools.resize(memoryProperties.memoryTypeCount * 2);
+		stats.resize(memoryProperties.memoryHeapCount);
+		memoryTypeStats.resize(memoryProperties.memoryTypeCount);
+		budgets.resize(memoryProperties.memoryHeapCount);
+		budgetReservedSize.resize(memoryProperties.memoryHeapCount);
+		overBudget.assign(memoryProperties.memoryHeapCount, false);
+		updateBudget();
+	}
+
+	/** @brief Free all blocks, any allocation still alive becomes invalid */
+	void MemoryAllocator::destroy()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& pool : pools) {
+			for (auto& block : pool) {
+				freeMemory(block->memory, block->mapped != nullptr);
+			}
+		}
+		pools.clear();
+		stats.clear();
+		memoryTypeStats.clear();
+		budgets.clear();
+		budgetReservedSize.clear();
+		overBudget.clear();
+	}
+
+	VkDeviceSize MemoryAllocator::blockSize(uint32_t memoryTypeIndex) const
+	{
+		const VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+		const VkDeviceSize smallHeapSize = 1024ull * 1024 * 1024;
+		return alignUp((heapSize <= smallHeapSize) ? (heapSize / 8) : preferredBlockSize, MemoryBlock::minRegionSize);
+	}
+
+	VkResult MemoryAllocator::allocateMemory(VkDeviceSize size, uint32_t memoryTypeIndex, VkMemoryAllocateFlags allocateFlags, VkDeviceMemory* memory, void** mapped)
+	{
+		VkMemoryAllocateInfo memAlloc{};
+		memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memAlloc.allocationSize = size;
+		memAlloc.memoryTypeIndex = memoryTypeIndex;
+		VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
+		if (allocateFlags != 0) {
+			allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR;
+			allocFlagsInfo.flags = allocateFlags;
+			memAlloc.pNext = &allocFlagsInfo;
+		}
+		VkResult result = vkAllocateMemory(device, &memAlloc, vks::HostAllocator::callbacks(), memory);
+		if (result != VK_SUCCESS) {
+			return result;
+		}
+		*mapped = nullptr;
+		// Host visible memory stays mapped, as a memory object can't be mapped more than once at a time by the resources sharing it
+		if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+			result = vkMapMemory(device, *memory, 0, VK_WHOLE_SIZE, 0, mapped);
+			if (result != VK_SUCCESS) {
+				vkFreeMemory(device, *memory, vks::HostAllocator::callbacks());
+				*memory = VK_NULL_HANDLE;
+			}
+		}
+		return result;
+	}
+
+	void MemoryAllocator::freeMemory(VkDeviceMemory memory, bool mapped)
+	{
+		if (mapped) {
+			vkUnmapMemory(device, memory);
+		}
+		vkFreeMemory(device, memory, vks::HostAllocator::callbacks());
+	}
+
+	/**
+	* Allocate memory for a resource
+	*
+	* @param memoryRequirements Memory requirements of the resource
+	* @param memoryTypeIndex Memory type to allocate from
+	* @param resourceType Whether the resource is a buffer/linear image or an optimally tiled image
+	* @param allocation Receives the allocated range
+	* @param allocateFlags (Optional) Flags the memory has to be allocated with (e.g. device address), such resources get a dedicated allocation
+	* @param tag (Optional) Category the allocation is accounted to in the statistics
+	*
+	* @note Thread safe, prints a warning if the allocation takes a heap over its budget
+	*
+	* @return VK_SUCCESS or the error of vkAllocateMemory if a new block couldn't be allocated
+	*/
+	VkResult MemoryAllocator::allocate(const VkMemoryRequirements& memoryRequirements, uint32_t memoryTypeIndex, ResourceType resourceType, vks::Allocation* allocation, VkMemoryAllocateFlags allocateFlags, MemoryTag tag)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		*allocation = vks::Allocation();
+		allocation->allocator = this;
+		allocation->memoryTypeIndex = memoryTypeIndex;
+		allocation->tag = tag;
+
+		// Ranges of non-coherent memory are flushed and invalidated individually, which needs them to start and end on an atom boundary
+		VkDeviceSize alignment = memoryRequirements.alignment;
+		VkDeviceSize size = memoryRequirements.size;
+		const VkMemoryPropertyFlags propertyFlags = memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+		if ((propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+			alignment = std::max(alignment, nonCoherentAtomSize);
+			size = alignUp(size, nonCoherentAtomSize);
+		}
+
+		const uint32_t heapIndex = memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+		HeapStats& heapStats = stats[heapIndex];
+		TypeStats& typeStats = memoryTypeStats[memoryTypeIndex];
+		const uint32_t tagIndex = static_cast<uint32_t>(tag);
+		const VkDeviceSize preferredSize = blockSize(memoryTypeIndex);
+
+		// Large resources get their own memory object, they would only fragment the blocks
+		// Commitment of lazily allocated memory is tracked per memory object, so transient attachments don't share blocks either
+		if ((size > preferredSize / 2) || (allocateFlags != 0) || (propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+			VkResult result = allocateMemory(size, memoryTypeIndex, allocateFlags, &allocation->memory, &allocation->mapped);
+			if (result != VK_SUCCESS) {
+				return result;
+			}
+			allocation->size = size;
+			heapStats.reservedSize += size;
+			heapStats.usedSize += size;
+			heapStats.allocationCount++;
+			heapStats.dedicatedAllocationCount++;
+			heapStats.taggedSize[tagIndex] += size;
+			typeStats.allocationCount++;
+			typeStats.usedSize += size;
+			typeStats.taggedSize[tagIndex] += size;
+			checkBudget(heapIndex);
+			return VK_SUCCESS;
+		}
+
+		auto& pool = pools[memoryTypeIndex * 2 + static_cast<uint32_t>(resourceType)];
+		MemoryBlock* block = nullptr;
+		uint32_t region = 0;
+		VkDeviceSize offset = 0;
+		VkDeviceSize allocatedSize = 0;
+		for (auto& candidate : pool) {
+			if (candidate->allocate(size, alignment, &region, &offset, &allocatedSize)) {
+				block = candidate.get();
+				break;
+			}
+		}
+		if (!block) {
+			VkDeviceMemory memory;
+			void* mapped;
+			VkResult result = allocateMemory(preferredSize, memoryTypeIndex, 0, &memory, &mapped);
+			if (result != VK_SUCCESS) {
+				return result;
+			}
+			pool.emplace_back(new MemoryBlock(memory, preferredSize, memoryTypeIndex, mapped));
+			block = pool.back().get();
+			heapStats.blockCount++;
+			heapStats.reservedSize += preferredSize;
+			checkBudget(heapIndex);
+			if (!block->allocate(size, alignment, &region, &offset, &allocatedSize)) {
+				return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+			}
+		}
+
+		allocation->block = block;
+		allocation->region = region;
+		allocation->memory = block->memory;
+		allocation->offset = offset;
+		allocation->size = allocatedSize;
+		allocation->mapped = block->mapped ? static_cast<uint8_t*>(block->mapped) + offset : nullptr;
+		heapStats.allocationCount++;
+		heapStats.usedSize += allocatedSize;
+		heapStats.taggedSize[tagIndex] += allocatedSize;
+		typeStats.allocationCount++;
+		typeStats.usedSize += allocatedSize;
+		typeStats.taggedSize[tagIndex] += allocatedSize;
+		return VK_SUCCESS;
+	}
+
+	/**
+	* Free an allocation and reset it
+	*
+	* @note Thread safe, the GPU must be done with the resource bound to the allocation
+	*/
+	void MemoryAllocator::free(vks::Allocation& allocation)
+	{
+		if (!allocation.valid()) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		HeapStats& heapStats = stats[memoryProperties.memoryTypes[allocation.memoryTypeIndex].heapIndex];
+		TypeStats& typeStats = memoryTypeStats[allocation.memoryTypeIndex];
+		const uint32_t tagIndex = static_cast<uint32_t>(allocation.tag);
+		heapStats.allocationCount--;
+		heapStats.usedSize -= allocation.size;
+		heapStats.taggedSize[tagIndex] -= allocation.size;
+		typeStats.allocationCount--;
+		typeStats.usedSize -= allocation.size;
+		typeStats.taggedSize[tagIndex] -= allocation.size;
+
+		if (!allocation.block) {
+			freeMemory(allocation.memory, allocation.mapped != nullptr);
+			heapStats.reservedSize -= allocation.size;
+			heapStats.dedicatedAllocationCount--;
+			allocation = vks::Allocation();
+			return;
+		}
+
+		MemoryBlock* block = allocation.block;
+		block->free(allocation.region);
+		allocation = vks::Allocation();
+
+		// Keep one empty block per pool around, so a resource that is recreated over and over doesn't allocate device memory every time
+		if (block->allocationCount == 0) {
+			for (uint32_t resourceType = 0; resourceType < 2; resourceType++) {
+				auto& pool = pools[block->memoryTypeIndex * 2 + resourceType];
+				auto it = std::find_if(pool.begin(), pool.end(), [block](const std::unique_ptr<MemoryBlock>& candidate) { return candidate.get() == block; });
+				if ((it != pool.end()) && (pool.size() > 1)) {
+					heapStats.blockCount--;
+					heapStats.reservedSize -= block->size;
+					freeMemory(block->memory, block->mapped != nullptr);
+					pool.erase(it);
+					break;
+				}
+			}
+		}
+	}
+
+	/** @brief Statistics of a memory heap (blocks, allocations and bytes reserved and in use) */
+	MemoryAllocator::HeapStats MemoryAllocator::heapStats(uint32_t heapIndex)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return stats[heapIndex];
+	}
+
+	/** @brief Statistics of a memory type (allocations and bytes in use) */
+	MemoryAllocator::TypeStats MemoryAllocator::typeStats(uint32_t memoryTypeIndex)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return memoryTypeStats[memoryTypeIndex];
+	}
+
+	/**
+	* Query the heap budgets from the driver
+	*
+	* @note The query isn't free, call it about once per frame. Until the next update the usage is extrapolated from what the allocator reserves and frees
+	*/
+	void MemoryAllocator::updateBudget()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!getMemoryProperties2) {
+			return;
+		}
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+		VkPhysicalDeviceMemoryProperties2KHR memoryProperties2{};
+		memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+		memoryProperties2.pNext = &budgetProperties;
+		getMemoryProperties2(physicalDevice, &memoryProperties2);
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+			budgets[i].usage = budgetProperties.heapUsage[i];
+			// Some implementations report a budget above the heap size, or none at all while nothing has been allocated
+			budgets[i].budget = std::min(budgetProperties.heapBudget[i], memoryProperties.memoryHeaps[i].size);
+			budgets[i].reported = budgets[i].budget > 0;
+			budgetReservedSize[i] = stats[i].reservedSize;
+		}
+	}
+
+	MemoryAllocator::HeapBudget MemoryAllocator::currentBudget(uint32_t heapIndex) const
+	{
+		const HeapStats& heapStats = stats[heapIndex];
+		HeapBudget budget = budgets[heapIndex];
+		if (budget.reported) {
+			// Memory reserved or released since the last query isn't part of the reported usage yet
+			budget.usage = budget.usage + heapStats.reservedSize - std::min(budgetReservedSize[heapIndex], budget.usage + heapStats.reservedSize);
+			return budget;
+		}
+		budget.usage = heapStats.reservedSize;
+		budget.budget = static_cast<VkDeviceSize>(memoryProperties.memoryHeaps[heapIndex].size * estimatedBudgetRatio);
+		return budget;
+	}
+
+	/** @brief Warn once when a heap goes over its budget, allocations may start to fail or to be evicted to system memory */
+	void MemoryAllocator::checkBudget(uint32_t heapIndex)
+	{
+		const HeapBudget budget = currentBudget(heapIndex);
+		if (budget.usage <= budget.budget) {
+			overBudget[heapIndex] = false;
+			return;
+		}
+		if (!overBudget[heapIndex]) {
+			overBudget[heapIndex] = true;
+			std::cerr << "Memory heap " << heapIndex << " is over budget: " << (budget.usage >> 20) << " MB used of " << (budget.budget >> 20) << " MB" << (budget.reported ? "" : " (estimated)") << "\n";
+		}
+	}
+
+	/**
+	* Current budget of a memory heap
+	*
+	* @return Usage and budget as of the last updateBudget, adjusted by what the allocator reserved and released since. Without VK_EXT_memory_budget
+	* the usage is the allocator's reserved size and the budget estimatedBudgetRatio of the heap size
+	*/
+	MemoryAllocator::HeapBudget MemoryAllocator::heapBudget(uint32_t heapIndex)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return currentBudget(heapIndex);
+	}
+
+	uint32_t MemoryAllocator::heapCount() const
+	{
+		return memoryProperties.memoryHeapCount;
+	}
+
+	VkDeviceSize MemoryAllocator::heapSize(uint32_t heapIndex) const
+	{
+		return memoryProperties.memoryHeaps[heapIndex].size;
+	}
+}
@@ -0,0 +1,199 @@
+/*
+* Device memory allocator
+*
+* Sub-allocates resources from large per-memory-type blocks using a two level segregated fit (TLSF) scheme
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	class MemoryAllocator;
+	class MemoryBlock;
+
+	/** @brief Category an allocation is accounted to in the allocator's statistics */
+	enum class MemoryTag : uint32_t {
+		Buffer,
+		Image,
+		/** @brief Upload staging memory (e.g. the staging rings) */
+		Staging,
+		/** @brief Resources of the UI overlay */
+		UI
+	};
+	static const uint32_t memoryTagCount = 4;
+	const char* memoryTagName(MemoryTag tag);
+
+	/**
+	* @brief Range of device memory handed out by the allocator
+	*
+	* Resources are bound to memory at offset, several allocations usually share the same VkDeviceMemory
+	*/
+	struct Allocation
+	{
+		MemoryAllocator* allocator = nullptr;
+		/** @brief Block the range was carved from, null for dedicated allocations */
+		MemoryBlock* block = nullptr;
+		/** @brief Index of the range inside the block */
+		uint32_t region = UINT32_MAX;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		uint32_t memoryTypeIndex = 0;
+		MemoryTag tag = MemoryTag::Buffer;
+		/** @brief Host pointer to the start of the range if the memory is host visible (blocks stay mapped for their whole lifetime) */
+		void* mapped = nullptr;
+
+		bool valid() const { return memory != VK_NULL_HANDLE; }
+	};
+
+	/**
+	* @brief Single VkDeviceMemory block carved into ranges with TLSF
+	*
+	* Free ranges are kept in size segregated lists, a first level per power of two and subLevelCount linear subdivisions below that.
+	* Two bitmaps track which lists are non-empty, so finding a fitting range and freeing (including merging with its neighbours) take constant time
+	*/
+	class MemoryBlock
+	{
+	public:
+		static const uint32_t subLevelBits = 4;
+		static const uint32_t subLevelCount = 1 << subLevelBits;
+		static const uint32_t firstLevelCount = 64;
+		/** @brief Smallest range that is tracked on its own, smaller remainders stay part of the neighbouring allocation */
+		static const VkDeviceSize minRegionSize = 256;
+
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint32_t memoryTypeIndex = 0;
+		void* mapped = nullptr;
+		uint32_t allocationCount = 0;
+		VkDeviceSize usedSize = 0;
+
+		MemoryBlock(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex, void* mapped);
+
+		bool allocate(VkDeviceSize size, VkDeviceSize alignment, uint32_t* region, VkDeviceSize* offset, VkDeviceSize* allocatedSize);
+		void free(uint32_t region);
+
+	private:
+		struct Region {
+			VkDeviceSize offset;
+			VkDeviceSize size;
+			uint32_t prevPhysical;
+			uint32_t nextPhysical;
+			uint32_t prevFree;
+			uint32_t nextFree;
+			bool free;
+		};
+		std::vector<Region> regions;
+		/** @brief Indices of unused entries in regions */
+		std::vector<uint32_t> unusedRegions;
+		uint64_t firstLevelBitmap = 0;
+		uint32_t secondLevelBitmaps[firstLevelCount] = {};
+		uint32_t freeLists[firstLevelCount][subLevelCount];
+
+		uint32_t newRegion(VkDeviceSize offset, VkDeviceSize size);
+		void insertFree(uint32_t region);
+		void removeFree(uint32_t region);
+		uint32_t findFree(VkDeviceSize size);
+		void split(uint32_t region, VkDeviceSize size);
+	};
+
+	/**
+	* @brief Device memory allocator owned by vks::VulkanDevice
+	*
+	* Reserves large blocks per memory type and sub-allocates them, instead of calling vkAllocateMemory once per resource.
+	* Buffers and linear images are never placed in the same blocks as optimally tiled images, so bufferImageGranularity
+	* never has to be taken into account when placing neighbouring ranges
+	*/
+	class MemoryAllocator
+	{
+	public:
+		/** @brief Kind of resource an allocation is for */
+		enum class ResourceType {
+			/** @brief Buffers and linearly tiled images */
+			Linear,
+			/** @brief Optimally tiled images */
+			Optimal
+		};
+
+		/** @brief Allocator statistics of a single memory heap */
+		struct HeapStats {
+			uint32_t blockCount = 0;
+			/** @brief Bytes reserved from the heap by blocks and dedicated allocations */
+			VkDeviceSize reservedSize = 0;
+			uint32_t allocationCount = 0;
+			/** @brief Bytes handed out to resources */
+			VkDeviceSize usedSize = 0;
+			uint32_t dedicatedAllocationCount = 0;
+			/** @brief Bytes handed out per vks::MemoryTag */
+			VkDeviceSize taggedSize[memoryTagCount] = {};
+		};
+
+		/** @brief Allocator statistics of a single memory type */
+		struct TypeStats {
+			uint32_t allocationCount = 0;
+			VkDeviceSize usedSize = 0;
+			VkDeviceSize taggedSize[memoryTagCount] = {};
+		};
+
+		/** @brief Memory budget of a heap */
+		struct HeapBudget {
+			/** @brief Bytes of the heap in use by the process, including memory not allocated through the allocator */
+			VkDeviceSize usage = 0;
+			/** @brief Bytes the process can use before allocations may fail or start to evict memory */
+			VkDeviceSize budget = 0;
+			/** @brief True if the values are reported by the driver (VK_EXT_memory_budget), else usage is what the allocator reserved and budget an estimate */
+			bool reported = false;
+		};
+
+		/** @brief Size of the blocks reserved from heaps larger than 1 GB, smaller heaps use an eighth of their size */
+		VkDeviceSize preferredBlockSize = 256 * 1024 * 1024;
+		/** @brief Share of a heap's size assumed to be available if the driver doesn't report a budget */
+		float estimatedBudgetRatio = 0.8f;
+
+		void create(VkPhysicalDevice physicalDevice, VkDevice device, PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2 = nullptr);
+		void destroy();
+
+		VkResult allocate(const VkMemoryRequirements& memoryRequirements, uint32_t memoryTypeIndex, ResourceType resourceType, vks::Allocation* allocation, VkMemoryAllocateFlags allocateFlags = 0, MemoryTag tag = MemoryTag::Buffer);
+		void free(vks::Allocation& allocation);
+
+		HeapStats heapStats(uint32_t heapIndex);
+		TypeStats typeStats(uint32_t memoryTypeIndex);
+		void updateBudget();
+		HeapBudget heapBudget(uint32_t heapIndex);
+		uint32_t heapCount() const;
+		VkDeviceSize heapSize(uint32_t heapIndex) const;
+
+	private:
+		VkDevice device = VK_NULL_HANDLE;
+		VkPhysicalDeviceMemoryProperties memoryProperties{};
+		VkDeviceSize nonCoherentAtomSize = 1;
+		/** @brief Blocks per memory type and resource type */
+		std::vector<std::vector<std::unique_ptr<MemoryBlock>>> pools;
+		std::vector<HeapStats> stats;
+		std::vector<TypeStats> memoryTypeStats;
+		VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+		/** @brief Entry point for querying VK_EXT_memory_budget, null if the extension isn't enabled */
+		PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2 = nullptr;
+		/** @brief Budget per heap as of the last updateBudget, along with what the allocator had reserved at that time */
+		std::vector<HeapBudget> budgets;
+		std::vector<VkDeviceSize> budgetReservedSize;
+		/** @brief Heaps a warning has been printed for, cleared once usage drops below the budget again */
+		std::vector<bool> overBudget;
+		std::mutex mutex;
+
+		VkDeviceSize blockSize(uint32_t memoryTypeIndex) const;
+		VkResult allocateMemory(VkDeviceSize size, uint32_t memoryTypeIndex, VkMemoryAllocateFlags allocateFlags, VkDeviceMemory* memory, void** mapped);
+		void freeMemory(VkDeviceMemory memory, bool mapped);
+		HeapBudget currentBudget(uint32_t heapIndex) const;
+		void checkBudget(uint32_t heapIndex);
+	};
+}
@@ -0,0 +1,139 @@
+/*
+* Parallel command buffer recorder
+*
+* Splits a draw list across job system threads that record into secondary command buffers
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanParallelRecorder.h"
+#include <assert.h>
+#include <algorithm>
+#include <chrono>
+
+namespace vks
+{
+	ParallelRecorder::~ParallelRecorder()
+	{
+		destroy();
+	}
+
+	/**
+	* Create the per-thread command pools
+	*
+	* @param device Logical device to create the command pools on
+	* @param queueFamilyIndex Queue family the primary command buffers will be submitted to
+	* @param framesInFlight Number of frames in flight, each thread gets a separate pool per frame
+	* @param jobSystem Job system the draw list ranges are recorded on
+	*/
+	void ParallelRecorder::create(VkDevice device, uint32_t queueFamilyIndex, uint32_t framesInFlight, vks::JobSystem* jobSystem)
+	{
+		this->device = device;
+		this->jobSystem = jobSystem;
+		allocators.resize(framesInFlight);
+		for (auto& frameAllocators : allocators) {
+			frameAllocators.resize(jobSystem->threadCount());
+			for (auto& allocator : frameAllocators) {
+				allocator.create(device, queueFamilyIndex);
+			}
+		}
+	}
+
+	/**
+	* Destroy all command pools
+	*
+	* @note The caller has to make sure that none of the recorded command buffers is still in use by the GPU
+	*/
+	void ParallelRecorder::destroy()
+	{
+		for (auto& frameAllocators : allocators) {
+			for (auto& allocator : frameAllocators) {
+				allocator.destroy();
+			}
+		}
+		allocators.clear();
+		secondaryCommandBuffers.clear();
+	}
+
+	/** @brief Maximum number of secondary command buffers recorded in parallel */
+	uint32_t ParallelRecorder::threadCount() const
+	{
+		const uint32_t available = jobSystem ? jobSystem->threadCount() : 1;
+		return (maxThreads == 0) ? available : std::min(maxThreads, available);
+	}
+
+	/**
+	* Split the draw list across the recording threads and record it into one secondary command buffer per thread
+	*
+	* @param frameIndex Frame in flight the command buffers are recorded for, the GPU must be done with that frame's previous submission
+	* @param renderPass Render pass the secondary command buffers will be executed in
+	* @param subpass Subpass the secondary command buffers will be executed in
+	* @param framebuffer (Optional) Framebuffer the render pass is begun with, may allow the driver to optimize
+	* @param drawCount Number of draws in the draw list
+	* @param recordFunc Function recording a range of the draw list, called concurrently from several threads
+	*
+	* @return Secondary command buffers in draw list order, to be passed to vkCmdExecuteCommands (see execute())
+	*/
+	const std::vector<VkCommandBuffer>& ParallelRecorder::record(uint32_t frameIndex, VkRenderPass renderPass, uint32_t subpass, VkFramebuffer framebuffer, uint32_t drawCount, RecordFunc recordFunc)
+	{
+		// The first range is recorded on the calling thread, which needs a pool of its own
+		assert(jobSystem->threadIndex() != vks::JobSystem::externalThread);
+
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		// All pools of this frame can be reset at once, the GPU is done with the frame
+		for (auto& allocator : allocators[frameIndex]) {
+			allocator.reset();
+		}
+
+		VkCommandBufferInheritanceInfo inheritanceInfo = vks::initializers::commandBufferInheritanceInfo();
+		inheritanceInfo.renderPass = renderPass;
+		inheritanceInfo.subpass = subpass;
+		inheritanceInfo.framebuffer = framebuffer;
+
+		// Don't split into more command buffers than there is work for
+		const uint32_t wanted = (drawCount + minDrawsPerThread - 1) / std::max(minDrawsPerThread, 1u);
+		const uint32_t rangeCount = std::max(std::min(wanted, threadCount()), 1u);
+		secondaryCommandBuffers.resize(rangeCount);
+
+		// Contiguous ranges keep the secondary command buffers in draw list order
+		const uint32_t perRange = drawCount / rangeCount;
+		const uint32_t remainder = drawCount % rangeCount;
+		auto recordRange = [&](uint32_t rangeIndex)
+		{
+			const uint32_t first = rangeIndex * perRange + std::min(rangeIndex, remainder);
+			const uint32_t count = perRange + ((rangeIndex < remainder) ? 1 : 0);
+			// Ranges running on the same thread use that thread's pool one after another, never concurrently
+			const uint32_t threadIndex = jobSystem->threadIndex();
+			vks::CommandAllocator& allocator = allocators[frameIndex][threadIndex];
+			VkCommandBuffer commandBuffer = allocator.begin(VK_COMMAND_BUFFER_LEVEL_SECONDARY, &inheritanceInfo);
+			if (count > 0) {
+				recordFunc(commandBuffer, first, count, threadIndex);
+			}
+			VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+			secondaryCommandBuffers[rangeIndex] = commandBuffer;
+		};
+
+		vks::JobSystem::Counter counter;
+		for (uint32_t i = 1; i < rangeCount; i++) {
+			jobSystem->run([&recordRange, i] { recordRange(i); }, &counter);
+		}
+		recordRange(0);
+		jobSystem->wait(counter);
+
+		lastRecordTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		return secondaryCommandBuffers;
+	}
+
+	/**
+	* Execute the secondary command buffers of the last record() call
+	*
+	* @param primaryCommandBuffer Primary command buffer inside a render pass instance begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+	*/
+	void ParallelRecorder::execute(VkCommandBuffer primaryCommandBuffer)
+	{
+		if (!secondaryCommandBuffers.empty()) {
+			vkCmdExecuteCommands(primaryCommandBuffer, static_cast<uint32_t>(secondaryCommandBuffers.size()), secondaryCommandBuffers.data());
+		}
+	}
+}
@@ -0,0 +1,57 @@
+/*
+* Parallel command buffer recorder
+*
+* Splits a draw list across job system threads that record into secondary command buffers
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <functional>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanCommandAllocator.h"
+#include "VulkanJobSystem.h"
+
+namespace vks
+{
+	/**
+	* @brief Records a draw list into secondary command buffers on several threads
+	*
+	* Every job system thread owns one transient command pool per frame in flight, so no pool is ever used by two
+	* threads at the same time or touched while the GPU may still execute command buffers from it
+	* @note record() has to be called from the thread that created the job system (thread 0), external threads own no pools
+	*/
+	class ParallelRecorder
+	{
+	public:
+		/** @brief Records draws [first, first + count) of the draw list into the given (already begun) secondary command buffer */
+		typedef std::function<void(VkCommandBuffer commandBuffer, uint32_t first, uint32_t count, uint32_t threadIndex)> RecordFunc;
+
+		/** @brief Minimum number of draws per secondary command buffer */
+		uint32_t minDrawsPerThread = 64;
+		/** @brief Maximum number of secondary command buffers recorded in parallel, 0 uses all job system threads */
+		uint32_t maxThreads = 0;
+		/** @brief Wall clock time in milliseconds the last call to record() took */
+		double lastRecordTime = 0.0;
+
+		~ParallelRecorder();
+
+		void create(VkDevice device, uint32_t queueFamilyIndex, uint32_t framesInFlight, vks::JobSystem* jobSystem);
+		void destroy();
+		uint32_t threadCount() const;
+
+		const std::vector<VkCommandBuffer>& record(uint32_t frameIndex, VkRenderPass renderPass, uint32_t subpass, VkFramebuffer framebuffer, uint32_t drawCount, RecordFunc recordFunc);
+		void execute(VkCommandBuffer primaryCommandBuffer);
+
+	private:
+		VkDevice device = VK_NULL_HANDLE;
+		vks::JobSystem* jobSystem = nullptr;
+		/** @brief Command allocators indexed by [frame][job system thread] */
+		std::vector<std::vector<vks::CommandAllocator>> allocators;
+		std::vector<VkCommandBuffer> secondaryCommandBuffers;
+	};
+}
@@ -0,0 +1,323 @@
+/*
+* Pipeline builder
+*
+* Describes graphics pipelines with a compact hashable key and caches the pipelines by key
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanPipelineBuilder.h"
+
+#include <assert.h>
+#include <chrono>
+#include <string.h>
+#include <vector>
+
+namespace vks
+{
+	bool PipelineKey::operator==(const PipelineKey& other) const
+	{
+		return memcmp(this, &other, sizeof(PipelineKey)) == 0;
+	}
+
+	size_t PipelineKeyHash::operator()(const PipelineKey& key) const
+	{
+		// Word wise instead of byte wise, the key is a few hundred bytes and hashed on every lookup
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&key);
+		uint64_t hash = 14695981039346656037ull;
+		size_t offset = 0;
+		for (; offset + sizeof(uint64_t) <= sizeof(PipelineKey); offset += sizeof(uint64_t)) {
+			uint64_t word;
+			memcpy(&word, bytes + offset, sizeof(uint64_t));
+			hash = (hash ^ word) * 1099511628211ull;
+		}
+		for (; offset < sizeof(PipelineKey); offset++) {
+			hash = (hash ^ bytes[offset]) * 1099511628211ull;
+		}
+		return static_cast<size_t>(hash ^ (hash >> 32));
+	}
+
+	/**
+	* Start a pipeline description with the default state
+	*
+	* @param layout Pipeline layout
+	* @param renderPass Render pass the pipeline is used with (or a compatible one)
+	* @param subpass (Optional) Index of the subpass the pipeline is used in
+	*/
+	PipelineBuilder::PipelineBuilder(VkPipelineLayout layout, VkRenderPass renderPass, uint32_t subpass)
+	{
+		// Padding included, keys are hashed and compared as raw memory
+		memset(&pipelineKey, 0, sizeof(PipelineKey));
+		pipelineKey.layout = layout;
+		pipelineKey.renderPass = renderPass;
+		pipelineKey.subpass = subpass;
+		pipelineKey.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		pipelineKey.polygonMode = VK_POLYGON_MODE_FILL;
+		pipelineKey.cullMode = VK_CULL_MODE_NONE;
+		pipelineKey.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+		pipelineKey.lineWidth = 1.0f;
+		pipelineKey.depthCompareOp = VK_COMPARE_OP_ALWAYS;
+		pipelineKey.stencilFront.compareOp = VK_COMPARE_OP_ALWAYS;
+		pipelineKey.stencilBack.compareOp = VK_COMPARE_OP_ALWAYS;
+		pipelineKey.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+		colorAttachments(1);
+		dynamicState(VK_DYNAMIC_STATE_VIEWPORT);
+		dynamicState(VK_DYNAMIC_STATE_SCISSOR);
+	}
+
+	/**
+	* Add a shader stage by the id of its code, its module is only created if the pipeline has to be compiled (see vks::PipelineCompiler)
+	*
+	* @param stage Stage of the shader
+	* @param shader Id from vks::ShaderModuleCache::loadDeferred(), or from find() for a module returned by load()
+	*/
+	PipelineBuilder& PipelineBuilder::shaderStage(VkShaderStageFlagBits stage, vks::ShaderId shader)
+	{
+		assert(pipelineKey.stageCount < PipelineKey::maxStages);
+		pipelineKey.stages[pipelineKey.stageCount] = stage;
+		pipelineKey.shaders[pipelineKey.stageCount] = shader;
+		pipelineKey.stageCount++;
+		return *this;
+	}
+
+	PipelineBuilder& PipelineBuilder::vertexBinding(uint32_t binding, uint32_t stride, VkVertexInputRate inputRate)
+	{
+		assert(pipelineKey.vertexBindingCount < PipelineKey::maxVertexBindings);
+		VkVertexInputBindingDescription& description = pipelineKey.vertexBindings[pipelineKey.vertexBindingCount++];
+		description.binding = binding;
+		description.stride = stride;
+		description.inputRate = inputRate;
+		return *this;
+	}
+
+	PipelineBuilder& PipelineBuilder::vertexAttribute(uint32_t location, uint32_t binding, VkFormat format, uint32_t offset)
+	{
+		assert(pipelineKey.vertexAttributeCount < PipelineKey::maxVertexAttributes);
+		VkVertexInputAttributeDescription& description = pipelineKey.vertexAttributes[pipelineKey.vertexAttributeCount++];
+		description.location = location;
+		description.binding = binding;
+		description.format = format;
+		description.offset = offset;
+		return *this;
+	}
+
+	PipelineBuilder& PipelineBuilder::inputAssembly(VkPrimitiveTopology topology, VkBool32 primitiveRestart)
+	{
+		pipelineKey.topology = topology;
+		pipelineKey.primitiveRestart = primitiveRestart;
+		return *this;
+	}
+
+	PipelineBuilder& PipelineBuilder::rasterization(VkPolygonMode polygonMode, VkCullModeFlags cullMode, VkFrontFace frontFace, float lineWidth)
+	{
+		pipelineKey.polygonMode = polygonMode;
+		pipelineKey.cullMode = cullMode;
+		pipelineKey.frontFace = frontFace;
+		pipelineKey.lineWidth = lineWidth;
+		return *this;
+	}
+
+	PipelineBuilder& PipelineBuilder::depthStencil(VkBool32 depthTest, VkBool32 depthWrite, VkCompareOp depthCompareOp)
+	{
+		pipelineKey.depthTest = depthTest;
+		pipelineKey.depthWrite = depthWrite;
+		pipelineKey.depthCompareOp = depthCompareOp;
+		return *this;
+	}
+
+	/** @brief Enable the stencil test with the given operations */
+	PipelineBuilder& PipelineBuilder::stencil(const VkStencilOpState& front, const VkStencilOpState& back)
+	{
+		pipelineKey.stencilTest = VK_TRUE;
+		pipelineKey.stencilFront = front;
+		pipelineKey.stencilBack = back;
+		return *this;
+	}
+
+	PipelineBuilder& PipelineBuilder::multisample(VkSampleCountFlagBits rasterizationSamples)
+	{
+		pipelineKey.rasterizationSamples = rasterizationSamples;
+		return *this;
+	}
+
+	/** @brief Set the number of color attachments, new attachments write all channels without blending */
+	PipelineBuilder& PipelineBuilder::colorAttachments(uint32_t count)
+	{
+		assert(count <= PipelineKey::maxColorAttachments);
+		for (uint32_t i = pipelineKey.colorAttachmentCount; i < count; i++) {
+			pipelineKey.blendAttachments[i].colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		}
+		for (uint32_t i = count; i < PipelineKey::maxColorAttachments; i++) {
+			memset(&pipelineKey.blendAttachments[i], 0, sizeof(VkPipelineColorBlendAttachmentState));
+		}
+		pipelineKey.colorAttachmentCount = count;
+		return *this;
+	}
+
+	PipelineBuilder& PipelineBuilder::blend(uint32_t attachment, const VkPipelineColorBlendAttachmentState& state)
+	{
+		assert(attachment < pipelineKey.colorAttachmentCount);
+		pipelineKey.blendAttachments[attachment] = state;
+		return *this;
+	}
+
+	PipelineBuilder& PipelineBuilder::dynamicState(VkDynamicState state)
+	{
+		assert(state <= VK_DYNAMIC_STATE_STENCIL_REFERENCE);
+		pipelineKey.dynamicStates |= 1u << state;
+		return *this;
+	}
+
+	/** @brief Set up the cache, missing pipelines are compiled by (and owned by) the given compiler */
+	void PipelineStateCache::create(vks::PipelineCompiler* compiler)
+	{
+		this->compiler = compiler;
+	}
+
+	/** @brief Forget all pipelines, destroying them is up to the compiler */
+	void PipelineStateCache::destroy()
+	{
+		std::unique_lock<std::shared_mutex> lock(mutex);
+		pipelines.clear();
+		compiler = nullptr;
+	}
+
+	/**
+	* Look up the pipeline for the builder's state, compiling it if it hasn't been requested before
+	*
+	* @return Future for the pipeline, see vks::PipelineCompiler::current()
+	*/
+	std::shared_future<VkPipeline> PipelineStateCache::request(const PipelineBuilder& builder)
+	{
+		// Only waits if another thread is handing the same pipeline to the compiler right now
+		return lookup(builder.key()).get();
+	}
+
+	/**
+	* Get the pipeline for the builder's state to draw with right now
+	*
+	* @param builder State of the pipeline
+	* @param placeholder Returned while the pipeline is compiling, VK_NULL_HANDLE to skip the draw
+	*/
+	VkPipeline PipelineStateCache::get(const PipelineBuilder& builder, VkPipeline placeholder)
+	{
+		const PendingPipeline pending = lookup(builder.key());
+		if (pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			return placeholder;
+		}
+		return vks::PipelineCompiler::current(pending.get(), placeholder);
+	}
+
+	PipelineStateCache::PendingPipeline PipelineStateCache::lookup(const PipelineKey& key)
+	{
+		{
+			std::shared_lock<std::shared_mutex> lock(mutex);
+			auto existing = pipelines.find(key);
+			if (existing != pipelines.end()) {
+				hits++;
+				return existing->second;
+			}
+		}
+		std::promise<std::shared_future<VkPipeline>> promise;
+		PendingPipeline pending;
+		{
+			std::unique_lock<std::shared_mutex> lock(mutex);
+			// Another thread may have missed on the same key between the two locks
+			auto existing = pipelines.find(key);
+			if (existing != pipelines.end()) {
+				hits++;
+				return existing->second;
+			}
+			misses++;
+			pending = promise.get_future().share();
+			pipelines[key] = pending;
+		}
+		// Copying the description (or compiling, without worker threads) doesn't block lookups of other pipelines
+		promise.set_value(compile(key));
+		return pending;
+	}
+
+	std::shared_future<VkPipeline> PipelineStateCache::compile(const PipelineKey& key)
+	{
+		std::vector<VkPipelineShaderStageCreateInfo> stages(key.stageCount);
+		for (uint32_t i = 0; i < key.stageCount; i++) {
+			stages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			stages[i].stage = static_cast<VkShaderStageFlagBits>(key.stages[i]);
+			// Created by the compiler from key.shaders if the pipeline isn't already compiled
+			stages[i].module = VK_NULL_HANDLE;
+			stages[i].pName = "main";
+		}
+
+		VkPipelineVertexInputStateCreateInfo vertexInputState{};
+		vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		vertexInputState.vertexBindingDescriptionCount = key.vertexBindingCount;
+		vertexInputState.pVertexBindingDescriptions = key.vertexBindings;
+		vertexInputState.vertexAttributeDescriptionCount = key.vertexAttributeCount;
+		vertexInputState.pVertexAttributeDescriptions = key.vertexAttributes;
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState{};
+		inputAssemblyState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		inputAssemblyState.topology = static_cast<VkPrimitiveTopology>(key.topology);
+		inputAssemblyState.primitiveRestartEnable = key.primitiveRestart;
+
+		VkPipelineViewportStateCreateInfo viewportState{};
+		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportState.viewportCount = 1;
+		viewportState.scissorCount = 1;
+
+		VkPipelineRasterizationStateCreateInfo rasterizationState{};
+		rasterizationState.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterizationState.polygonMode = static_cast<VkPolygonMode>(key.polygonMode);
+		rasterizationState.cullMode = key.cullMode;
+		rasterizationState.frontFace = static_cast<VkFrontFace>(key.frontFace);
+		rasterizationState.lineWidth = key.lineWidth;
+
+		VkPipelineMultisampleStateCreateInfo multisampleState{};
+		multisampleState.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisampleState.rasterizationSamples = static_cast<VkSampleCountFlagBits>(key.rasterizationSamples);
+
+		VkPipelineDepthStencilStateCreateInfo depthStencilState{};
+		depthStencilState.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		depthStencilState.depthTestEnable = key.depthTest;
+		depthStencilState.depthWriteEnable = key.depthWrite;
+		depthStencilState.depthCompareOp = static_cast<VkCompareOp>(key.depthCompareOp);
+		depthStencilState.stencilTestEnable = key.stencilTest;
+		depthStencilState.front = key.stencilFront;
+		depthStencilState.back = key.stencilBack;
+
+		VkPipelineColorBlendStateCreateInfo colorBlendState{};
+		colorBlendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		colorBlendState.attachmentCount = key.colorAttachmentCount;
+		colorBlendState.pAttachments = key.blendAttachments;
+
+		std::vector<VkDynamicState> dynamicStates;
+		for (uint32_t state = VK_DYNAMIC_STATE_VIEWPORT; state <= VK_DYNAMIC_STATE_STENCIL_REFERENCE; state++) {
+			if (key.dynamicStates & (1u << state)) {
+				dynamicStates.push_back(static_cast<VkDynamicState>(state));
+			}
+		}
+		VkPipelineDynamicStateCreateInfo dynamicState{};
+		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+		dynamicState.pDynamicStates = dynamicStates.data();
+
+		VkGraphicsPipelineCreateInfo pipelineCI{};
+		pipelineCI.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineCI.stageCount = key.stageCount;
+		pipelineCI.pStages = stages.data();
+		pipelineCI.pVertexInputState = &vertexInputState;
+		pipelineCI.pInputAssemblyState = &inputAssemblyState;
+		pipelineCI.pViewportState = &viewportState;
+		pipelineCI.pRasterizationState = &rasterizationState;
+		pipelineCI.pMultisampleState = &multisampleState;
+		pipelineCI.pDepthStencilState = &depthStencilState;
+		pipelineCI.pColorBlendState = &colorBlendState;
+		pipelineCI.pDynamicState = &dynamicState;
+		pipelineCI.layout = key.layout;
+		pipelineCI.renderPass = key.renderPass;
+		pipelineCI.subpass = key.subpass;
+		pipelineCI.basePipelineIndex = -1;
+		// The compiler copies the create info before returning
+		return compiler->compile(pipelineCI, key.shaders);
+	}
+}
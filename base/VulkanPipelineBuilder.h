@@ -0,0 +1,144 @@
+/*
+* Pipeline builder
+*
+* Describes graphics pipelines with a compact hashable key and caches the pipelines by key
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <future>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "vulkan/vulkan.h"
+#include "VulkanPipelineCompiler.h"
+
+namespace vks
+{
+	/**
+	* @brief Everything that makes up a graphics pipeline, as a fixed size POD
+	*
+	* Unused array entries stay zero, so keys can be hashed and compared as raw memory. The key is zeroed as a whole (padding included)
+	* by vks::PipelineBuilder, it shouldn't be filled in by hand
+	*
+	* Shaders are identified by the vks::ShaderId of their code in a vks::ShaderModuleCache, which is derived from the hash of the code.
+	* Loads of the same code get the same key whatever module they ended up with, and a module handle that is reused after being
+	* destroyed never matches an old pipeline. Render pass compatibility is identified by the render pass handle and subpass
+	*/
+	struct PipelineKey
+	{
+		static const uint32_t maxStages = 5;
+		static const uint32_t maxVertexBindings = 4;
+		static const uint32_t maxVertexAttributes = 8;
+		static const uint32_t maxColorAttachments = 4;
+
+		vks::ShaderId shaders[maxStages];
+		VkPipelineLayout layout;
+		VkRenderPass renderPass;
+		uint32_t subpass;
+		uint32_t stages[maxStages];
+		uint32_t stageCount;
+
+		VkVertexInputBindingDescription vertexBindings[maxVertexBindings];
+		VkVertexInputAttributeDescription vertexAttributes[maxVertexAttributes];
+		uint32_t vertexBindingCount;
+		uint32_t vertexAttributeCount;
+
+		uint32_t topology;
+		uint32_t primitiveRestart;
+		uint32_t polygonMode;
+		uint32_t cullMode;
+		uint32_t frontFace;
+		float lineWidth;
+
+		uint32_t depthTest;
+		uint32_t depthWrite;
+		uint32_t depthCompareOp;
+		uint32_t stencilTest;
+		VkStencilOpState stencilFront;
+		VkStencilOpState stencilBack;
+
+		uint32_t rasterizationSamples;
+		VkPipelineColorBlendAttachmentState blendAttachments[maxColorAttachments];
+		uint32_t colorAttachmentCount;
+		/** @brief Bit n set for VkDynamicState n, only the core states up to VK_DYNAMIC_STATE_STENCIL_REFERENCE */
+		uint32_t dynamicStates;
+
+		bool operator==(const PipelineKey& other) const;
+		bool operator!=(const PipelineKey& other) const { return !(*this == other); }
+	};
+
+	/** @brief 64 bit FNV-1a over the key's words */
+	struct PipelineKeyHash
+	{
+		size_t operator()(const PipelineKey& key) const;
+	};
+
+	/**
+	* @brief Fills a vks::PipelineKey, starting from the state most pipelines of the framework use
+	*
+	* Defaults: triangle lists, filled polygons without culling, counter clockwise front faces, no depth or stencil test, single sampling,
+	* one color attachment without blending and dynamic viewport and scissor
+	*/
+	class PipelineBuilder
+	{
+	public:
+		PipelineBuilder(VkPipelineLayout layout, VkRenderPass renderPass, uint32_t subpass = 0);
+
+		PipelineBuilder& shaderStage(VkShaderStageFlagBits stage, vks::ShaderId shader);
+		PipelineBuilder& vertexBinding(uint32_t binding, uint32_t stride, VkVertexInputRate inputRate = VK_VERTEX_INPUT_RATE_VERTEX);
+		PipelineBuilder& vertexAttribute(uint32_t location, uint32_t binding, VkFormat format, uint32_t offset);
+		PipelineBuilder& inputAssembly(VkPrimitiveTopology topology, VkBool32 primitiveRestart = VK_FALSE);
+		PipelineBuilder& rasterization(VkPolygonMode polygonMode, VkCullModeFlags cullMode, VkFrontFace frontFace, float lineWidth = 1.0f);
+		PipelineBuilder& depthStencil(VkBool32 depthTest, VkBool32 depthWrite, VkCompareOp depthCompareOp);
+		PipelineBuilder& stencil(const VkStencilOpState& front, const VkStencilOpState& back);
+		PipelineBuilder& multisample(VkSampleCountFlagBits rasterizationSamples);
+		PipelineBuilder& colorAttachments(uint32_t count);
+		PipelineBuilder& blend(uint32_t attachment, const VkPipelineColorBlendAttachmentState& state);
+		PipelineBuilder& dynamicState(VkDynamicState state);
+
+		const PipelineKey& key() const { return pipelineKey; }
+
+	private:
+		PipelineKey pipelineKey;
+	};
+
+	/**
+	* @brief Graphics pipelines by vks::PipelineKey
+	*
+	* Looking up a pipeline is a hash of the key and a map lookup, cheap enough to be done while recording each draw or command buffer.
+	* Missing pipelines are handed to a vks::PipelineCompiler (which owns them), the cache only keeps the futures.
+	* Hits and misses are counted for the benchmark
+	*
+	* @note Safe to use from multiple recording threads, hits only take a shared lock and misses hand the pipeline to the compiler
+	* after releasing the lock (threads asking for it meanwhile get the placeholder from get() or wait for the hand-over in request())
+	*/
+	class PipelineStateCache
+	{
+	public:
+		void create(vks::PipelineCompiler* compiler);
+		void destroy();
+
+		std::shared_future<VkPipeline> request(const PipelineBuilder& builder);
+		VkPipeline get(const PipelineBuilder& builder, VkPipeline placeholder = VK_NULL_HANDLE);
+
+		/** @brief Requests answered from the cache */
+		std::atomic<uint64_t> hits{ 0 };
+		/** @brief Requests that had to compile a new pipeline */
+		std::atomic<uint64_t> misses{ 0 };
+
+	private:
+		/** @brief Set once a missing pipeline has been handed to the compiler, holds the compiler's future for it */
+		typedef std::shared_future<std::shared_future<VkPipeline>> PendingPipeline;
+
+		vks::PipelineCompiler* compiler = nullptr;
+		std::shared_mutex mutex;
+		std::unordered_map<PipelineKey, PendingPipeline, PipelineKeyHash> pipelines;
+
+		PendingPipeline lookup(const PipelineKey& key);
+		std::shared_future<VkPipeline> compile(const PipelineKey& key);
+	};
+}
@@ -0,0 +1,165 @@
+/*
+* Persistent pipeline cache
+*
+* Pipeline cache that is loaded from and saved to a file, so pipelines compiled by one run are reused by the next
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanPipelineCacheFile.h"
+#include "VulkanMappedFile.h"
+
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+namespace vks
+{
+	/**
+	* Create the pipeline cache, with the data of the file if it was written for the same device and driver
+	*
+	* @param device Device to create the cache on
+	* @param fileName File the cache is loaded from and saved to
+	*/
+	void PipelineCacheFile::create(vks::VulkanDevice* device, const std::string& fileName)
+	{
+		this->device = device;
+		this->fileName = fileName;
+		loaded = false;
+		savedSize = 0;
+
+		VkPipelineCacheCreateInfo pipelineCacheCI{};
+		pipelineCacheCI.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		vks::MappedFile file;
+		if (file.open(fileName) && (file.size() >= sizeof(FileHeader))) {
+			FileHeader header;
+			memcpy(&header, file.data(), sizeof(FileHeader));
+			const FileHeader expected = deviceHeader();
+			const uint8_t* data = file.data() + sizeof(FileHeader);
+			// The driver's own header at the start of the data has to agree with the device as well
+			VkPipelineCacheHeaderVersionOne cacheHeader{};
+			if (header.dataSize >= sizeof(cacheHeader)) {
+				memcpy(&cacheHeader, data, sizeof(cacheHeader));
+			}
+			const bool valid = (header.magic == expected.magic) && (header.version == expected.version)
+				&& (header.vendorID == expected.vendorID) && (header.deviceID == expected.deviceID) && (header.driverVersion == expected.driverVersion)
+				&& (memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) == 0)
+				&& (header.dataSize >= sizeof(cacheHeader)) && (header.dataSize == file.size() - sizeof(FileHeader)) && (hash(data, static_cast<size_t>(header.dataSize)) == header.dataHash)
+				&& (cacheHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE) && (cacheHeader.vendorID == expected.vendorID) && (cacheHeader.deviceID == expected.deviceID)
+				&& (memcmp(cacheHeader.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) == 0);
+			if (valid) {
+				pipelineCacheCI.initialDataSize = static_cast<size_t>(header.dataSize);
+				pipelineCacheCI.pInitialData = data;
+			}
+			else {
+				std::cerr << "Discarding pipeline cache " << fileName << ", it was written for a different device or driver or is damaged" << "\n";
+			}
+		}
+		VkResult result = vkCreatePipelineCache(device->logicalDevice, &pipelineCacheCI, vks::HostAllocator::callbacks(), &cache);
+		if ((result != VK_SUCCESS) && (pipelineCacheCI.pInitialData != nullptr)) {
+			// Still start with an empty cache if the driver rejects the data
+			pipelineCacheCI.initialDataSize = 0;
+			pipelineCacheCI.pInitialData = nullptr;
+			result = vkCreatePipelineCache(device->logicalDevice, &pipelineCacheCI, vks::HostAllocator::callbacks(), &cache);
+		}
+		VK_CHECK_RESULT(result);
+		loaded = (pipelineCacheCI.pInitialData != nullptr);
+		savedSize = pipelineCacheCI.initialDataSize;
+		lastSave = std::chrono::steady_clock::now();
+	}
+
+	/** @brief Save the cache and destroy it, the pipelines created with it stay valid */
+	void PipelineCacheFile::destroy()
+	{
+		if (cache == VK_NULL_HANDLE) {
+			return;
+		}
+		save();
+		vkDestroyPipelineCache(device->logicalDevice, cache, vks::HostAllocator::callbacks());
+		cache = VK_NULL_HANDLE;
+	}
+
+	/**
+	* Write the cache data to the file, if it changed since it was last loaded or saved
+	*
+	* @return True if the file is up to date
+	*/
+	bool PipelineCacheFile::save()
+	{
+		lastSave = std::chrono::steady_clock::now();
+		size_t dataSize = 0;
+		VK_CHECK_RESULT(vkGetPipelineCacheData(device->logicalDevice, cache, &dataSize, nullptr));
+		if (dataSize == savedSize) {
+			return true;
+		}
+		std::vector<uint8_t> data(dataSize);
+		VkResult result = vkGetPipelineCacheData(device->logicalDevice, cache, &dataSize, data.data());
+		// VK_INCOMPLETE if pipelines were added since the size query, what has been written is still a valid cache
+		if ((result != VK_SUCCESS) && (result != VK_INCOMPLETE)) {
+			return false;
+		}
+		FileHeader header = deviceHeader();
+		header.dataSize = dataSize;
+		header.dataHash = hash(data.data(), dataSize);
+
+		const std::string tempFileName = fileName + ".tmp";
+		{
+			std::ofstream file(tempFileName, std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!file.is_open()) {
+				return false;
+			}
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(data.data()), dataSize);
+			if (!file.good()) {
+				file.close();
+				std::remove(tempFileName.c_str());
+				return false;
+			}
+		}
+		// Readers only ever see the old or the new file, never a partially written one
+#if defined(_WIN32)
+		const bool renamed = MoveFileExA(tempFileName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+		const bool renamed = std::rename(tempFileName.c_str(), fileName.c_str()) == 0;
+#endif
+		if (!renamed) {
+			std::remove(tempFileName.c_str());
+			return false;
+		}
+		savedSize = dataSize;
+		return true;
+	}
+
+	/** @brief Save the cache if the save interval has passed, call once per frame */
+	void PipelineCacheFile::update()
+	{
+		if ((cache != VK_NULL_HANDLE) && (std::chrono::steady_clock::now() - lastSave >= saveInterval)) {
+			save();
+		}
+	}
+
+	PipelineCacheFile::FileHeader PipelineCacheFile::deviceHeader() const
+	{
+		FileHeader header{};
+		header.magic = fileMagic;
+		header.version = fileVersion;
+		header.vendorID = device->properties.vendorID;
+		header.deviceID = device->properties.deviceID;
+		header.driverVersion = device->properties.driverVersion;
+		memcpy(header.pipelineCacheUUID, device->properties.pipelineCacheUUID, VK_UUID_SIZE);
+		return header;
+	}
+
+	uint64_t PipelineCacheFile::hash(const uint8_t* data, size_t size)
+	{
+		uint64_t value = 14695981039346656037ull;
+		for (size_t i = 0; i < size; i++) {
+			value = (value ^ data[i]) * 1099511628211ull;
+		}
+		return value;
+	}
+}
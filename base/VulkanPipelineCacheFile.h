@@ -0,0 +1,68 @@
+/*
+* Persistent pipeline cache
+*
+* Pipeline cache that is loaded from and saved to a file, so pipelines compiled by one run are reused by the next
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <chrono>
+#include <string>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanDevice.h"
+
+namespace vks
+{
+	/**
+	* @brief VkPipelineCache backed by a file
+	*
+	* The cache data is stored behind a small header with the vendor and device IDs, driver version, pipeline cache UUID and a
+	* checksum of the data. A file written by another device or driver (or a truncated one) is discarded and the cache starts empty,
+	* as some drivers don't cope with foreign or damaged cache data. Files are written to a temporary file first and renamed over
+	* the previous one, so a crash while saving never leaves a broken cache behind
+	*/
+	class PipelineCacheFile
+	{
+	public:
+		/** @brief The pipeline cache, pass it to all pipeline creation calls */
+		VkPipelineCache cache = VK_NULL_HANDLE;
+		/** @brief True if the cache was created from the file's data (warm start) */
+		bool loaded = false;
+		/** @brief Minimum time between two saves from update() */
+		std::chrono::seconds saveInterval{ 60 };
+
+		void create(vks::VulkanDevice* device, const std::string& fileName);
+		void destroy();
+		bool save();
+		void update();
+
+	private:
+		/** @brief Stored in front of the cache data, all fields have to match the device for the data to be used */
+		struct FileHeader {
+			uint32_t magic;
+			uint32_t version;
+			uint32_t vendorID;
+			uint32_t deviceID;
+			uint32_t driverVersion;
+			uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+			uint64_t dataSize;
+			/** @brief FNV-1a hash of the cache data */
+			uint64_t dataHash;
+		};
+		static const uint32_t fileMagic = 0x43504B56; // "VKPC"
+		static const uint32_t fileVersion = 1;
+
+		vks::VulkanDevice* device = nullptr;
+		std::string fileName;
+		/** @brief Size of the cache data the last time it was loaded or saved, a cache that didn't grow isn't written again */
+		size_t savedSize = 0;
+		std::chrono::steady_clock::time_point lastSave;
+
+		FileHeader deviceHeader() const;
+		static uint64_t hash(const uint8_t* data, size_t size);
+	};
+}
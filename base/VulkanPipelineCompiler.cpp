@@ -0,0 +1,410 @@
+/*
+* Pipeline compiler
+*
+* Compiles graphics pipelines on the job system's worker threads
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanPipelineCompiler.h"
+
+namespace vks
+{
+	namespace
+	{
+		/** @brief Appends the bytes of a value to a key, only for types without padding */
+		template<typename T>
+		void appendKey(std::string& key, const T& value)
+		{
+			key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+		}
+
+		template<typename T>
+		void appendKey(std::string& key, const std::vector<T>& values)
+		{
+			appendKey(key, static_cast<uint64_t>(values.size()));
+			if (!values.empty()) {
+				key.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+			}
+		}
+
+		void appendKey(std::string& key, const VkStencilOpState& state)
+		{
+			appendKey(key, state.failOp);
+			appendKey(key, state.passOp);
+			appendKey(key, state.depthFailOp);
+			appendKey(key, state.compareOp);
+			appendKey(key, state.compareMask);
+			appendKey(key, state.writeMask);
+			appendKey(key, state.reference);
+		}
+
+		template<typename T>
+		std::vector<T> copyArray(const T* values, uint32_t count)
+		{
+			return (values != nullptr) ? std::vector<T>(values, values + count) : std::vector<T>();
+		}
+	}
+
+	/**
+	* Copy a create info
+	*
+	* @param createInfo Description of the pipeline
+	* @param shaders (Optional) Code of each stage by vks::ShaderId, for stages whose module is VK_NULL_HANDLE
+	*/
+	GraphicsPipelineDescription::GraphicsPipelineDescription(const VkGraphicsPipelineCreateInfo& createInfo, const vks::ShaderId* shaders)
+	{
+		pipelineCI = createInfo;
+		pipelineCI.pNext = nullptr;
+		pipelineCI.basePipelineHandle = VK_NULL_HANDLE;
+		pipelineCI.basePipelineIndex = -1;
+		appendKey(stateKey, pipelineCI.flags);
+		appendKey(stateKey, pipelineCI.layout);
+		appendKey(stateKey, pipelineCI.renderPass);
+		appendKey(stateKey, pipelineCI.subpass);
+
+		// Shader stages, reserved up front as the create infos point at the entry point strings and specialization infos
+		stages.assign(createInfo.pStages, createInfo.pStages + createInfo.stageCount);
+		this->shaders.assign(createInfo.stageCount, vks::ShaderId::none);
+		entryPoints.resize(createInfo.stageCount);
+		specializations.resize(createInfo.stageCount);
+		specializationEntries.resize(createInfo.stageCount);
+		specializationData.resize(createInfo.stageCount);
+		for (uint32_t i = 0; i < createInfo.stageCount; i++) {
+			VkPipelineShaderStageCreateInfo& stage = stages[i];
+			stage.pNext = nullptr;
+			entryPoints[i] = stage.pName;
+			stage.pName = entryPoints[i].c_str();
+			if ((shaders != nullptr) && (stage.module == VK_NULL_HANDLE)) {
+				this->shaders[i] = shaders[i];
+			}
+			appendKey(stateKey, stage.flags);
+			appendKey(stateKey, stage.stage);
+			appendKey(stateKey, stage.module);
+			appendKey(stateKey, this->shaders[i]);
+			appendKey(stateKey, static_cast<uint64_t>(entryPoints[i].size()));
+			stateKey.append(entryPoints[i]);
+			if (stage.pSpecializationInfo != nullptr) {
+				const VkSpecializationInfo& specialization = *stage.pSpecializationInfo;
+				specializationEntries[i] = copyArray(specialization.pMapEntries, specialization.mapEntryCount);
+				const uint8_t* data = static_cast<const uint8_t*>(specialization.pData);
+				specializationData[i] = (data != nullptr) ? std::vector<uint8_t>(data, data + specialization.dataSize) : std::vector<uint8_t>();
+				specializations[i] = specialization;
+				specializations[i].pMapEntries = specializationEntries[i].data();
+				specializations[i].pData = specializationData[i].data();
+				stage.pSpecializationInfo = &specializations[i];
+			}
+			for (const VkSpecializationMapEntry& entry : specializationEntries[i]) {
+				appendKey(stateKey, entry.constantID);
+				appendKey(stateKey, entry.offset);
+				appendKey(stateKey, static_cast<uint64_t>(entry.size));
+			}
+			appendKey(stateKey, specializationData[i]);
+		}
+		pipelineCI.pStages = stages.data();
+
+		if (createInfo.pVertexInputState != nullptr) {
+			vertexInputState = *createInfo.pVertexInputState;
+			vertexInputState.pNext = nullptr;
+			vertexBindings = copyArray(vertexInputState.pVertexBindingDescriptions, vertexInputState.vertexBindingDescriptionCount);
+			vertexAttributes = copyArray(vertexInputState.pVertexAttributeDescriptions, vertexInputState.vertexAttributeDescriptionCount);
+			vertexInputState.pVertexBindingDescriptions = vertexBindings.data();
+			vertexInputState.pVertexAttributeDescriptions = vertexAttributes.data();
+			pipelineCI.pVertexInputState = &vertexInputState;
+		}
+		appendKey(stateKey, vertexBindings);
+		appendKey(stateKey, vertexAttributes);
+
+		if (createInfo.pInputAssemblyState != nullptr) {
+			inputAssemblyState = *createInfo.pInputAssemblyState;
+			inputAssemblyState.pNext = nullptr;
+			pipelineCI.pInputAssemblyState = &inputAssemblyState;
+		}
+		appendKey(stateKey, inputAssemblyState.topology);
+		appendKey(stateKey, inputAssemblyState.primitiveRestartEnable);
+
+		if (createInfo.pTessellationState != nullptr) {
+			tessellationState = *createInfo.pTessellationState;
+			tessellationState.pNext = nullptr;
+			pipelineCI.pTessellationState = &tessellationState;
+		}
+		appendKey(stateKey, tessellationState.patchControlPoints);
+
+		if (createInfo.pViewportState != nullptr) {
+			viewportState = *createInfo.pViewportState;
+			viewportState.pNext = nullptr;
+			viewports = copyArray(viewportState.pViewports, viewportState.viewportCount);
+			scissors = copyArray(viewportState.pScissors, viewportState.scissorCount);
+			viewportState.pViewports = viewports.empty() ? nullptr : viewports.data();
+			viewportState.pScissors = scissors.empty() ? nullptr : scissors.data();
+			pipelineCI.pViewportState = &viewportState;
+		}
+		appendKey(stateKey, viewportState.viewportCount);
+		appendKey(stateKey, viewportState.scissorCount);
+		appendKey(stateKey, viewports);
+		appendKey(stateKey, scissors);
+
+		if (createInfo.pRasterizationState != nullptr) {
+			rasterizationState = *createInfo.pRasterizationState;
+			rasterizationState.pNext = nullptr;
+			pipelineCI.pRasterizationState = &rasterizationState;
+		}
+		appendKey(stateKey, rasterizationState.depthClampEnable);
+		appendKey(stateKey, rasterizationState.rasterizerDiscardEnable);
+		appendKey(stateKey, rasterizationState.polygonMode);
+		appendKey(stateKey, rasterizationState.cullMode);
+		appendKey(stateKey, rasterizationState.frontFace);
+		appendKey(stateKey, rasterizationState.depthBiasEnable);
+		appendKey(stateKey, rasterizationState.depthBiasConstantFactor);
+		appendKey(stateKey, rasterizationState.depthBiasClamp);
+		appendKey(stateKey, rasterizationState.depthBiasSlopeFactor);
+		appendKey(stateKey, rasterizationState.lineWidth);
+
+		if (createInfo.pMultisampleState != nullptr) {
+			multisampleState = *createInfo.pMultisampleState;
+			multisampleState.pNext = nullptr;
+			// The mask has a bit per sample, one word per 32 samples
+			sampleMask = copyArray(multisampleState.pSampleMask, (static_cast<uint32_t>(multisampleState.rasterizationSamples) + 31) / 32);
+			multisampleState.pSampleMask = sampleMask.empty() ? nullptr : sampleMask.data();
+			pipelineCI.pMultisampleState = &multisampleState;
+		}
+		appendKey(stateKey, multisampleState.rasterizationSamples);
+		appendKey(stateKey, multisampleState.sampleShadingEnable);
+		appendKey(stateKey, multisampleState.minSampleShading);
+		appendKey(stateKey, sampleMask);
+		appendKey(stateKey, multisampleState.alphaToCoverageEnable);
+		appendKey(stateKey, multisampleState.alphaToOneEnable);
+
+		if (createInfo.pDepthStencilState != nullptr) {
+			depthStencilState = *createInfo.pDepthStencilState;
+			depthStencilState.pNext = nullptr;
+			pipelineCI.pDepthStencilState = &depthStencilState;
+		}
+		appendKey(stateKey, depthStencilState.depthTestEnable);
+		appendKey(stateKey, depthStencilState.depthWriteEnable);
+		appendKey(stateKey, depthStencilState.depthCompareOp);
+		appendKey(stateKey, depthStencilState.depthBoundsTestEnable);
+		appendKey(stateKey, depthStencilState.stencilTestEnable);
+		appendKey(stateKey, depthStencilState.front);
+		appendKey(stateKey, depthStencilState.back);
+		appendKey(stateKey, depthStencilState.minDepthBounds);
+		appendKey(stateKey, depthStencilState.maxDepthBounds);
+
+		if (createInfo.pColorBlendState != nullptr) {
+			colorBlendState = *createInfo.pColorBlendState;
+			colorBlendState.pNext = nullptr;
+			blendAttachments = copyArray(colorBlendState.pAttachments, colorBlendState.attachmentCount);
+			colorBlendState.pAttachments = blendAttachments.data();
+			pipelineCI.pColorBlendState = &colorBlendState;
+		}
+		appendKey(stateKey, colorBlendState.logicOpEnable);
+		appendKey(stateKey, colorBlendState.logicOp);
+		appendKey(stateKey, blendAttachments);
+		appendKey(stateKey, colorBlendState.blendConstants);
+
+		if (createInfo.pDynamicState != nullptr) {
+			dynamicState = *createInfo.pDynamicState;
+			dynamicState.pNext = nullptr;
+			dynamicStates = copyArray(dynamicState.pDynamicStates, dynamicState.dynamicStateCount);
+			dynamicState.pDynamicStates = dynamicStates.data();
+			pipelineCI.pDynamicState = &dynamicState;
+		}
+		appendKey(stateKey, dynamicStates);
+
+#if defined(VK_KHR_dynamic_rendering)
+		for (const VkBaseInStructure* next = static_cast<const VkBaseInStructure*>(createInfo.pNext); next != nullptr; next = next->pNext) {
+			if (next->sType == VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO) {
+				renderingInfo = *reinterpret_cast<const VkPipelineRenderingCreateInfo*>(next);
+				renderingInfo.pNext = nullptr;
+				colorAttachmentFormats = copyArray(renderingInfo.pColorAttachmentFormats, renderingInfo.colorAttachmentCount);
+				renderingInfo.pColorAttachmentFormats = colorAttachmentFormats.data();
+				pipelineCI.pNext = &renderingInfo;
+			}
+		}
+		appendKey(stateKey, renderingInfo.viewMask);
+		appendKey(stateKey, colorAttachmentFormats);
+		appendKey(stateKey, renderingInfo.depthAttachmentFormat);
+		appendKey(stateKey, renderingInfo.stencilAttachmentFormat);
+#endif
+	}
+
+	/**
+	* Prepare a create info that references the shaders by their module identifiers
+	*
+	* @param shaderModules Cache the description's shader modules were loaded from
+	*
+	* @return False if not all stages have an identifier
+	*/
+	bool GraphicsPipelineDescription::useIdentifiers(vks::ShaderModuleCache& shaderModules)
+	{
+		identifierStages.clear();
+		moduleIdentifiers.resize(stages.size());
+		for (size_t i = 0; i < stages.size(); i++) {
+			const vks::ShaderId shader = (shaders[i] != vks::ShaderId::none) ? shaders[i] : shaderModules.find(stages[i].module);
+			if (!shaderModules.identifier(shader, &moduleIdentifiers[i])) {
+				return false;
+			}
+		}
+		moduleIdentifierInfos.resize(stages.size());
+		for (size_t i = 0; i < stages.size(); i++) {
+			moduleIdentifierInfos[i] = {};
+			moduleIdentifierInfos[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_MODULE_IDENTIFIER_CREATE_INFO_EXT;
+			moduleIdentifierInfos[i].identifierSize = moduleIdentifiers[i].size;
+			moduleIdentifierInfos[i].pIdentifier = moduleIdentifiers[i].data;
+		}
+		identifierStages = stages;
+		for (size_t i = 0; i < stages.size(); i++) {
+			identifierStages[i].module = VK_NULL_HANDLE;
+			identifierStages[i].pNext = &moduleIdentifierInfos[i];
+		}
+		identifierPipelineCI = pipelineCI;
+		identifierPipelineCI.pStages = identifierStages.data();
+		// Creation from identifiers only succeeds if the pipeline doesn't have to be compiled
+		identifierPipelineCI.flags |= VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT_EXT;
+		return true;
+	}
+
+	/**
+	* Fill in the modules of the stages that reference their code by id, creating the modules the cache has deferred
+	*
+	* @param shaderModules Cache the ids are from
+	*/
+	void GraphicsPipelineDescription::resolveModules(vks::ShaderModuleCache& shaderModules)
+	{
+		for (size_t i = 0; i < stages.size(); i++) {
+			if (shaders[i] != vks::ShaderId::none) {
+				stages[i].module = shaderModules.module(shaders[i]);
+			}
+		}
+	}
+
+	/**
+	* Set up the compiler
+	*
+	* @param device Device to create the pipelines on
+	* @param pipelineCache Cache all pipelines are compiled against, may be VK_NULL_HANDLE
+	* @param jobSystem Job system the compilations run on, with a single thread pipelines are compiled right away
+	* @param shaderModules (Optional) Cache the shader modules come from, pipelines are first looked up by module identifier if it has identifiers
+	*/
+	void PipelineCompiler::create(VkDevice device, VkPipelineCache pipelineCache, vks::JobSystem* jobSystem, vks::ShaderModuleCache* shaderModules)
+	{
+		this->device = device;
+		this->pipelineCache = pipelineCache;
+		this->jobSystem = jobSystem;
+		this->shaderModules = shaderModules;
+	}
+
+	/** @brief Wait for all compilations and destroy the compiled pipelines, the GPU must be done with them */
+	void PipelineCompiler::destroy()
+	{
+		if (device == VK_NULL_HANDLE) {
+			return;
+		}
+		wait();
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& pipeline : pipelines) {
+			vkDestroyPipeline(device, pipeline.second.get(), vks::HostAllocator::callbacks());
+		}
+		pipelines.clear();
+		device = VK_NULL_HANDLE;
+	}
+
+	/**
+	* Request a graphics pipeline
+	*
+	* @param createInfo Description of the pipeline, copied before the function returns
+	* @param shaders (Optional) Code of each stage by vks::ShaderId, used for the stages whose module is VK_NULL_HANDLE (needs the shader module cache passed to create())
+	*
+	* @return Future for the pipeline, shared by all requests for the same pipeline
+	*/
+	std::shared_future<VkPipeline> PipelineCompiler::compile(const VkGraphicsPipelineCreateInfo& createInfo, const vks::ShaderId* shaders)
+	{
+		assert((shaders == nullptr) || (shaderModules != nullptr));
+		std::shared_ptr<GraphicsPipelineDescription> description = std::make_shared<GraphicsPipelineDescription>(createInfo, shaders);
+		if ((shaderModules != nullptr) && shaderModules->identifiersSupported() && (pipelineCache != VK_NULL_HANDLE)) {
+			description->useIdentifiers(*shaderModules);
+		}
+		std::shared_ptr<std::promise<VkPipeline>> promise;
+		std::shared_future<VkPipeline> pipeline;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto existing = pipelines.find(description->key());
+			if (existing != pipelines.end()) {
+				deduplicatedCount++;
+				return existing->second;
+			}
+			promise = std::make_shared<std::promise<VkPipeline>>();
+			pipeline = promise->get_future().share();
+			pipelines[description->key()] = pipeline;
+		}
+
+		const VkDevice device = this->device;
+		const VkPipelineCache pipelineCache = this->pipelineCache;
+		std::atomic<uint32_t>* compiledCount = &this->compiledCount;
+		std::atomic<uint32_t>* identifierCount = &this->identifierCount;
+		vks::ShaderModuleCache* shaderModules = this->shaderModules;
+		auto job = [device, pipelineCache, description, promise, compiledCount, identifierCount, shaderModules] {
+			VkPipeline handle = VK_NULL_HANDLE;
+			VkResult result = VK_PIPELINE_COMPILE_REQUIRED_EXT;
+			if (description->identifierCreateInfo() != nullptr) {
+				result = vkCreateGraphicsPipelines(device, pipelineCache, 1, description->identifierCreateInfo(), vks::HostAllocator::callbacks(), &handle);
+				if (result == VK_SUCCESS) {
+					identifierCount->fetch_add(1);
+				}
+			}
+			if (result == VK_PIPELINE_COMPILE_REQUIRED_EXT) {
+				// Not in the pipeline cache, the SPIR-V is handed to the driver only now
+				if (shaderModules != nullptr) {
+					description->resolveModules(*shaderModules);
+				}
+				VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &description->createInfo(), vks::HostAllocator::callbacks(), &handle));
+			}
+			else {
+				VK_CHECK_RESULT(result);
+			}
+			compiledCount->fetch_add(1);
+			promise->set_value(handle);
+		};
+		if ((jobSystem != nullptr) && (jobSystem->threadCount() > 1)) {
+			// Only idle workers pick up compilations, a thread waiting on its own jobs (e.g. the main thread recording a frame) never stalls in one
+			jobSystem->runBackground(job, &pending);
+		}
+		else {
+			// Without worker threads nothing would compile the pipeline until someone waits for it
+			job();
+		}
+		return pipeline;
+	}
+
+	/** @brief Wait until all requested pipelines have been compiled, compilations stay on the worker threads */
+	void PipelineCompiler::wait()
+	{
+		if (jobSystem != nullptr) {
+			jobSystem->wait(pending);
+		}
+	}
+
+	/** @brief True if every requested pipeline has been compiled */
+	bool PipelineCompiler::idle()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return compiledCount == pipelines.size();
+	}
+
+	/** @brief True if the pipeline has been compiled */
+	bool PipelineCompiler::ready(const std::shared_future<VkPipeline>& pipeline)
+	{
+		return pipeline.valid() && (pipeline.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+	}
+
+	/**
+	* Get the pipeline to draw with right now
+	*
+	* @param pipeline Future returned by compile()
+	* @param placeholder Returned while the pipeline is still compiling, e.g. a simpler pipeline compiled up front or VK_NULL_HANDLE to skip the draw
+	*/
+	VkPipeline PipelineCompiler::current(const std::shared_future<VkPipeline>& pipeline, VkPipeline placeholder)
+	{
+		return ready(pipeline) ? pipeline.get() : placeholder;
+	}
+}
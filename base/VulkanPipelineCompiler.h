@@ -0,0 +1,135 @@
+/*
+* Pipeline compiler
+*
+* Compiles graphics pipelines on the job system's worker threads
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanJobSystem.h"
+#include "VulkanShaderModuleCache.h"
+
+namespace vks
+{
+	/**
+	* @brief Deep copy of a VkGraphicsPipelineCreateInfo and everything it points to
+	*
+	* Lets a pipeline be compiled after the structures it was described with (usually locals of the function filling them) are gone.
+	* The copy also yields a key that is equal for equal pipeline state, handles (modules, layout, render pass) are compared by value.
+	* Stages may reference their code by vks::ShaderId instead of a module, those modules are resolved with resolveModules() before compiling
+	*
+	* @note Of the pNext chains only VkPipelineRenderingCreateInfo (dynamic rendering) is kept, base pipelines aren't supported
+	*/
+	class GraphicsPipelineDescription
+	{
+	public:
+		explicit GraphicsPipelineDescription(const VkGraphicsPipelineCreateInfo& createInfo, const vks::ShaderId* shaders = nullptr);
+		GraphicsPipelineDescription(const GraphicsPipelineDescription&) = delete;
+		GraphicsPipelineDescription& operator=(const GraphicsPipelineDescription&) = delete;
+
+		/** @brief Create info pointing into this description */
+		const VkGraphicsPipelineCreateInfo& createInfo() const { return pipelineCI; }
+		/** @brief Serialized pipeline state, equal descriptions have equal keys */
+		const std::string& key() const { return stateKey; }
+
+		bool useIdentifiers(vks::ShaderModuleCache& shaderModules);
+		void resolveModules(vks::ShaderModuleCache& shaderModules);
+		/** @brief Create info referencing the shaders by module identifier that fails instead of compiling, null unless useIdentifiers() succeeded */
+		const VkGraphicsPipelineCreateInfo* identifierCreateInfo() const { return identifierStages.empty() ? nullptr : &identifierPipelineCI; }
+
+	private:
+		VkGraphicsPipelineCreateInfo pipelineCI{};
+		std::vector<VkPipelineShaderStageCreateInfo> stages;
+		/** @brief Code of the stages by id, vks::ShaderId::none for stages created with a module */
+		std::vector<vks::ShaderId> shaders;
+		std::vector<std::string> entryPoints;
+		std::vector<VkSpecializationInfo> specializations;
+		std::vector<std::vector<VkSpecializationMapEntry>> specializationEntries;
+		std::vector<std::vector<uint8_t>> specializationData;
+		VkPipelineVertexInputStateCreateInfo vertexInputState{};
+		std::vector<VkVertexInputBindingDescription> vertexBindings;
+		std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState{};
+		VkPipelineTessellationStateCreateInfo tessellationState{};
+		VkPipelineViewportStateCreateInfo viewportState{};
+		std::vector<VkViewport> viewports;
+		std::vector<VkRect2D> scissors;
+		VkPipelineRasterizationStateCreateInfo rasterizationState{};
+		VkPipelineMultisampleStateCreateInfo multisampleState{};
+		std::vector<VkSampleMask> sampleMask;
+		VkPipelineDepthStencilStateCreateInfo depthStencilState{};
+		VkPipelineColorBlendStateCreateInfo colorBlendState{};
+		std::vector<VkPipelineColorBlendAttachmentState> blendAttachments;
+		VkPipelineDynamicStateCreateInfo dynamicState{};
+		std::vector<VkDynamicState> dynamicStates;
+#if defined(VK_KHR_dynamic_rendering)
+		VkPipelineRenderingCreateInfo renderingInfo{};
+		std::vector<VkFormat> colorAttachmentFormats;
+#endif
+		std::string stateKey;
+		VkGraphicsPipelineCreateInfo identifierPipelineCI{};
+		std::vector<VkPipelineShaderStageCreateInfo> identifierStages;
+		std::vector<VkPipelineShaderStageModuleIdentifierCreateInfoEXT> moduleIdentifierInfos;
+		std::vector<vks::ShaderModuleCache::Identifier> moduleIdentifiers;
+	};
+
+	/**
+	* @brief Compiles graphics pipelines on worker threads against a shared pipeline cache
+	*
+	* compile() copies the create info, queues the compilation on the job system and returns a future for the pipeline.
+	* Requests for a pipeline that has already been requested (same state, shaders, layout and render pass) return the first
+	* request's future instead of compiling again. Renderers that can't wait draw with a placeholder (or skip the draw) until
+	* the pipeline is ready, see current()
+	*
+	* The compiler owns the pipelines, they are destroyed with it
+	*
+	* If the shaders come from a vks::ShaderModuleCache with identifiers, the pipeline is first looked up in the pipeline cache by
+	* module identifier (VK_EXT_shader_module_identifier), so the driver doesn't have to process the SPIR-V for pipelines it has seen before.
+	* Shaders passed by vks::ShaderId may not have a module yet, it's only created if that lookup misses and the pipeline has to be compiled
+	*
+	* @note Shader modules, layouts and render passes referenced by a request have to stay alive until its pipeline is ready (or wait() returned)
+	* @note Compilations run in the job system's background queue, they are only picked up by worker threads with nothing else to do
+	*/
+	class PipelineCompiler
+	{
+	public:
+		void create(VkDevice device, VkPipelineCache pipelineCache, vks::JobSystem* jobSystem, vks::ShaderModuleCache* shaderModules = nullptr);
+		void destroy();
+
+		std::shared_future<VkPipeline> compile(const VkGraphicsPipelineCreateInfo& createInfo, const vks::ShaderId* shaders = nullptr);
+		void wait();
+		bool idle();
+
+		static bool ready(const std::shared_future<VkPipeline>& pipeline);
+		static VkPipeline current(const std::shared_future<VkPipeline>& pipeline, VkPipeline placeholder = VK_NULL_HANDLE);
+
+		/** @brief Number of pipelines created, compiled or from identifiers */
+		std::atomic<uint32_t> compiledCount{ 0 };
+		/** @brief Number of requests answered with an already requested pipeline */
+		std::atomic<uint32_t> deduplicatedCount{ 0 };
+		/** @brief Number of pipelines created from shader module identifiers without compiling */
+		std::atomic<uint32_t> identifierCount{ 0 };
+
+	private:
+		VkDevice device = VK_NULL_HANDLE;
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+		vks::JobSystem* jobSystem = nullptr;
+		vks::ShaderModuleCache* shaderModules = nullptr;
+		std::mutex mutex;
+		/** @brief Pipelines by the key of their description */
+		std::unordered_map<std::string, std::shared_future<VkPipeline>> pipelines;
+		vks::JobSystem::Counter pending;
+	};
+}
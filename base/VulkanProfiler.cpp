@@ -0,0 +1,172 @@
+/*
+* GPU profiler
+*
+* Per-pass GPU timings from timestamp queries, read back once the frame has finished instead of stalling on the results
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanProfiler.h"
+
+namespace vks
+{
+	GpuProfiler::Scope::Scope(GpuProfiler& profiler, VkCommandBuffer commandBuffer, const std::string& name, glm::vec4 color) : profiler(profiler), commandBuffer(commandBuffer)
+	{
+		scope = profiler.begin(commandBuffer, name, color);
+	}
+
+	GpuProfiler::Scope::~Scope()
+	{
+		profiler.end(commandBuffer, scope);
+	}
+
+	/**
+	* Create the timestamp query pool
+	*
+	* @param device Device the queries are executed on
+	* @param queueFamilyIndex Queue family the profiled command buffers are submitted to
+	* @param frameCount Number of frames in flight, each one gets its own range of queries
+	* @param maxScopes (Optional) Maximum number of scopes per frame
+	*
+	* @note If the queue family doesn't support timestamps, scopes only emit debug labels
+	*/
+	void GpuProfiler::create(vks::VulkanDevice* device, uint32_t queueFamilyIndex, uint32_t frameCount, uint32_t maxScopes)
+	{
+		this->device = device->logicalDevice;
+		this->maxScopes = maxScopes;
+		frames.clear();
+		frames.resize(frameCount);
+		for (auto& frame : frames) {
+			frame.names.resize(maxScopes);
+		}
+		currentFrame = 0;
+		passTimes.clear();
+
+		const uint32_t validBits = device->queueFamilyProperties[queueFamilyIndex].timestampValidBits;
+		if (validBits == 0) {
+			return;
+		}
+		timestampMask = (validBits >= 64) ? UINT64_MAX : ((1ull << validBits) - 1);
+		timestampPeriod = device->properties.limits.timestampPeriod;
+		timestamps.resize(maxScopes * 2);
+
+		// Two queries (begin and end) per scope
+		VkQueryPoolCreateInfo queryPoolCI{};
+		queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolCI.queryCount = frameCount * maxScopes * 2;
+		VK_CHECK_RESULT(vkCreateQueryPool(this->device, &queryPoolCI, vks::HostAllocator::callbacks(), &queryPool));
+	}
+
+	void GpuProfiler::destroy()
+	{
+		if (queryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device, queryPool, vks::HostAllocator::callbacks());
+			queryPool = VK_NULL_HANDLE;
+		}
+		frames.clear();
+		passTimes.clear();
+	}
+
+	/**
+	* Read back the timings of the frame that was previously recorded into a frame ring slot and make the slot current
+	*
+	* @param frameIndex Frame ring slot, the GPU must be done with its previous submission (see vks::FrameRing::wait)
+	*
+	* @return True if new results are available
+	*/
+	bool GpuProfiler::collect(uint32_t frameIndex)
+	{
+		currentFrame = frameIndex;
+		if (frames.empty()) {
+			return false;
+		}
+		FrameScopes& frame = frames[frameIndex];
+		const uint32_t scopeCount = frame.count;
+		frame.count = 0;
+		if ((queryPool == VK_NULL_HANDLE) || (scopeCount == 0)) {
+			return false;
+		}
+		// No VK_QUERY_RESULT_WAIT_BIT, the frame has already finished so the results are available
+		VkResult result = vkGetQueryPoolResults(device, queryPool, frameIndex * maxScopes * 2, scopeCount * 2, scopeCount * 2 * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+		if (result == VK_NOT_READY) {
+			return false;
+		}
+		VK_CHECK_RESULT(result);
+		passTimes.resize(scopeCount);
+		for (uint32_t i = 0; i < scopeCount; i++) {
+			const uint64_t ticks = (timestamps[i * 2 + 1] - timestamps[i * 2]) & timestampMask;
+			passTimes[i].name = frame.names[i];
+			passTimes[i].milliseconds = static_cast<double>(ticks) * timestampPeriod / 1000000.0;
+		}
+		return true;
+	}
+
+	/**
+	* Reset the current frame's queries
+	*
+	* @param commandBuffer First command buffer of the frame, must be called before any scope is recorded and outside of a render pass
+	*/
+	void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer)
+	{
+		if (queryPool != VK_NULL_HANDLE) {
+			vkCmdResetQueryPool(commandBuffer, queryPool, currentFrame * maxScopes * 2, maxScopes * 2);
+		}
+	}
+
+	/**
+	* Begin a scope, writes a timestamp and opens a debug label of the same name
+	*
+	* @param commandBuffer Command buffer to record into
+	* @param name Name of the scope in the results and in debugging tools
+	* @param color (Optional) Color of the debug label
+	*
+	* @note Not thread safe, scopes are meant to be recorded into the primary command buffer
+	*
+	* @return Handle of the scope to pass to end()
+	*/
+	uint32_t GpuProfiler::begin(VkCommandBuffer commandBuffer, const std::string& name, glm::vec4 color)
+	{
+		vks::debugutils::cmdBeginLabel(commandBuffer, name, color);
+		if ((queryPool == VK_NULL_HANDLE) || frames.empty()) {
+			return UINT32_MAX;
+		}
+		FrameScopes& frame = frames[currentFrame];
+		if (frame.count >= maxScopes) {
+			return UINT32_MAX;
+		}
+		const uint32_t scope = frame.count++;
+		frame.names[scope] = name;
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, (currentFrame * maxScopes + scope) * 2);
+		return scope;
+	}
+
+	/** @brief End a scope, writes a timestamp once all previous work has finished and closes the debug label */
+	void GpuProfiler::end(VkCommandBuffer commandBuffer, uint32_t scope)
+	{
+		if (scope != UINT32_MAX) {
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, (currentFrame * maxScopes + scope) * 2 + 1);
+		}
+		vks::debugutils::cmdEndLabel(commandBuffer);
+	}
+
+	/** @brief GPU times of the scopes of the last frame read back, in the order they were begun */
+	const std::vector<GpuProfiler::PassTime>& GpuProfiler::results() const
+	{
+		return passTimes;
+	}
+
+	/** @brief Returns false if the queue family doesn't support timestamps */
+	bool GpuProfiler::supported() const
+	{
+		return queryPool != VK_NULL_HANDLE;
+	}
+
+	/** @brief Add the latest pass timings to the UI overlay */
+	void GpuProfiler::drawUI(vks::UIOverlay* overlay) const
+	{
+		for (auto& passTime : passTimes) {
+			overlay->text("%s: %.3f ms (GPU)", passTime.name.c_str(), passTime.milliseconds);
+		}
+	}
+}
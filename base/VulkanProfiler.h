@@ -0,0 +1,80 @@
+/*
+* GPU profiler
+*
+* Per-pass GPU timings from timestamp queries, read back once the frame has finished instead of stalling on the results
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanDebug.h"
+#include "VulkanDevice.h"
+#include "VulkanUIOverlay.h"
+
+namespace vks
+{
+	/**
+	* @brief Measures the GPU time of scopes (passes) recorded into a frame's command buffers
+	*
+	* Every frame in flight owns a range of timestamp queries. The results of a frame are read when its slot comes around again,
+	* at which point the frame ring has already waited for it, so reading never blocks
+	*/
+	class GpuProfiler
+	{
+	public:
+		/** @brief GPU time of a single scope */
+		struct PassTime {
+			std::string name;
+			double milliseconds;
+		};
+
+		/** @brief Records a scope for the lifetime of the object */
+		class Scope
+		{
+		public:
+			Scope(GpuProfiler& profiler, VkCommandBuffer commandBuffer, const std::string& name, glm::vec4 color = glm::vec4(1.0f));
+			~Scope();
+		private:
+			GpuProfiler& profiler;
+			VkCommandBuffer commandBuffer;
+			uint32_t scope;
+		};
+
+		/** @brief Maximum number of scopes per frame */
+		uint32_t maxScopes = 0;
+
+		void create(vks::VulkanDevice* device, uint32_t queueFamilyIndex, uint32_t frameCount, uint32_t maxScopes = 32);
+		void destroy();
+
+		bool collect(uint32_t frameIndex);
+		void beginFrame(VkCommandBuffer commandBuffer);
+		uint32_t begin(VkCommandBuffer commandBuffer, const std::string& name, glm::vec4 color = glm::vec4(1.0f));
+		void end(VkCommandBuffer commandBuffer, uint32_t scope);
+
+		const std::vector<PassTime>& results() const;
+		bool supported() const;
+		void drawUI(vks::UIOverlay* overlay) const;
+
+	private:
+		struct FrameScopes {
+			std::vector<std::string> names;
+			uint32_t count = 0;
+		};
+		VkDevice device = VK_NULL_HANDLE;
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		/** @brief Nanoseconds per timestamp tick */
+		double timestampPeriod = 1.0;
+		/** @brief Mask of the valid timestamp bits, differences are taken modulo this */
+		uint64_t timestampMask = 0;
+		std::vector<FrameScopes> frames;
+		uint32_t currentFrame = 0;
+		std::vector<uint64_t> timestamps;
+		std::vector<PassTime> passTimes;
+	};
+}
@@ -0,0 +1,375 @@
+/*
+* Shader module cache
+*
+* Shares shader modules between all loads of the same SPIR-V code
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanShaderModuleCache.h"
+#include "VulkanMappedFile.h"
+#include "VulkanEmbeddedShaders.h"
+
+#include <cstdio>
+#include <fstream>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+namespace vks
+{
+	/** @brief Set up the cache, modules are created on the given device */
+	void ShaderModuleCache::create(vks::VulkanDevice* device)
+	{
+		this->device = device;
+	}
+
+	/** @brief Save new identifiers and destroy all modules, pipelines created from them stay valid */
+	void ShaderModuleCache::destroy()
+	{
+		saveIdentifiers();
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& entry : entries) {
+			if (entry->module != VK_NULL_HANDLE) {
+				vkDestroyShaderModule(device->logicalDevice, entry->module, vks::HostAllocator::callbacks());
+			}
+		}
+		entries.clear();
+		modules.clear();
+		ids.clear();
+		handles.clear();
+		storedIdentifiers.clear();
+		identifierFileName.clear();
+	}
+
+	/**
+	* Load the identifiers stored by a previous run, code with a stored identifier is loaded without creating a module
+	*
+	* @param fileName File the identifiers are loaded from and saved to (e.g. next to the pipeline cache file)
+	*
+	* @note Call before loading modules, identifiers are only used if VK_EXT_shader_module_identifier is enabled and were stored with the same algorithm UUID
+	*/
+	void ShaderModuleCache::loadIdentifiers(const std::string& fileName)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		identifierFileName = fileName;
+		storedIdentifiers.clear();
+		identifiersChanged = false;
+		if (!identifiersSupported()) {
+			return;
+		}
+		vks::MappedFile file;
+		if (!file.open(fileName) || (file.size() < sizeof(IdentifierFileHeader))) {
+			return;
+		}
+		IdentifierFileHeader header;
+		memcpy(&header, file.data(), sizeof(IdentifierFileHeader));
+		if ((header.magic != identifierFileMagic) || (header.version != identifierFileVersion) || (file.size() < sizeof(IdentifierFileHeader) + header.count * sizeof(IdentifierFileEntry))) {
+			return;
+		}
+		// Identifiers of another algorithm (e.g. after a driver update) would never match, they are dropped and stored again for the new one
+		if (memcmp(header.algorithmUUID, device->shaderModuleIdentifier.algorithmUUID, VK_UUID_SIZE) != 0) {
+			identifiersChanged = true;
+			return;
+		}
+		for (uint32_t i = 0; i < header.count; i++) {
+			IdentifierFileEntry entry;
+			memcpy(&entry, file.data() + sizeof(IdentifierFileHeader) + i * sizeof(IdentifierFileEntry), sizeof(IdentifierFileEntry));
+			if ((entry.identifier.size > 0) && (entry.identifier.size <= VK_MAX_SHADER_MODULE_IDENTIFIER_SIZE_EXT)) {
+				storedIdentifiers[entry.hash] = { entry.size, entry.identifier };
+			}
+		}
+	}
+
+	/**
+	* Write the identifiers to the file passed to loadIdentifiers(), if identifiers were added since
+	*
+	* @return True if the file is up to date
+	*/
+	bool ShaderModuleCache::saveIdentifiers()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (identifierFileName.empty() || !identifiersChanged) {
+			return true;
+		}
+		IdentifierFileHeader header{};
+		header.magic = identifierFileMagic;
+		header.version = identifierFileVersion;
+		memcpy(header.algorithmUUID, device->shaderModuleIdentifier.algorithmUUID, VK_UUID_SIZE);
+		header.count = static_cast<uint32_t>(storedIdentifiers.size());
+
+		const std::string tempFileName = identifierFileName + ".tmp";
+		{
+			std::ofstream file(tempFileName, std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!file.is_open()) {
+				return false;
+			}
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			for (const auto& stored : storedIdentifiers) {
+				IdentifierFileEntry entry{};
+				entry.hash = stored.first;
+				entry.size = stored.second.size;
+				entry.identifier = stored.second.identifier;
+				file.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+			}
+			if (!file.good()) {
+				file.close();
+				std::remove(tempFileName.c_str());
+				return false;
+			}
+		}
+		// Readers only ever see the old or the new file, never a partially written one
+#if defined(_WIN32)
+		const bool renamed = MoveFileExA(tempFileName.c_str(), identifierFileName.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+		const bool renamed = std::rename(tempFileName.c_str(), identifierFileName.c_str()) == 0;
+#endif
+		if (!renamed) {
+			std::remove(tempFileName.c_str());
+			return false;
+		}
+		identifiersChanged = false;
+		return true;
+	}
+
+#if defined(__ANDROID__)
+	/**
+	* Load a shader module from an asset, or from the executable if it has been embedded
+	*
+	* @param assetManager Asset manager of the apk
+	* @param fileName Path of the SPIR-V asset
+	*
+	* @return Module shared by all loads of the same code, VK_NULL_HANDLE if the asset couldn't be read
+	*/
+	VkShaderModule ShaderModuleCache::load(AAssetManager* assetManager, const std::string& fileName)
+	{
+		return module(loadCode(assetManager, fileName, false));
+	}
+
+	/**
+	* Load SPIR-V code from an asset without creating its module if it has a stored identifier, see createDeferred()
+	*
+	* @param assetManager Asset manager of the apk
+	* @param fileName Path of the SPIR-V asset
+	*
+	* @return Id shared by all loads of the same code, vks::ShaderId::none if the asset couldn't be read
+	*/
+	vks::ShaderId ShaderModuleCache::loadDeferred(AAssetManager* assetManager, const std::string& fileName)
+	{
+		return loadCode(assetManager, fileName, true);
+	}
+
+	vks::ShaderId ShaderModuleCache::loadCode(AAssetManager* assetManager, const std::string& fileName, bool deferred)
+	{
+		// Shaders embedded at build time don't touch the apk at all
+		const vks::EmbeddedShader* embedded = vks::findEmbeddedShader(fileName);
+		if (embedded) {
+			return add(embedded->code, embedded->size, deferred);
+		}
+		// Assets are compressed, so they are read instead of mapped
+		AAsset* asset = AAssetManager_open(assetManager, fileName.c_str(), AASSET_MODE_STREAMING);
+		if (!asset) {
+			LOGE("Could not open shader asset \"%s\"", fileName.c_str());
+			return vks::ShaderId::none;
+		}
+		const size_t size = AAsset_getLength(asset);
+		std::vector<uint32_t> code((size + 3) / 4);
+		AAsset_read(asset, code.data(), size);
+		AAsset_close(asset);
+		return add(code.data(), size, deferred);
+	}
+#else
+	/**
+	* Load a shader module from a SPIR-V file, or from the executable if it has been embedded
+	*
+	* @param fileName Path of the SPIR-V file
+	*
+	* @return Module shared by all loads of the same code, VK_NULL_HANDLE if the file couldn't be opened
+	*/
+	VkShaderModule ShaderModuleCache::load(const std::string& fileName)
+	{
+		return module(loadCode(fileName, false));
+	}
+
+	/**
+	* Load SPIR-V code from a file without creating its module if it has a stored identifier, see createDeferred()
+	*
+	* @param fileName Path of the SPIR-V file
+	*
+	* @return Id shared by all loads of the same code, vks::ShaderId::none if the file couldn't be opened
+	*/
+	vks::ShaderId ShaderModuleCache::loadDeferred(const std::string& fileName)
+	{
+		return loadCode(fileName, true);
+	}
+
+	vks::ShaderId ShaderModuleCache::loadCode(const std::string& fileName, bool deferred)
+	{
+		// Shaders embedded at build time don't touch the disk at all
+		const vks::EmbeddedShader* embedded = vks::findEmbeddedShader(fileName);
+		if (embedded) {
+			return add(embedded->code, embedded->size, deferred);
+		}
+		// The mapping is page aligned, so the code is hashed and passed to the driver straight from the page cache
+		vks::MappedFile file(fileName);
+		if (!file.isOpen()) {
+			std::cerr << "Error: Could not open shader file \"" << fileName << "\"" << "\n";
+			return vks::ShaderId::none;
+		}
+		return add(reinterpret_cast<const uint32_t*>(file.data()), file.size(), deferred);
+	}
+#endif
+
+	/**
+	* Get the module for the given SPIR-V code, creating it if the code hasn't been seen before
+	*
+	* @param code SPIR-V code, 4 byte aligned
+	* @param size Size of the code in bytes
+	*
+	* @return Module shared by all loads of the same code
+	*/
+	VkShaderModule ShaderModuleCache::create(const uint32_t* code, size_t size)
+	{
+		return module(add(code, size, false));
+	}
+
+	/**
+	* Add SPIR-V code to the cache, its module is only created once it's needed if the code has a stored identifier
+	*
+	* @param code SPIR-V code, 4 byte aligned
+	* @param size Size of the code in bytes
+	*
+	* @return Id shared by all loads of the same code, to be passed to vks::PipelineCompiler or resolved with module()
+	*/
+	vks::ShaderId ShaderModuleCache::createDeferred(const uint32_t* code, size_t size)
+	{
+		return add(code, size, true);
+	}
+
+	vks::ShaderId ShaderModuleCache::add(const uint32_t* code, size_t size, bool deferred)
+	{
+		const uint64_t codeHash = hash(code, size);
+		std::lock_guard<std::mutex> lock(mutex);
+		bool collision = false;
+		auto range = modules.equal_range(codeHash);
+		for (auto it = range.first; it != range.second; ++it) {
+			const Module& existing = *it->second;
+			if ((existing.size == size) && (memcmp(existing.code.data(), code, size) == 0)) {
+				sharedCount++;
+				return existing.id;
+			}
+			collision = collision || (existing.size == size);
+		}
+
+		std::unique_ptr<Module> entry(new Module());
+		entry->hash = codeHash;
+		entry->size = size;
+		entry->code.assign(code, code + (size + 3) / 4);
+		// Ids are the hash of the code, different code with the same hash gets the next free value
+		uint64_t id = codeHash;
+		while ((id == static_cast<uint64_t>(vks::ShaderId::none)) || (ids.find(id) != ids.end())) {
+			id = (id ^ 0x9E3779B97F4A7C15ull) * 1099511628211ull;
+		}
+		entry->id = static_cast<vks::ShaderId>(id);
+		// The stored identifier can't tell apart different code with the same hash and size, that code always gets its own module
+		auto stored = storedIdentifiers.find(codeHash);
+		if (deferred && identifiersSupported() && !collision && (stored != storedIdentifiers.end()) && (stored->second.size == size)) {
+			entry->identifier = stored->second.identifier;
+			deferredCount++;
+		}
+		else {
+			createModule(*entry);
+		}
+		ids[id] = entry.get();
+		modules.insert(std::make_pair(codeHash, entry.get()));
+		entries.push_back(std::move(entry));
+		return entries.back()->id;
+	}
+
+	/** @brief Create the module of an entry and query its identifier, needs the cache's lock */
+	void ShaderModuleCache::createModule(Module& entry)
+	{
+		VkShaderModuleCreateInfo moduleCreateInfo{};
+		moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleCreateInfo.codeSize = entry.size;
+		moduleCreateInfo.pCode = entry.code.data();
+		VK_CHECK_RESULT(vkCreateShaderModule(device->logicalDevice, &moduleCreateInfo, vks::HostAllocator::callbacks(), &entry.module));
+		handles[entry.module] = &entry;
+		moduleCount++;
+		if (!identifiersSupported()) {
+			return;
+		}
+		VkShaderModuleIdentifierEXT identifierEXT{};
+		identifierEXT.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_IDENTIFIER_EXT;
+		device->shaderModuleIdentifier.getShaderModuleIdentifier(device->logicalDevice, entry.module, &identifierEXT);
+		entry.identifier.size = std::min<uint32_t>(identifierEXT.identifierSize, VK_MAX_SHADER_MODULE_IDENTIFIER_SIZE_EXT);
+		memcpy(entry.identifier.data, identifierEXT.identifier, entry.identifier.size);
+		// Stored for the next run, unless another code with the same hash has been stored already
+		auto stored = storedIdentifiers.find(entry.hash);
+		if ((entry.identifier.size > 0) && ((stored == storedIdentifiers.end()) || (stored->second.size == entry.size))) {
+			const bool changed = (stored == storedIdentifiers.end()) || (stored->second.identifier.size != entry.identifier.size) || (memcmp(stored->second.identifier.data, entry.identifier.data, entry.identifier.size) != 0);
+			if (changed) {
+				storedIdentifiers[entry.hash] = { entry.size, entry.identifier };
+				identifiersChanged = true;
+			}
+		}
+	}
+
+	/**
+	* Get the module of the code with the given id, creating it from the kept code if its creation was deferred
+	*
+	* @param id Id returned by loadDeferred() or createDeferred()
+	*
+	* @return Module that can be passed to Vulkan, VK_NULL_HANDLE if the id isn't from this cache
+	*/
+	VkShaderModule ShaderModuleCache::module(vks::ShaderId id)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto cached = ids.find(static_cast<uint64_t>(id));
+		if (cached == ids.end()) {
+			return VK_NULL_HANDLE;
+		}
+		Module& entry = *cached->second;
+		if (entry.module == VK_NULL_HANDLE) {
+			createModule(entry);
+		}
+		return entry.module;
+	}
+
+	/** @brief Id of the code a module returned by load() or create() was created from, vks::ShaderId::none if the module isn't from this cache */
+	vks::ShaderId ShaderModuleCache::find(VkShaderModule module)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto cached = handles.find(module);
+		return (cached != handles.end()) ? cached->second->id : vks::ShaderId::none;
+	}
+
+	/**
+	* Get the identifier of a module from the cache
+	*
+	* @param id Id of the module's code, see find() for modules returned by load() or create()
+	*
+	* @return False if the module has no identifier (the extension isn't enabled or the id isn't from this cache)
+	*/
+	bool ShaderModuleCache::identifier(vks::ShaderId id, Identifier* identifier)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto cached = ids.find(static_cast<uint64_t>(id));
+		if ((cached == ids.end()) || (cached->second->identifier.size == 0)) {
+			return false;
+		}
+		*identifier = cached->second->identifier;
+		return true;
+	}
+
+	uint64_t ShaderModuleCache::hash(const uint32_t* code, size_t size)
+	{
+		// SPIR-V is a stream of words
+		uint64_t value = 14695981039346656037ull;
+		for (size_t i = 0; i < size / sizeof(uint32_t); i++) {
+			value = (value ^ code[i]) * 1099511628211ull;
+		}
+		return value;
+	}
+}
@@ -0,0 +1,140 @@
+/*
+* Shader module cache
+*
+* Shares shader modules between all loads of the same SPIR-V code
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanDevice.h"
+
+namespace vks
+{
+	/**
+	* @brief Opaque reference to SPIR-V code in a vks::ShaderModuleCache, not a Vulkan handle
+	*
+	* Derived from the hash of the code, so loads of the same code get the same id. Different code whose hashes collide gets distinct ids
+	*/
+	enum class ShaderId : uint64_t { none = 0 };
+
+	/**
+	* @brief Shader modules by the hash of their SPIR-V code
+	*
+	* Shaders embedded at build time are taken from the executable, files are memory mapped. Loading code that has been loaded before
+	* (from the same or another file) returns the module created by the first load. The cache keeps a copy of the code of every module to
+	* tell apart different code with the same hash. The cache owns the modules, they are destroyed with it
+	*
+	* With VK_EXT_shader_module_identifier enabled the identifier of every module is queried once and stored by the hash of its code
+	* in an identifier file (see loadIdentifiers()). load() and create() always return a module. loadDeferred() and createDeferred()
+	* return a vks::ShaderId instead, code with a stored identifier doesn't get a module then. Pipelines are looked up by the identifier
+	* in the pipeline cache (see vks::PipelineCompiler), the module is only created from the kept code if a pipeline has to be compiled
+	* after all, or if it's asked for with module()
+	*
+	* @note Stored identifiers are matched by the hash and size of the code
+	*/
+	class ShaderModuleCache
+	{
+	public:
+		/** @brief Shader module identifier as reported by the driver, size is zero if there is none */
+		struct Identifier {
+			uint32_t size = 0;
+			uint8_t data[VK_MAX_SHADER_MODULE_IDENTIFIER_SIZE_EXT];
+		};
+
+		void create(vks::VulkanDevice* device);
+		void destroy();
+
+		void loadIdentifiers(const std::string& fileName);
+		bool saveIdentifiers();
+
+#if defined(__ANDROID__)
+		VkShaderModule load(AAssetManager* assetManager, const std::string& fileName);
+		vks::ShaderId loadDeferred(AAssetManager* assetManager, const std::string& fileName);
+#else
+		VkShaderModule load(const std::string& fileName);
+		vks::ShaderId loadDeferred(const std::string& fileName);
+#endif
+		VkShaderModule create(const uint32_t* code, size_t size);
+		vks::ShaderId createDeferred(const uint32_t* code, size_t size);
+		VkShaderModule module(vks::ShaderId id);
+		vks::ShaderId find(VkShaderModule module);
+
+		bool identifier(vks::ShaderId id, Identifier* identifier);
+		/** @brief True if modules have identifiers (VK_EXT_shader_module_identifier has been enabled) */
+		bool identifiersSupported() const { return (device != nullptr) && (device->shaderModuleIdentifier.getShaderModuleIdentifier != nullptr); }
+
+		/** @brief Number of modules created */
+		std::atomic<uint32_t> moduleCount{ 0 };
+		/** @brief Number of loads answered with an existing module */
+		std::atomic<uint32_t> sharedCount{ 0 };
+		/** @brief Number of modules whose creation was skipped at load time as they had a stored identifier */
+		std::atomic<uint32_t> deferredCount{ 0 };
+
+	private:
+		struct Module {
+			uint64_t hash = 0;
+			vks::ShaderId id = vks::ShaderId::none;
+			std::vector<uint32_t> code;
+			size_t size = 0;
+			/** @brief VK_NULL_HANDLE until the module has been created */
+			VkShaderModule module = VK_NULL_HANDLE;
+			Identifier identifier;
+		};
+		/** @brief Identifier as stored in the identifier file */
+		struct StoredIdentifier {
+			uint64_t size;
+			Identifier identifier;
+		};
+		/** @brief Stored in front of the identifiers, the algorithm UUID has to match the device for them to be used */
+		struct IdentifierFileHeader {
+			uint32_t magic;
+			uint32_t version;
+			uint8_t algorithmUUID[VK_UUID_SIZE];
+			uint32_t count;
+			uint32_t reserved;
+		};
+		/** @brief Entry of the identifier file, for the code with the given hash and size */
+		struct IdentifierFileEntry {
+			uint64_t hash;
+			uint64_t size;
+			Identifier identifier;
+		};
+		static const uint32_t identifierFileMagic = 0x49534B56; // "VKSI"
+		static const uint32_t identifierFileVersion = 1;
+
+		vks::VulkanDevice* device = nullptr;
+		std::mutex mutex;
+		std::vector<std::unique_ptr<Module>> entries;
+		/** @brief Modules by the hash of their code, different code with the same hash gets an entry of its own */
+		std::unordered_multimap<uint64_t, Module*> modules;
+		/** @brief Modules by their id */
+		std::unordered_map<uint64_t, Module*> ids;
+		/** @brief Modules by their handle, only those that have been created */
+		std::unordered_map<VkShaderModule, Module*> handles;
+		/** @brief Identifiers by the hash of the code, loaded from and saved to identifierFileName */
+		std::unordered_map<uint64_t, StoredIdentifier> storedIdentifiers;
+		std::string identifierFileName;
+		/** @brief True if identifiers were added since the file was loaded */
+		bool identifiersChanged = false;
+
+#if defined(__ANDROID__)
+		vks::ShaderId loadCode(AAssetManager* assetManager, const std::string& fileName, bool deferred);
+#else
+		vks::ShaderId loadCode(const std::string& fileName, bool deferred);
+#endif
+		vks::ShaderId add(const uint32_t* code, size_t size, bool deferred);
+		void createModule(Module& entry);
+		static uint64_t hash(const uint32_t* code, size_t size);
+	};
+}
@@ -0,0 +1,365 @@
+/*
+* Staging ring
+*
+* Persistently mapped ring of host visible memory that all uploads to device local resources go through
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanStagingRing.h"
+#include "VulkanDevice.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace vks
+{
+	const VkDeviceSize StagingRing::defaultCapacity;
+
+	/**
+	* Create the ring buffer and the command pool for the copy batches
+	*
+	* @param device Device to create the ring on
+	* @param queue Queue the copy batches are submitted to, its timeline tracks when ring space can be reused
+	* @param queueFamilyIndex Family of the queue
+	* @param capacity (Optional) Size of the ring, the largest single upload it can take
+	*/
+	void StagingRing::create(vks::VulkanDevice* device, VkQueue queue, uint32_t queueFamilyIndex, VkDeviceSize capacity)
+	{
+		this->device = device->logicalDevice;
+		this->queue = queue;
+		this->capacity = capacity;
+		this->queueFamilyIndex = queueFamilyIndex;
+		timeline = device->getTimeline(queue);
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&buffer,
+			capacity,
+			nullptr,
+			vks::MemoryTag::Staging));
+		// Stays mapped for the lifetime of the ring
+		VK_CHECK_RESULT(buffer.map());
+		commandPool = device->createCommandPool(queueFamilyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+		head = 0;
+		tail = 0;
+		finishedEnd = 0;
+		lastValue = 0;
+	}
+
+	/** @brief Submit pending copies, wait for all batches and release the ring */
+	void StagingRing::destroy()
+	{
+		if (buffer.buffer == VK_NULL_HANDLE) {
+			return;
+		}
+		wait(flush());
+		recycle(false);
+		vkDestroyCommandPool(device, commandPool, vks::HostAllocator::callbacks());
+		commandPool = VK_NULL_HANDLE;
+		freeCommandBuffers.clear();
+		buffer.unmap();
+		buffer.destroy();
+		buffer = vks::Buffer();
+		capacity = 0;
+	}
+
+	/** @brief Release the ring space of finished batches, if block is set wait for the oldest batch first */
+	void StagingRing::recycle(bool block)
+	{
+		if (block && !batches.empty()) {
+			VK_CHECK_RESULT(timeline->wait(batches.front().timelineValue));
+		}
+		// Every batch is checked, neither their ring space nor their completion follows submission order (a hold may be submitted after a batch with later regions)
+		for (auto batch = batches.begin(); batch != batches.end();) {
+			if (timeline->reached(batch->timelineValue)) {
+				finishedEnd = std::max(finishedEnd, batch->end);
+				freeCommandBuffers.push_back(batch->commandBuffer);
+				batch = batches.erase(batch);
+			}
+			else {
+				++batch;
+			}
+		}
+		// Everything up to the end of the finished batches is free, unless an unfinished batch or a hold that hasn't been submitted has regions in it
+		VkDeviceSize end = finishedEnd;
+		for (const Batch& batch : batches) {
+			end = std::min(end, batch.start);
+		}
+		for (auto hold : holds) {
+			end = std::min(end, hold->start);
+		}
+		tail = std::max(tail, end);
+	}
+
+	/** @brief The hold's regions have been submitted, they no longer keep the tail back */
+	void StagingRing::release(Hold* hold)
+	{
+		if (hold->active) {
+			hold->active = false;
+			holds.erase(std::find(holds.begin(), holds.end(), hold));
+		}
+	}
+
+	bool StagingRing::reserve(VkDeviceSize size, VkDeviceSize alignment, bool block, Region* region, Hold* hold, std::unique_lock<std::mutex>& lock)
+	{
+		if (size > capacity) {
+			throw std::runtime_error("Upload of " + std::to_string(size) + " bytes does not fit into the staging ring");
+		}
+		for (;;) {
+			// Nothing in use, start over at the beginning so the whole capacity is available in one piece
+			if ((head == tail) && batches.empty() && holds.empty()) {
+				head = 0;
+				tail = 0;
+				finishedEnd = 0;
+			}
+			VkDeviceSize offset = head % capacity;
+			VkDeviceSize padding = (alignment - (offset % alignment)) % alignment;
+			// Regions never wrap around the end of the buffer, skip the remainder instead
+			if (offset + padding + size > capacity) {
+				padding = capacity - offset;
+			}
+			if (head + padding + size - tail <= capacity) {
+				head += padding;
+				region->buffer = buffer.buffer;
+				region->offset = head % capacity;
+				region->size = size;
+				region->data = static_cast<uint8_t*>(buffer.mapped) + region->offset;
+				if (!hold->active) {
+					hold->active = true;
+					hold->start = head;
+					hold->thread = std::this_thread::get_id();
+					holds.push_back(hold);
+				}
+				head += size;
+				return true;
+			}
+			if (!block) {
+				return false;
+			}
+			// Out of space, the copies still waiting in the current batch need to go out before their space can come back
+			if (!batches.empty()) {
+				recycle(true);
+			}
+			else if (currentHold.active) {
+				begin();
+				submit();
+			}
+			else {
+				// Only holds of batches that haven't been submitted are left, those of this thread would never be
+				if (std::all_of(holds.begin(), holds.end(), [](const Hold* other) { return other->thread == std::this_thread::get_id(); })) {
+					throw std::runtime_error("Staging ring is full with data of upload batches that haven't been submitted");
+				}
+				// Other threads can only submit theirs while the ring isn't locked
+				lock.unlock();
+				std::this_thread::yield();
+				lock.lock();
+				recycle(false);
+			}
+		}
+	}
+
+	/** @brief Take a command buffer from the pool and begin it */
+	VkCommandBuffer StagingRing::beginCommandBuffer()
+	{
+		VkCommandBuffer commandBuffer;
+		if (!freeCommandBuffers.empty()) {
+			commandBuffer = freeCommandBuffers.back();
+			freeCommandBuffers.pop_back();
+		}
+		else {
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &commandBuffer));
+		}
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		return commandBuffer;
+	}
+
+	/** @brief Command buffer of the current batch, begun on first use */
+	VkCommandBuffer StagingRing::begin()
+	{
+		if (current == VK_NULL_HANDLE) {
+			current = beginCommandBuffer();
+		}
+		return current;
+	}
+
+	uint64_t StagingRing::submit()
+	{
+		if (current == VK_NULL_HANDLE) {
+			return lastValue;
+		}
+		const uint64_t value = submit(current, &currentHold);
+		current = VK_NULL_HANDLE;
+		return value;
+	}
+
+	/** @brief End and submit a command buffer of copies, its regions are recycled once the returned value has been reached */
+	uint64_t StagingRing::submit(VkCommandBuffer commandBuffer, Hold* hold)
+	{
+		// Make the copies available to everything submitted to the queue after the batch, so users of the uploaded data only need to be submitted later
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+		lastValue = timeline->submit(queue, &commandBuffer, 1);
+		// A hold without regions (e.g. a batch of copies from imported memory only) uses no ring space
+		const VkDeviceSize start = hold->active ? hold->start : head;
+		batches.push_back({ commandBuffer, lastValue, start, head });
+		release(hold);
+		return lastValue;
+	}
+
+	/**
+	* Allocate a region of the ring to write upload data to
+	*
+	* @param size Size of the region, must not exceed the ring's capacity
+	* @param alignment (Optional) Alignment of the region's offset (e.g. the texel block size for image copies)
+	* @param hold (Optional) Hold the region belongs to, it's then kept until the hold is submitted with submitBatch()
+	*
+	* @note If the ring is full this submits the pending copies and blocks until the oldest batch has finished.
+	* Without a hold, record the copy from a region before allocating the next one, regions whose copy wasn't recorded by the next flush are lost.
+	* With a hold, submit the hold's pending copies first if tryAllocate() fails, the ring can't submit them itself
+	*
+	* @return Region to write to and copy from
+	*/
+	StagingRing::Region StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment, Hold* hold)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		recycle(false);
+		Region region;
+		reserve(size, alignment, true, &region, hold ? hold : &currentHold, lock);
+		return region;
+	}
+
+	/**
+	* Allocate a region of the ring without ever submitting or blocking
+	*
+	* @param size Size of the region, must not exceed the ring's capacity
+	* @param alignment Alignment of the region's offset
+	* @param region Receives the region
+	* @param hold (Optional) Hold the region belongs to
+	*
+	* @note Lets callers that record their copies later (see vks::UploadBatch) submit them first when the ring is full
+	*
+	* @return False if the ring has no space left until pending or in flight copies have finished
+	*/
+	bool StagingRing::tryAllocate(VkDeviceSize size, VkDeviceSize alignment, Region* region, Hold* hold)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		recycle(false);
+		return reserve(size, alignment, false, region, hold ? hold : &currentHold, lock);
+	}
+
+	/**
+	* Record and submit the copies of a hold in a command buffer of their own
+	*
+	* @param hold Hold whose regions the copies read from, they are recycled once the submission has finished
+	* @param record Called with the command buffer to record the copies into, while the ring is locked
+	*
+	* @note Ends with the same barrier as the ring's own batches, work submitted to the queue afterwards sees the uploaded data
+	*
+	* @return Timeline value of the ring's queue that is reached once the copies have finished
+	*/
+	uint64_t StagingRing::submitBatch(Hold* hold, const std::function<void(VkCommandBuffer)>& record)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		// The command buffer comes from the ring's pool, which is only safe to record from with the ring locked
+		VkCommandBuffer commandBuffer = beginCommandBuffer();
+		record(commandBuffer);
+		return submit(commandBuffer, hold);
+	}
+
+	/** @brief Record a copy of a whole region into a buffer */
+	void StagingRing::copyBuffer(const Region& region, VkBuffer dst, VkDeviceSize dstOffset)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = region.offset;
+		copyRegion.dstOffset = dstOffset;
+		copyRegion.size = region.size;
+		vkCmdCopyBuffer(begin(), region.buffer, dst, 1, &copyRegion);
+	}
+
+	/**
+	* Record a copy from a region into an image
+	*
+	* @param region Region holding the texel data
+	* @param dst Image to copy to
+	* @param dstLayout Layout of the image at the time of the copy (TRANSFER_DST_OPTIMAL or GENERAL)
+	* @param copy Copy description, bufferOffset is relative to the start of the region
+	*/
+	void StagingRing::copyBufferToImage(const Region& region, VkImage dst, VkImageLayout dstLayout, const VkBufferImageCopy& copy)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		VkBufferImageCopy bufferCopyRegion = copy;
+		bufferCopyRegion.bufferOffset += region.offset;
+		vkCmdCopyBufferToImage(begin(), region.buffer, dst, dstLayout, 1, &bufferCopyRegion);
+	}
+
+	/**
+	* Copy data into a buffer through the ring
+	*
+	* @param dst Buffer to copy to, needs VK_BUFFER_USAGE_TRANSFER_DST_BIT
+	* @param dstOffset Offset in the destination buffer
+	* @param data Data to upload
+	* @param size Size of the data, larger uploads are split into several copies
+	*/
+	void StagingRing::upload(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		recycle(false);
+		const uint8_t* src = static_cast<const uint8_t*>(data);
+		while (size > 0) {
+			const VkDeviceSize chunkSize = std::min(size, capacity / 2);
+			Region region;
+			reserve(chunkSize, 16, true, &region, &currentHold, lock);
+			memcpy(region.data, src, chunkSize);
+			VkBufferCopy copyRegion{};
+			copyRegion.srcOffset = region.offset;
+			copyRegion.dstOffset = dstOffset;
+			copyRegion.size = chunkSize;
+			vkCmdCopyBuffer(begin(), region.buffer, dst, 1, &copyRegion);
+			src += chunkSize;
+			dstOffset += chunkSize;
+			size -= chunkSize;
+		}
+	}
+
+	/**
+	* Submit the copies recorded since the last flush
+	*
+	* @note Work submitted to the same queue afterwards sees the uploaded data, other queues have to wait for the returned value
+	*
+	* @return Timeline value of the ring's queue that is reached once the copies have finished (the previous batch's value if nothing was pending)
+	*/
+	uint64_t StagingRing::flush()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return submit();
+	}
+
+	/** @brief Block until the batch with the given value (see flush) has finished */
+	void StagingRing::wait(uint64_t value)
+	{
+		if (value > 0) {
+			VK_CHECK_RESULT(timeline->wait(value));
+		}
+	}
+
+	/** @brief Bytes of the ring currently in use by pending and in flight uploads */
+	VkDeviceSize StagingRing::used()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return head - tail;
+	}
+
+	/** @brief Timeline of the queue the ring's batches are submitted to, flush() returns values of it */
+	vks::Timeline* StagingRing::queueTimeline() const
+	{
+		return timeline;
+	}
+}
@@ -0,0 +1,123 @@
+/*
+* Staging ring
+*
+* Persistently mapped ring of host visible memory that all uploads to device local resources go through
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanBuffer.h"
+#include "VulkanTimeline.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* @brief Single persistently mapped upload buffer shared by all uploads of a device
+	*
+	* Callers write their data straight into a region of the ring and record a copy from it. Copies are batched into one
+	* command buffer that is submitted by flush(), the regions written since the previous flush are recycled once the
+	* queue's timeline reaches the value returned for the batch. There is no per-upload buffer creation, memory allocation
+	* or mapping
+	*
+	* Callers that collect their copies and record them later (see vks::UploadBatch) allocate their regions with a Hold and
+	* submit them with submitBatch(), their regions are kept until that submission has finished, no matter how often the
+	* ring is flushed in between
+	*/
+	class StagingRing
+	{
+	public:
+		/** @brief Default size of the ring */
+		static const VkDeviceSize defaultCapacity = 32 * 1024 * 1024;
+
+		/** @brief Part of the ring handed out to a single upload */
+		struct Region {
+			/** @brief Host pointer to write the data to */
+			void* data;
+			/** @brief Staging buffer to copy from */
+			VkBuffer buffer;
+			/** @brief Offset of the region in the staging buffer */
+			VkDeviceSize offset;
+			VkDeviceSize size;
+		};
+
+		/** @brief Ring space of a caller that submits its own copies, nothing from its first region on is recycled before that submission has finished */
+		struct Hold {
+			/** @brief Set while the hold has regions that haven't been submitted yet */
+			bool active = false;
+			/** @brief Running ring position of the first of these regions */
+			VkDeviceSize start = 0;
+			/** @brief Thread that allocated them */
+			std::thread::id thread;
+		};
+
+		/** @brief Size of the ring in bytes */
+		VkDeviceSize capacity = 0;
+		/** @brief Family of the queue the copies are executed on */
+		uint32_t queueFamilyIndex = 0;
+
+		void create(vks::VulkanDevice* device, VkQueue queue, uint32_t queueFamilyIndex, VkDeviceSize capacity = defaultCapacity);
+		void destroy();
+
+		Region allocate(VkDeviceSize size, VkDeviceSize alignment = 16, Hold* hold = nullptr);
+		bool tryAllocate(VkDeviceSize size, VkDeviceSize alignment, Region* region, Hold* hold = nullptr);
+		uint64_t submitBatch(Hold* hold, const std::function<void(VkCommandBuffer)>& record);
+		void copyBuffer(const Region& region, VkBuffer dst, VkDeviceSize dstOffset = 0);
+		void copyBufferToImage(const Region& region, VkImage dst, VkImageLayout dstLayout, const VkBufferImageCopy& copy);
+		void upload(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+		uint64_t flush();
+		void wait(uint64_t value);
+
+		VkDeviceSize used();
+		vks::Timeline* queueTimeline() const;
+
+	private:
+		/** @brief Submitted batch of copies and the ring space it used */
+		struct Batch {
+			VkCommandBuffer commandBuffer;
+			uint64_t timelineValue;
+			/** @brief Running ring position of the batch's first region, batches of holds may start before batches submitted earlier */
+			VkDeviceSize start;
+			VkDeviceSize end;
+		};
+		VkDevice device = VK_NULL_HANDLE;
+		VkQueue queue = VK_NULL_HANDLE;
+		vks::Timeline* timeline = nullptr;
+		vks::Buffer buffer;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		/** @brief Command buffer the copies of the current (not yet submitted) batch are recorded into */
+		VkCommandBuffer current = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> freeCommandBuffers;
+		std::deque<Batch> batches;
+		/** @brief Running byte counters, the ring offset is the counter modulo the capacity */
+		VkDeviceSize head = 0;
+		VkDeviceSize tail = 0;
+		/** @brief End of the finished batches, the tail only gets there once no unfinished batch or hold has regions before it */
+		VkDeviceSize finishedEnd = 0;
+		uint64_t lastValue = 0;
+		/** @brief Regions of the current batch */
+		Hold currentHold;
+		/** @brief Holds with regions that haven't been submitted yet */
+		std::vector<Hold*> holds;
+		std::mutex mutex;
+
+		bool reserve(VkDeviceSize size, VkDeviceSize alignment, bool block, Region* region, Hold* hold, std::unique_lock<std::mutex>& lock);
+		VkCommandBuffer beginCommandBuffer();
+		VkCommandBuffer begin();
+		void recycle(bool block);
+		void release(Hold* hold);
+		uint64_t submit();
+		uint64_t submit(VkCommandBuffer commandBuffer, Hold* hold);
+	};
+}
@@ -35,26 +35,26 @@ void VulkanSwapChain::initSurface(uint32_t width, uint32_t height)
 	surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
 	surfaceCreateInfo.hinstance = (HINSTANCE)platformHandle;
 	surfaceCreateInfo.hwnd = (HWND)platformWindow;
-	err = vkCreateWin32SurfaceKHR(instance, &surfaceCreateInfo, nullptr, &surface);
+	err = vkCreateWin32SurfaceKHR(instance, &surfaceCreateInfo, vks::HostAllocator::callbacks(), &surface);
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
 	VkAndroidSurfaceCreateInfoKHR surfaceCreateInfo = {};
 	surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_ANDROID_SURFACE_CREATE_INFO_KHR;
 	surfaceCreateInfo.window = window;
-	err = vkCreateAndroidSurfaceKHR(instance, &surfaceCreateInfo, NULL, &surface);
+	err = vkCreateAndroidSurfaceKHR(instance, &surfaceCreateInfo, vks::HostAllocator::callbacks(), &surface);
 #elif defined(VK_USE_PLATFORM_IOS_MVK)
 	VkIOSSurfaceCreateInfoMVK surfaceCreateInfo = {};
 	surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_IOS_SURFACE_CREATE_INFO_MVK;
 	surfaceCreateInfo.pNext = NULL;
 	surfaceCreateInfo.flags = 0;
 	surfaceCreateInfo.pView = view;
-	err = vkCreateIOSSurfaceMVK(instance, &surfaceCreateInfo, nullptr, &surface);
+	err = vkCreateIOSSurfaceMVK(instance, &surfaceCreateInfo, vks::HostAllocator::callbacks(), &surface);
 #elif defined(VK_USE_PLATFORM_MACOS_MVK)
 	VkMacOSSurfaceCreateInfoMVK surfaceCreateInfo = {};
 	surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_MACOS_SURFACE_CREATE_INFO_MVK;
 	surfaceCreateInfo.pNext = NULL;
 	surfaceCreateInfo.flags = 0;
 	surfaceCreateInfo.pView = view;
-	err = vkCreateMacOSSurfaceMVK(instance, &surfaceCreateInfo, NULL, &surface);
+	err = vkCreateMacOSSurfaceMVK(instance, &surfaceCreateInfo, vks::HostAllocator::callbacks(), &surface);
 #elif defined(_DIRECT2DISPLAY)
 	createDirect2DisplaySurface(width, height);
 #elif defined(VK_USE_PLATFORM_DIRECTFB_EXT)
@@ -62,19 +62,19 @@ void VulkanSwapChain::initSurface(uint32_t width, uint32_t height)
 	surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_DIRECTFB_SURFACE_CREATE_INFO_EXT;
 	surfaceCreateInfo.dfb = dfb;
 	surfaceCreateInfo.surface = window;
-	err = vkCreateDirectFBSurfaceEXT(instance, &surfaceCreateInfo, nullptr, &surface);
+	err = vkCreateDirectFBSurfaceEXT(instance, &surfaceCreateInfo, vks::HostAllocator::callbacks(), &surface);
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
 	VkWaylandSurfaceCreateInfoKHR surfaceCreateInfo = {};
 	surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_WAYLAND_SURFACE_CREATE_INFO_KHR;
 	surfaceCreateInfo.display = display;
 	surfaceCreateInfo.surface = window;
-	err = vkCreateWaylandSurfaceKHR(instance, &surfaceCreateInfo, nullptr, &surface);
+	err = vkCreateWaylandSurfaceKHR(instance, &surfaceCreateInfo, vks::HostAllocator::callbacks(), &surface);
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
 	VkXcbSurfaceCreateInfoKHR surfaceCreateInfo = {};
 	surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR;
 	surfaceCreateInfo.connection = connection;
 	surfaceCreateInfo.window = window;
-	err = vkCreateXcbSurfaceKHR(instance, &surfaceCreateInfo, nullptr, &surface);
+	err = vkCreateXcbSurfaceKHR(instance, &surfaceCreateInfo, vks::HostAllocator::callbacks(), &surface);
 #elif defined(VK_USE_PLATFORM_HEADLESS_EXT)
 	VkHeadlessSurfaceCreateInfoEXT surfaceCreateInfo = {};
 	surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
@@ -82,7 +82,7 @@ void VulkanSwapChain::initSurface(uint32_t width, uint32_t height)
 	if (!fpCreateHeadlessSurfaceEXT){
 		vks::tools::exitFatal("Could not fetch function pointer for the headless extension!", -1);
 	}
-	err = fpCreateHeadlessSurfaceEXT(instance, &surfaceCreateInfo, nullptr, &surface);
+	err = fpCreateHeadlessSurfaceEXT(instance, &surfaceCreateInfo, vks::HostAllocator::callbacks(), &surface);
 #endif
 
 	if (err != VK_SUCCESS) {
@@ -198,15 +198,75 @@ void VulkanSwapChain::connect(VkInstance instance, VkPhysicalDevice physicalDevi
 	this->device = device;
 }
 
+/**
+* Render to plain device images instead of a presentable swap chain, used for headless rendering if no surface is available
+*
+* @note Acquiring hands out the images round robin and presenting is a no-op, so neither signals nor waits on the passed semaphores
+*/
+void VulkanSwapChain::initOffscreen()
+{
+	offscreen = true;
+
+	// Without a surface any queue family with graphics support will do
+	uint32_t queueCount;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueCount, NULL);
+	std::vector<VkQueueFamilyProperties> queueProps(queueCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueCount, queueProps.data());
+	for (uint32_t i = 0; i < queueCount; i++)
+	{
+		if ((queueProps[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0)
+		{
+			queueNodeIndex = i;
+			break;
+		}
+	}
+	if (queueNodeIndex == UINT32_MAX)
+	{
+		vks::tools::exitFatal("Could not find a graphics queue!", -1);
+	}
+
+	// Use the first of the formats preferred for surfaces that can be rendered to and copied from
+	std::vector<VkFormat> preferredImageFormats = {
+		VK_FORMAT_B8G8R8A8_UNORM,
+		VK_FORMAT_R8G8B8A8_UNORM,
+		VK_FORMAT_A8B8G8R8_UNORM_PACK32
+	};
+	colorFormat = VK_FORMAT_UNDEFINED;
+	for (auto format : preferredImageFormats)
+	{
+		VkFormatProperties formatProps;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProps);
+		const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT;
+		if ((formatProps.optimalTilingFeatures & requiredFeatures) == requiredFeatures)
+		{
+			colorFormat = format;
+			break;
+		}
+	}
+	if (colorFormat == VK_FORMAT_UNDEFINED)
+	{
+		vks::tools::exitFatal("Could not find a suitable color format for offscreen rendering!", -1);
+	}
+	colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+}
+
 /** 
 * Create the swapchain and get its images with given width and height
 * 
 * @param width Pointer to the width of the swapchain (may be adjusted to fit the requirements of the swapchain)
 * @param height Pointer to the height of the swapchain (may be adjusted to fit the requirements of the swapchain)
 * @param vsync (Optional) Can be used to force vsync-ed rendering (by using VK_PRESENT_MODE_FIFO_KHR as presentation mode)
+* @param fullscreen (Optional) Request the full screen extent
+* @param deletionQueue (Optional) If set, the old swap chain and its image views are retired through the queue instead of being destroyed right away
 */
-void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool fullscreen)
+void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool fullscreen, vks::DeletionQueue* deletionQueue)
 {
+	if (offscreen)
+	{
+		createOffscreen(*width, *height, deletionQueue);
+		return;
+	}
+
 	// Store the current swap chain handle so we can use it later on to ease up recreation
 	VkSwapchainKHR oldSwapchain = swapChain;
 
@@ -341,17 +401,32 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool
 		swapchainCI.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 	}
 
-	VK_CHECK_RESULT(vkCreateSwapchainKHR(device, &swapchainCI, nullptr, &swapChain));
+	VK_CHECK_RESULT(vkCreateSwapchainKHR(device, &swapchainCI, vks::HostAllocator::callbacks(), &swapChain));
 
 	// If an existing swap chain is re-created, destroy the old swap chain
 	// This also cleans up all the presentable images
 	if (oldSwapchain != VK_NULL_HANDLE) 
 	{ 
-		for (uint32_t i = 0; i < imageCount; i++)
+		std::vector<SwapChainBuffer> oldBuffers = buffers;
+		VkDevice device = this->device;
+		auto destroyOld = [device, oldSwapchain, oldBuffers]()
 		{
-			vkDestroyImageView(device, buffers[i].view, nullptr);
+			for (auto& buffer : oldBuffers)
+			{
+				vkDestroyImageView(device, buffer.view, vks::HostAllocator::callbacks());
+				vkDestroySemaphore(device, buffer.renderComplete, vks::HostAllocator::callbacks());
+			}
+			vkDestroySwapchainKHR(device, oldSwapchain, vks::HostAllocator::callbacks());
+		};
+		if (deletionQueue)
+		{
+			// Frames still in flight may render to (and present) images of the old swap chain, so it is kept alive until they have finished
+			deletionQueue->retire(destroyOld);
+		}
+		else
+		{
+			destroyOld();
 		}
-		vkDestroySwapchainKHR(device, oldSwapchain, nullptr);
 	}
 	VK_CHECK_RESULT(vkGetSwapchainImagesKHR(device, swapChain, &imageCount, NULL));
 
@@ -359,6 +434,12 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool
 	images.resize(imageCount);
 	VK_CHECK_RESULT(vkGetSwapchainImagesKHR(device, swapChain, &imageCount, images.data()));
 
+	createImageViews();
+}
+
+/** @brief Create the color attachment views and the render complete semaphores for all images */
+void VulkanSwapChain::createImageViews()
+{
 	// Get the swap chain buffers containing the image and imageview
 	buffers.resize(imageCount);
 	for (uint32_t i = 0; i < imageCount; i++)
@@ -385,10 +466,101 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool
 
 		colorAttachmentView.image = buffers[i].image;
 
-		VK_CHECK_RESULT(vkCreateImageView(device, &colorAttachmentView, nullptr, &buffers[i].view));
+		VK_CHECK_RESULT(vkCreateImageView(device, &colorAttachmentView, vks::HostAllocator::callbacks(), &buffers[i].view));
+
+		// The presentation engine may still wait on an image's semaphore after the frame that signaled it has finished on the GPU,
+		// it's only safe to signal it again once the image has been acquired again, so there is one semaphore per image instead of per frame
+		buffers[i].renderComplete = VK_NULL_HANDLE;
+		if (!offscreen)
+		{
+			VkSemaphoreCreateInfo semaphoreCI = vks::initializers::semaphoreCreateInfo();
+			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCI, vks::HostAllocator::callbacks(), &buffers[i].renderComplete));
+		}
 	}
 }
 
+/**
+* Create the images for offscreen rendering, same as a swap chain with three images
+*
+* @param width Width of the images
+* @param height Height of the images
+* @param deletionQueue (Optional) If set, the old images are retired through the queue instead of being destroyed right away
+*/
+void VulkanSwapChain::createOffscreen(uint32_t width, uint32_t height, vks::DeletionQueue* deletionQueue)
+{
+	if (!images.empty())
+	{
+		std::vector<SwapChainBuffer> oldBuffers = buffers;
+		std::vector<VkDeviceMemory> oldMemory = offscreenMemory;
+		VkDevice device = this->device;
+		auto destroyOld = [device, oldBuffers, oldMemory]()
+		{
+			for (size_t i = 0; i < oldBuffers.size(); i++)
+			{
+				vkDestroyImageView(device, oldBuffers[i].view, vks::HostAllocator::callbacks());
+				vkDestroyImage(device, oldBuffers[i].image, vks::HostAllocator::callbacks());
+				vkFreeMemory(device, oldMemory[i], vks::HostAllocator::callbacks());
+			}
+		};
+		if (deletionQueue)
+		{
+			deletionQueue->retire(destroyOld);
+		}
+		else
+		{
+			destroyOld();
+		}
+	}
+
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	imageCount = 3;
+	images.resize(imageCount);
+	offscreenMemory.resize(imageCount);
+	nextOffscreenImage = 0;
+	for (uint32_t i = 0; i < imageCount; i++)
+	{
+		VkImageCreateInfo imageCI = {};
+		imageCI.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = colorFormat;
+		imageCI.extent = { width, height, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		// Transfer source so results can be read back for verification
+		imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		imageCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, vks::HostAllocator::callbacks(), &images[i]));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, images[i], &memReqs);
+		VkMemoryAllocateInfo memAlloc = {};
+		memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = UINT32_MAX;
+		for (uint32_t j = 0; j < memoryProperties.memoryTypeCount; j++)
+		{
+			if ((memReqs.memoryTypeBits & (1 << j)) && (memoryProperties.memoryTypes[j].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+			{
+				memAlloc.memoryTypeIndex = j;
+				break;
+			}
+		}
+		if (memAlloc.memoryTypeIndex == UINT32_MAX)
+		{
+			vks::tools::exitFatal("Could not find a memory type for the offscreen images!", -1);
+		}
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, vks::HostAllocator::callbacks(), &offscreenMemory[i]));
+		VK_CHECK_RESULT(vkBindImageMemory(device, images[i], offscreenMemory[i], 0));
+	}
+
+	createImageViews();
+}
+
 /** 
 * Acquires the next image in the swap chain
 *
@@ -401,6 +573,13 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool
 */
 VkResult VulkanSwapChain::acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t *imageIndex)
 {
+	if (offscreen)
+	{
+		// Reusing an image is ordered against its previous use by the render pass' external dependencies, as all frames go to the same queue
+		*imageIndex = nextOffscreenImage;
+		nextOffscreenImage = (nextOffscreenImage + 1) % imageCount;
+		return VK_SUCCESS;
+	}
 	// By setting timeout to UINT64_MAX we will always wait until the next image has been acquired or an actual error is thrown
 	// With that we don't have to handle VK_NOT_READY
 	return vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, presentCompleteSemaphore, (VkFence)nullptr, imageIndex);
@@ -417,6 +596,10 @@ VkResult VulkanSwapChain::acquireNextImage(VkSemaphore presentCompleteSemaphore,
 */
 VkResult VulkanSwapChain::queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore)
 {
+	if (offscreen)
+	{
+		return VK_SUCCESS;
+	}
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	presentInfo.pNext = NULL;
@@ -433,22 +616,43 @@ VkResult VulkanSwapChain::queuePresent(VkQueue queue, uint32_t imageIndex, VkSem
 }
 
 
+/** @brief Layout the color attachment has to be left in at the end of a frame */
+VkImageLayout VulkanSwapChain::presentLayout() const
+{
+	// VK_IMAGE_LAYOUT_PRESENT_SRC_KHR is only valid with the swap chain extension, offscreen images are kept ready for readback instead
+	return offscreen ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+}
+
 /**
 * Destroy and free Vulkan resources used for the swapchain
 */
 void VulkanSwapChain::cleanup()
 {
+	if (offscreen)
+	{
+		for (uint32_t i = 0; i < images.size(); i++)
+		{
+			vkDestroyImageView(device, buffers[i].view, vks::HostAllocator::callbacks());
+			vkDestroyImage(device, images[i], vks::HostAllocator::callbacks());
+			vkFreeMemory(device, offscreenMemory[i], vks::HostAllocator::callbacks());
+		}
+		images.clear();
+		buffers.clear();
+		offscreenMemory.clear();
+		return;
+	}
 	if (swapChain != VK_NULL_HANDLE)
 	{
 		for (uint32_t i = 0; i < imageCount; i++)
 		{
-			vkDestroyImageView(device, buffers[i].view, nullptr);
+			vkDestroyImageView(device, buffers[i].view, vks::HostAllocator::callbacks());
+			vkDestroySemaphore(device, buffers[i].renderComplete, vks::HostAllocator::callbacks());
 		}
 	}
 	if (surface != VK_NULL_HANDLE)
 	{
-		vkDestroySwapchainKHR(device, swapChain, nullptr);
-		vkDestroySurfaceKHR(instance, surface, nullptr);
+		vkDestroySwapchainKHR(device, swapChain, vks::HostAllocator::callbacks());
+		vkDestroySurfaceKHR(instance, surface, vks::HostAllocator::callbacks());
 	}
 	surface = VK_NULL_HANDLE;
 	swapChain = VK_NULL_HANDLE;
@@ -581,7 +785,7 @@ void VulkanSwapChain::createDirect2DisplaySurface(uint32_t width, uint32_t heigh
 	surfaceInfo.imageExtent.width = width;
 	surfaceInfo.imageExtent.height = height;
 
-	VkResult result = vkCreateDisplayPlaneSurfaceKHR(instance, &surfaceInfo, NULL, &surface);
+	VkResult result = vkCreateDisplayPlaneSurfaceKHR(instance, &surfaceInfo, vks::HostAllocator::callbacks(), &surface);
 	if (result !=VK_SUCCESS) {
 		vks::tools::exitFatal("Failed to create surface!", result);
 	}
@@ -18,6 +18,7 @@
 
 #include <vulkan/vulkan.h>
 #include "VulkanTools.h"
+#include "VulkanDeletionQueue.h"
 
 #ifdef __ANDROID__
 #include "VulkanAndroid.h"
@@ -30,6 +31,8 @@
 typedef struct _SwapChainBuffers {
 	VkImage image;
 	VkImageView view;
+	/** @brief Signaled once rendering to the image has finished, waited on by the presentation engine (VK_NULL_HANDLE for offscreen images) */
+	VkSemaphore renderComplete;
 } SwapChainBuffer;
 
 class VulkanSwapChain
@@ -38,7 +41,7 @@ private:
 	VkInstance instance;
 	VkDevice device;
 	VkPhysicalDevice physicalDevice;
-	VkSurfaceKHR surface;
+	VkSurfaceKHR surface = VK_NULL_HANDLE;
 public:
 	VkFormat colorFormat;
 	VkColorSpaceKHR colorSpace;
@@ -47,6 +50,8 @@ public:
 	std::vector<VkImage> images;
 	std::vector<SwapChainBuffer> buffers;
 	uint32_t queueNodeIndex = UINT32_MAX;
+	/** @brief Set if the images are plain device images rendered to without presentation (headless mode without a surface) */
+	bool offscreen = false;
 
 #if defined(VK_USE_PLATFORM_WIN32_KHR)
 	void initSurface(void* platformHandle, void* platformWindow);
@@ -66,9 +71,18 @@ public:
 	void createDirect2DisplaySurface(uint32_t width, uint32_t height);
 #endif
 #endif
+	void initOffscreen();
 	void connect(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device);
-	void create(uint32_t* width, uint32_t* height, bool vsync = false, bool fullscreen = false);
+	void create(uint32_t* width, uint32_t* height, bool vsync = false, bool fullscreen = false, vks::DeletionQueue* deletionQueue = nullptr);
 	VkResult acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t* imageIndex);
 	VkResult queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore = VK_NULL_HANDLE);
+	VkImageLayout presentLayout() const;
 	void cleanup();
+private:
+	/** @brief Backing memory of the offscreen images */
+	std::vector<VkDeviceMemory> offscreenMemory;
+	/** @brief Offscreen images are handed out round robin */
+	uint32_t nextOffscreenImage = 0;
+	void createOffscreen(uint32_t width, uint32_t height, vks::DeletionQueue* deletionQueue);
+	void createImageViews();
 };
@@ -0,0 +1,174 @@
+/*
+* Timeline semaphore
+*
+* Monotonically increasing per-queue counter used for all host/device synchronization
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanTimeline.h"
+
+namespace vks
+{
+	const uint32_t TimelineSubmit::maxSemaphores;
+
+	void TimelineSubmit::waitBinary(VkSemaphore semaphore, VkPipelineStageFlags stage)
+	{
+		assert(waitCount < maxSemaphores);
+		waitSemaphores[waitCount] = semaphore;
+		// Ignored for binary semaphores
+		waitValues[waitCount] = 0;
+		waitStages[waitCount] = stage;
+		waitCount++;
+	}
+
+	void TimelineSubmit::waitTimeline(const Timeline& timeline, uint64_t value, VkPipelineStageFlags stage)
+	{
+		assert(waitCount < maxSemaphores);
+		waitSemaphores[waitCount] = timeline.semaphore;
+		waitValues[waitCount] = value;
+		waitStages[waitCount] = stage;
+		waitCount++;
+	}
+
+	void TimelineSubmit::signalBinary(VkSemaphore semaphore)
+	{
+		// The first signal slot of a submission is taken by the timeline itself
+		assert(signalCount < maxSemaphores - 1);
+		signalSemaphores[signalCount++] = semaphore;
+	}
+
+	/**
+	* Create the timeline semaphore with an initial value of 0
+	*
+	* @param device Logical device the semaphore is created on
+	* @param functions Timeline semaphore entry points of that device
+	*/
+	void Timeline::create(VkDevice device, const vks::TimelineFunctions* functions)
+	{
+		this->device = device;
+		this->functions = functions;
+		VkSemaphoreTypeCreateInfoKHR semaphoreTypeCI{};
+		semaphoreTypeCI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+		semaphoreTypeCI.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+		semaphoreTypeCI.initialValue = 0;
+		VkSemaphoreCreateInfo semaphoreCI = vks::initializers::semaphoreCreateInfo();
+		semaphoreCI.pNext = &semaphoreTypeCI;
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCI, vks::HostAllocator::callbacks(), &semaphore));
+		submittedValue = 0;
+		completedValue = 0;
+	}
+
+	void Timeline::destroy()
+	{
+		if (semaphore != VK_NULL_HANDLE) {
+			vkDestroySemaphore(device, semaphore, vks::HostAllocator::callbacks());
+			semaphore = VK_NULL_HANDLE;
+		}
+	}
+
+	/**
+	* Submit command buffers to the timeline's queue and signal the next timeline value once they have finished
+	*
+	* @param queue Queue the timeline belongs to
+	* @param commandBuffers Command buffers to submit
+	* @param commandBufferCount Number of command buffers
+	* @param sync (Optional) Additional semaphores to wait on and binary semaphores to signal
+	*
+	* @note Thread safe, submissions from several threads signal their values in the order they reach the queue
+	*
+	* @return Timeline value that is reached once the submission has finished executing
+	*/
+	uint64_t Timeline::submit(VkQueue queue, const VkCommandBuffer* commandBuffers, uint32_t commandBufferCount, const TimelineSubmit* sync)
+	{
+		// Values have to be signaled in increasing order, so reserving the value and submitting can't be interleaved with another submitter
+		std::lock_guard<std::mutex> lock(queueMutex);
+		const uint64_t value = submittedValue.fetch_add(1) + 1;
+
+		VkSemaphore signalSemaphores[TimelineSubmit::maxSemaphores] = { semaphore };
+		uint64_t signalValues[TimelineSubmit::maxSemaphores] = { value };
+		uint32_t signalCount = 1;
+		if (sync) {
+			for (uint32_t i = 0; i < sync->signalCount; i++) {
+				signalSemaphores[signalCount] = sync->signalSemaphores[i];
+				signalValues[signalCount] = 0;
+				signalCount++;
+			}
+		}
+
+		VkTimelineSemaphoreSubmitInfoKHR timelineSubmitInfo{};
+		timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		timelineSubmitInfo.waitSemaphoreValueCount = sync ? sync->waitCount : 0;
+		timelineSubmitInfo.pWaitSemaphoreValues = sync ? sync->waitValues : nullptr;
+		timelineSubmitInfo.signalSemaphoreValueCount = signalCount;
+		timelineSubmitInfo.pSignalSemaphoreValues = signalValues;
+
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.pNext = &timelineSubmitInfo;
+		submitInfo.waitSemaphoreCount = sync ? sync->waitCount : 0;
+		submitInfo.pWaitSemaphores = sync ? sync->waitSemaphores : nullptr;
+		submitInfo.pWaitDstStageMask = sync ? sync->waitStages : nullptr;
+		submitInfo.commandBufferCount = commandBufferCount;
+		submitInfo.pCommandBuffers = commandBuffers;
+		submitInfo.signalSemaphoreCount = signalCount;
+		submitInfo.pSignalSemaphores = signalSemaphores;
+		// No fence, completion is tracked through the timeline value
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		return value;
+	}
+
+	/** @brief Value signaled by the latest submission, everything is done once the timeline reaches it */
+	uint64_t Timeline::submitted() const
+	{
+		return submittedValue.load();
+	}
+
+	/** @brief Query the value the device has reached */
+	uint64_t Timeline::completed()
+	{
+		uint64_t value = 0;
+		VK_CHECK_RESULT(functions->getSemaphoreCounterValue(device, semaphore, &value));
+		// Other threads may have seen a larger value in the meantime
+		uint64_t previous = completedValue.load();
+		while ((previous < value) && !completedValue.compare_exchange_weak(previous, value)) {}
+		return value;
+	}
+
+	/** @brief Returns true if the timeline has reached the given value, only queries the device if the cached value isn't sufficient */
+	bool Timeline::reached(uint64_t value)
+	{
+		if (completedValue.load() >= value) {
+			return true;
+		}
+		return completed() >= value;
+	}
+
+	/**
+	* Block the calling thread until the timeline has reached the given value
+	*
+	* @param value Value to wait for
+	* @param timeout (Optional) Timeout in nanoseconds
+	*
+	* @return VK_SUCCESS or VK_TIMEOUT
+	*/
+	VkResult Timeline::wait(uint64_t value, uint64_t timeout)
+	{
+		if (reached(value)) {
+			return VK_SUCCESS;
+		}
+		VkSemaphoreWaitInfoKHR waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &semaphore;
+		waitInfo.pValues = &value;
+		VkResult result = functions->waitSemaphores(device, &waitInfo, timeout);
+		if (result == VK_SUCCESS) {
+			uint64_t previous = completedValue.load();
+			while ((previous < value) && !completedValue.compare_exchange_weak(previous, value)) {}
+		}
+		else if (result != VK_TIMEOUT) {
+			VK_CHECK_RESULT(result);
+		}
+		return result;
+	}
+}
@@ -0,0 +1,84 @@
+/*
+* Timeline semaphore
+*
+* Monotonically increasing per-queue counter used for all host/device synchronization
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/** @brief Timeline semaphore entry points, loaded at device creation (core 1.2 or VK_KHR_timeline_semaphore) */
+	struct TimelineFunctions
+	{
+		PFN_vkGetSemaphoreCounterValueKHR getSemaphoreCounterValue = nullptr;
+		PFN_vkWaitSemaphoresKHR waitSemaphores = nullptr;
+		PFN_vkSignalSemaphoreKHR signalSemaphore = nullptr;
+	};
+
+	class Timeline;
+
+	/**
+	* @brief Additional semaphores for a timeline submission
+	*
+	* Binary semaphores are only needed to talk to the presentation engine, everything else waits on timeline values
+	*/
+	struct TimelineSubmit
+	{
+		static const uint32_t maxSemaphores = 4;
+
+		uint32_t waitCount = 0;
+		VkSemaphore waitSemaphores[maxSemaphores];
+		uint64_t waitValues[maxSemaphores];
+		VkPipelineStageFlags waitStages[maxSemaphores];
+		uint32_t signalCount = 0;
+		VkSemaphore signalSemaphores[maxSemaphores];
+
+		/** @brief Wait on a binary semaphore (e.g. the swap chain's image acquisition) */
+		void waitBinary(VkSemaphore semaphore, VkPipelineStageFlags stage);
+		/** @brief Wait until another queue's timeline has reached the given value */
+		void waitTimeline(const Timeline& timeline, uint64_t value, VkPipelineStageFlags stage);
+		/** @brief Signal a binary semaphore (e.g. for presentation) in addition to the timeline */
+		void signalBinary(VkSemaphore semaphore);
+	};
+
+	/**
+	* @brief Timeline semaphore owned by a single queue
+	*
+	* Every submission to the queue signals the next value of the timeline, so "value N reached" means that submission N
+	* and everything submitted to the queue before it has finished executing. Frame pacing, resource retirement and
+	* upload completion are all expressed as timeline values instead of fences
+	*/
+	class Timeline
+	{
+	public:
+		VkSemaphore semaphore = VK_NULL_HANDLE;
+		/** @brief Guards the timeline's queue, held by submit() and to be held by anything else that accesses the queue (e.g. presentation) */
+		std::mutex queueMutex;
+
+		void create(VkDevice device, const vks::TimelineFunctions* functions);
+		void destroy();
+
+		uint64_t submit(VkQueue queue, const VkCommandBuffer* commandBuffers, uint32_t commandBufferCount, const TimelineSubmit* sync = nullptr);
+		uint64_t submitted() const;
+		uint64_t completed();
+		bool reached(uint64_t value);
+		VkResult wait(uint64_t value, uint64_t timeout = UINT64_MAX);
+
+	private:
+		VkDevice device = VK_NULL_HANDLE;
+		const vks::TimelineFunctions* functions = nullptr;
+		/** @brief Last value handed out to a submission */
+		std::atomic<uint64_t> submittedValue{ 0 };
+		/** @brief Last value the device was seen to have reached, saves querying the semaphore for values known to be done */
+		std::atomic<uint64_t> completedValue{ 0 };
+	};
+}
@@ -7,6 +7,8 @@
  */
 
 #include "VulkanTools.h"
+#include "VulkanMappedFile.h"
+#include "VulkanEmbeddedShaders.h"
 
 #if !(defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
 // iOS & macOS: VulkanExampleBase::getAssetPath() implemented externally to allow access to Objective-C components
@@ -152,6 +154,19 @@ namespace vks
 			return std::find(stencilFormats.begin(), stencilFormats.end(), format) != std::end(stencilFormats);
 		}
 
+		bool attachmentIsTransient(VkImageUsageFlags usage)
+		{
+			// Input attachments are consumed by later subpasses of the same render pass
+			const VkImageUsageFlags attachmentUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+			return (usage & ~attachmentUsage) == 0;
+		}
+
+		VkAttachmentStoreOp attachmentStoreOp(VkImageUsageFlags usage)
+		{
+			// Skipping the store saves writing the attachment back to memory at the end of every pass, which matters most on tile based GPUs
+			return attachmentIsTransient(usage) ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+		}
+
 		// Returns if a given format support LINEAR filtering
 		VkBool32 formatIsFilterable(VkPhysicalDevice physicalDevice, VkFormat format, VkImageTiling tiling)
 		{
@@ -361,11 +376,30 @@ namespace vks
 			exitFatal(message, (int32_t)resultCode);
 		}
 
+		VkShaderModule loadShader(const uint32_t* code, size_t size, VkDevice device)
+		{
+			VkShaderModule shaderModule;
+			VkShaderModuleCreateInfo moduleCreateInfo{};
+			moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+			moduleCreateInfo.codeSize = size;
+			moduleCreateInfo.pCode = code;
+
+			VK_CHECK_RESULT(vkCreateShaderModule(device, &moduleCreateInfo, vks::HostAllocator::callbacks(), &shaderModule));
+
+			return shaderModule;
+		}
+
 #if defined(__ANDROID__)
 		// Android shaders are stored as assets in the apk
 		// So they need to be loaded via the asset manager
 		VkShaderModule loadShader(AAssetManager* assetManager, const char *fileName, VkDevice device)
 		{
+			const vks::EmbeddedShader* embedded = vks::findEmbeddedShader(fileName);
+			if (embedded)
+			{
+				return loadShader(embedded->code, embedded->size, device);
+			}
+
 			// Load shader from compressed asset
 			AAsset* asset = AAssetManager_open(assetManager, fileName, AASSET_MODE_STREAMING);
 			assert(asset);
@@ -384,7 +418,7 @@ namespace vks
 			moduleCreateInfo.pCode = (uint32_t*)shaderCode;
 			moduleCreateInfo.flags = 0;
 
-			VK_CHECK_RESULT(vkCreateShaderModule(device, &moduleCreateInfo, NULL, &shaderModule));
+			VK_CHECK_RESULT(vkCreateShaderModule(device, &moduleCreateInfo, vks::HostAllocator::callbacks(), &shaderModule));
 
 			delete[] shaderCode;
 
@@ -393,29 +427,18 @@ namespace vks
 #else
 		VkShaderModule loadShader(const char *fileName, VkDevice device)
 		{
-			std::ifstream is(fileName, std::ios::binary | std::ios::in | std::ios::ate);
-
-			if (is.is_open())
+			// Shaders embedded at build time are created straight from the executable
+			const vks::EmbeddedShader* embedded = vks::findEmbeddedShader(fileName);
+			if (embedded)
 			{
-				size_t size = is.tellg();
-				is.seekg(0, std::ios::beg);
-				char* shaderCode = new char[size];
-				is.read(shaderCode, size);
-				is.close();
-
-				assert(size > 0);
-
-				VkShaderModule shaderModule;
-				VkShaderModuleCreateInfo moduleCreateInfo{};
-				moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-				moduleCreateInfo.codeSize = size;
-				moduleCreateInfo.pCode = (uint32_t*)shaderCode;
-
-				VK_CHECK_RESULT(vkCreateShaderModule(device, &moduleCreateInfo, NULL, &shaderModule));
-
-				delete[] shaderCode;
+				return loadShader(embedded->code, embedded->size, device);
+			}
 
-				return shaderModule;
+			// The mapping is page aligned, so the code can be passed to the driver as is
+			vks::MappedFile file;
+			if (file.open(fileName))
+			{
+				return loadShader(reinterpret_cast<const uint32_t*>(file.data()), file.size(), device);
 			}
 			else
 			{
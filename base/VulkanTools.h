@@ -10,6 +10,7 @@
 
 #include "vulkan/vulkan.h"
 #include "VulkanInitializers.hpp"
+#include "VulkanHostAllocator.h"
 
 #include <math.h>
 #include <stdlib.h>
@@ -87,6 +88,11 @@ namespace vks
 		// Returns true if a given format has a stencil part
 		VkBool32 formatHasStencil(VkFormat format);
 
+		/** @brief True if an image with the given usage is only accessed as an attachment inside render passes, so its contents never have to reach memory */
+		bool attachmentIsTransient(VkImageUsageFlags usage);
+		/** @brief Store op for an attachment, DONT_CARE if nothing reads the image after the render pass (see attachmentIsTransient) */
+		VkAttachmentStoreOp attachmentStoreOp(VkImageUsageFlags usage);
+
 		// Put an image memory barrier for setting an image layout on the sub resource into the given command buffer
 		void setImageLayout(
 			VkCommandBuffer cmdbuffer,
@@ -128,6 +134,8 @@ namespace vks
 #else
 		VkShaderModule loadShader(const char *fileName, VkDevice device);
 #endif
+		// Create a shader module from SPIR-V in memory
+		VkShaderModule loadShader(const uint32_t* code, size_t size, VkDevice device);
 
 		/** @brief Checks if a file exists */
 		bool fileExists(const std::string &filename);
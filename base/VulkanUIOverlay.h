@@ -21,6 +21,9 @@
 #include "VulkanDebug.h"
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
+#include "VulkanDeletionQueue.h"
+#include "VulkanUploadBatch.h"
+#include "VulkanPipelineCompiler.h"
 
 #include "imgui.h"
 
@@ -36,14 +39,23 @@ namespace vks
 	public:
 		vks::VulkanDevice *device;
 		VkQueue queue;
+		/** @brief (Optional) Buffers replaced while frames are in flight are retired through this queue instead of being destroyed right away */
+		vks::DeletionQueue* deletionQueue = nullptr;
+		/** @brief (Optional) Compiles the pipeline in the background, the overlay isn't drawn until it's ready */
+		vks::PipelineCompiler* pipelineCompiler = nullptr;
 
 		VkSampleCountFlagBits rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 		uint32_t subpass = 0;
 
-		vks::Buffer vertexBuffer;
-		vks::Buffer indexBuffer;
-		int32_t vertexCount = 0;
-		int32_t indexCount = 0;
+		/** @brief Geometry of the overlay written for one frame in flight, only rewritten once the GPU is done with that frame */
+		struct FrameBuffers {
+			vks::Buffer vertexBuffer;
+			vks::Buffer indexBuffer;
+			int32_t vertexCount = 0;
+			int32_t indexCount = 0;
+		};
+		/** @brief Buffers by frame in flight, added on first use of a frame index */
+		std::vector<FrameBuffers> frames;
 
 		std::vector<VkPipelineShaderStageCreateInfo> shaders;
 
@@ -51,9 +63,11 @@ namespace vks
 		VkDescriptorSetLayout descriptorSetLayout;
 		VkDescriptorSet descriptorSet;
 		VkPipelineLayout pipelineLayout;
-		VkPipeline pipeline;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		/** @brief Pipeline requested from pipelineCompiler, owned by the compiler */
+		std::shared_future<VkPipeline> compiledPipeline;
 
-		VkDeviceMemory fontMemory = VK_NULL_HANDLE;
+		vks::Allocation fontMemory;
 		VkImage fontImage = VK_NULL_HANDLE;
 		VkImageView fontView = VK_NULL_HANDLE;
 		VkSampler sampler;
@@ -73,11 +87,12 @@ namespace vks
 		void preparePipeline(const VkPipelineCache pipelineCache, const VkRenderPass renderPass, const VkFormat colorFormat, const VkFormat depthFormat);
 		void prepareResources();
 
-		bool update();
-		void draw(const VkCommandBuffer commandBuffer);
+		bool update(uint32_t frameIndex);
+		void draw(const VkCommandBuffer commandBuffer, uint32_t frameIndex);
 		void resize(uint32_t width, uint32_t height);
 
 		void freeResources();
+		void retire(vks::Buffer& buffer);
 
 		bool header(const char* caption);
 		bool checkBox(const char* caption, bool* value);
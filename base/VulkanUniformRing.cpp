@@ -0,0 +1,106 @@
+/*
+* Dynamic uniform ring
+*
+* Linear per-frame allocator for dynamic uniform buffer blocks
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanUniformRing.h"
+#include <algorithm>
+
+namespace vks
+{
+	const VkDeviceSize UniformRing::maxAlignment;
+
+	/**
+	* Create the ring buffer and map it for its whole lifetime
+	*
+	* @param device Device to create the buffer on
+	* @param frameCount Number of frames in flight, each one gets its own region
+	* @param frameCapacity Size of a single frame's region, blocks are padded to the ring's alignment (see UniformRing::maxAlignment)
+	*/
+	void UniformRing::create(vks::VulkanDevice* device, uint32_t frameCount, VkDeviceSize frameCapacity)
+	{
+		// Blocks are padded to at least a cache line so two threads writing neighbouring blocks don't fight over the same line
+		const VkDeviceSize cacheLineSize = 64;
+		alignment = std::max(device->properties.limits.minUniformBufferOffsetAlignment, cacheLineSize);
+		this->frameCapacity = (frameCapacity + alignment - 1) & ~(alignment - 1);
+		// Dynamic offsets are 32 bit
+		assert(this->frameCapacity * frameCount <= UINT32_MAX);
+		VK_CHECK_RESULT(device->createDynamicBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			// Rewritten every frame, so this goes straight to device memory where the host can write it (see VulkanDevice::dynamicMemoryProperties)
+			&buffer,
+			this->frameCapacity * frameCount));
+		VK_CHECK_RESULT(buffer.map());
+		frameBase = 0;
+		head = 0;
+	}
+
+	void UniformRing::destroy()
+	{
+		if (buffer.buffer != VK_NULL_HANDLE) {
+			buffer.unmap();
+			buffer.destroy();
+			buffer = vks::Buffer();
+		}
+		frameCapacity = 0;
+	}
+
+	/**
+	* Rewind the bump pointer to the start of a frame's region
+	*
+	* @param frameIndex Frame whose region is used for the following allocations, the GPU must be done with its previous submission
+	*/
+	void UniformRing::beginFrame(uint32_t frameIndex)
+	{
+		frameBase = frameCapacity * frameIndex;
+		head.store(0, std::memory_order_relaxed);
+	}
+
+	/**
+	* Allocate a block from the current frame's region
+	*
+	* @param size Size of the block in bytes
+	*
+	* @note Thread safe, can be called from several recording threads at once
+	*
+	* @return Host pointer and dynamic offset of the block, the pointer is null if the region is out of space
+	*/
+	UniformRing::Allocation UniformRing::allocate(VkDeviceSize size)
+	{
+		const VkDeviceSize alignedSize = (size + alignment - 1) & ~(alignment - 1);
+		const VkDeviceSize offset = head.fetch_add(alignedSize, std::memory_order_relaxed);
+		Allocation allocation;
+		// Called from recording jobs, where an exception can't be caught, so running out of space is left to the caller
+		if (offset + alignedSize > frameCapacity) {
+			allocation.data = nullptr;
+			allocation.dynamicOffset = 0;
+			return allocation;
+		}
+		allocation.data = static_cast<uint8_t*>(buffer.mapped) + frameBase + offset;
+		allocation.dynamicOffset = static_cast<uint32_t>(frameBase + offset);
+		return allocation;
+	}
+
+	/**
+	* Descriptor for a VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC binding that covers the whole ring
+	*
+	* @param range Size of the block the shader sees at each dynamic offset
+	*/
+	VkDescriptorBufferInfo UniformRing::descriptor(VkDeviceSize range) const
+	{
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = buffer.buffer;
+		bufferInfo.offset = 0;
+		bufferInfo.range = range;
+		return bufferInfo;
+	}
+
+	/** @brief Number of bytes allocated from the current frame's region so far */
+	VkDeviceSize UniformRing::used() const
+	{
+		return std::min(head.load(std::memory_order_relaxed), frameCapacity);
+	}
+}
@@ -0,0 +1,75 @@
+/*
+* Dynamic uniform ring
+*
+* Linear per-frame allocator for dynamic uniform buffer blocks
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <atomic>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+
+namespace vks
+{
+	/**
+	* @brief Persistently mapped ring of uniform buffer space, split into one region per frame in flight
+	*
+	* Each frame sub-allocates blocks from its region with a bump pointer and binds them through a single
+	* VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptor by passing the returned offset as dynamic offset
+	* to vkCmdBindDescriptorSets. The region is rewound once the frame's previous submission has finished
+	*/
+	class UniformRing
+	{
+	public:
+		/** @brief Largest minUniformBufferOffsetAlignment allowed by the spec, useful to size the ring before a device is known */
+		static const VkDeviceSize maxAlignment = 256;
+
+		/** @brief A block of uniform data that stays valid until the ring wraps around to the same frame */
+		struct Allocation {
+			/** @brief Host pointer to write the block's data to */
+			void* data;
+			/** @brief Offset to pass to vkCmdBindDescriptorSets as dynamic offset */
+			uint32_t dynamicOffset;
+		};
+
+		/** @brief Single host visible buffer backing all regions */
+		vks::Buffer buffer;
+		/** @brief Alignment of every block, at least minUniformBufferOffsetAlignment and a cache line so blocks written by different threads never share one */
+		VkDeviceSize alignment = 0;
+		/** @brief Size of a single frame's region */
+		VkDeviceSize frameCapacity = 0;
+
+		void create(vks::VulkanDevice* device, uint32_t frameCount, VkDeviceSize frameCapacity);
+		void destroy();
+
+		void beginFrame(uint32_t frameIndex);
+		Allocation allocate(VkDeviceSize size);
+		VkDescriptorBufferInfo descriptor(VkDeviceSize range) const;
+
+		/** @brief Allocate a block and copy the given data into it, returns false (and leaves dynamicOffset untouched) if the frame's region is out of space */
+		template<typename T>
+		bool push(const T& data, uint32_t* dynamicOffset)
+		{
+			Allocation allocation = allocate(sizeof(T));
+			if (!allocation.data) {
+				return false;
+			}
+			memcpy(allocation.data, &data, sizeof(T));
+			*dynamicOffset = allocation.dynamicOffset;
+			return true;
+		}
+
+		VkDeviceSize used() const;
+
+	private:
+		VkDeviceSize frameBase = 0;
+		std::atomic<VkDeviceSize> head{ 0 };
+	};
+}
@@ -0,0 +1,266 @@
+/*
+* Upload batch
+*
+* Collects buffer and image copies for many resources and submits them at once
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanUploadBatch.h"
+#include "VulkanDevice.h"
+#include <algorithm>
+
+namespace vks
+{
+	/** @brief Create an empty batch that submits through the device's staging ring */
+	UploadBatch::UploadBatch(vks::VulkanDevice* device) : stagingRing(&device->stagingRing) {}
+
+	/**
+	* Create an empty batch for a specific staging ring
+	*
+	* @param stagingRing Ring the batch's data and copies go through
+	* @param dstQueueFamilyIndex Family of the queues using the uploaded resources, ownership is transferred to it if it differs from the ring's
+	*/
+	UploadBatch::UploadBatch(vks::StagingRing* stagingRing, uint32_t dstQueueFamilyIndex) : stagingRing(stagingRing)
+	{
+		if (dstQueueFamilyIndex != stagingRing->queueFamilyIndex) {
+			this->dstQueueFamilyIndex = dstQueueFamilyIndex;
+		}
+	}
+
+	/** @brief Copies that haven't been submitted explicitly are submitted on destruction, without waiting for them */
+	UploadBatch::~UploadBatch()
+	{
+		if (!empty()) {
+			submit();
+		}
+	}
+
+	/**
+	* Add a copy between two buffers
+	*
+	* @param src Buffer to copy from, needs VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+	* @param dst Buffer to copy to, needs VK_BUFFER_USAGE_TRANSFER_DST_BIT and has to be shared with the using family if that is a different one
+	* @param region Source and destination range
+	*/
+	void UploadBatch::copyBuffer(VkBuffer src, VkBuffer dst, const VkBufferCopy& region)
+	{
+		bufferCopies[std::make_pair(src, dst)].push_back(region);
+		regionCount++;
+	}
+
+	/**
+	* Add an upload of host data to a buffer
+	*
+	* @param dst Buffer to copy to, needs VK_BUFFER_USAGE_TRANSFER_DST_BIT
+	* @param dstOffset Offset in the destination buffer
+	* @param data Data to upload, copied into the staging ring before the function returns
+	* @param size Size of the data
+	*
+	* @note Consecutive uploads to consecutive ranges of a buffer end up in a single copy region
+	*/
+	void UploadBatch::upload(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+	{
+		const uint8_t* src = static_cast<const uint8_t*>(data);
+		while (size > 0) {
+			// Data that doesn't fit into the ring in one piece is split up
+			const VkDeviceSize chunkSize = std::min(size, stagingRing->capacity / 2);
+			// Copies are 4 byte aligned so that consecutive uploads of whole vertices/indices stay adjacent in the ring
+			vks::StagingRing::Region region = allocate(chunkSize, 4);
+			memcpy(region.data, src, chunkSize);
+			VkBufferCopy copyRegion{};
+			copyRegion.srcOffset = region.offset;
+			copyRegion.dstOffset = dstOffset;
+			copyRegion.size = chunkSize;
+			copyBuffer(region.buffer, dst, copyRegion);
+			src += chunkSize;
+			dstOffset += chunkSize;
+			size -= chunkSize;
+		}
+	}
+
+	/**
+	* Add a copy from a buffer into an image
+	*
+	* @param src Buffer to copy from, needs VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+	* @param dst Image to copy to, needs VK_IMAGE_USAGE_TRANSFER_DST_BIT
+	* @param region Copy description
+	* @param subresourceRange Part of the image that is uploaded by the batch, transitioned to TRANSFER_DST_OPTIMAL and then to finalLayout
+	* @param finalLayout Layout the image is left in after the batch
+	*
+	* @note Pass the complete range with the first copy into an image, it may already be in the transfer layout when later copies are added
+	*/
+	void UploadBatch::copyBufferToImage(VkBuffer src, VkImage dst, const VkBufferImageCopy& region, const VkImageSubresourceRange& subresourceRange, VkImageLayout finalLayout)
+	{
+		addImageTarget(dst, subresourceRange, finalLayout);
+		imageCopies[std::make_pair(src, dst)].push_back(region);
+		regionCount++;
+	}
+
+	/**
+	* Add an upload of host data to an image
+	*
+	* @param dst Image to copy to, needs VK_IMAGE_USAGE_TRANSFER_DST_BIT
+	* @param data Texel data of all regions, copied into the staging ring before the function returns
+	* @param size Size of the data, has to fit into the staging ring
+	* @param regions Copy descriptions, their bufferOffset is relative to data
+	* @param subresourceRange Part of the image that is uploaded by the batch
+	* @param finalLayout Layout the image is left in after the batch
+	*/
+	void UploadBatch::uploadImage(VkImage dst, const void* data, VkDeviceSize size, const std::vector<VkBufferImageCopy>& regions, const VkImageSubresourceRange& subresourceRange, VkImageLayout finalLayout)
+	{
+		// 16 bytes covers the texel block size of every format
+		vks::StagingRing::Region region = allocate(size, 16);
+		memcpy(region.data, data, size);
+		for (auto copy : regions) {
+			copy.bufferOffset += region.offset;
+			copyBufferToImage(region.buffer, dst, copy, subresourceRange, finalLayout);
+		}
+	}
+
+	/**
+	* Record and submit all collected copies
+	*
+	* @note Never blocks, work submitted to the staging ring's queue afterwards sees the uploaded data.
+	* A batch must only be filled by one thread at a time, different batches can be filled on different threads
+	*
+	* @return Token that completes once the copies have finished executing (empty if the batch was empty)
+	*/
+	UploadToken UploadBatch::submit()
+	{
+		UploadToken token;
+		imageAcquireBarriers.clear();
+		if (!empty()) {
+			token.timeline = stagingRing->queueTimeline();
+			token.value = stagingRing->submitBatch(&hold, [this](VkCommandBuffer commandBuffer) { record(commandBuffer, true); });
+		}
+		recordedRegionCount = pendingRecordedRegionCount;
+		pendingRecordedRegionCount = 0;
+		regionCount = 0;
+		return token;
+	}
+
+	/** @brief True if no copies have been added since the last submit */
+	bool UploadBatch::empty() const
+	{
+		return bufferCopies.empty() && imageCopies.empty() && imageTargets.empty();
+	}
+
+	void UploadBatch::addImageTarget(VkImage image, const VkImageSubresourceRange& subresourceRange, VkImageLayout finalLayout)
+	{
+		auto it = imageTargets.find(image);
+		if (it == imageTargets.end()) {
+			imageTargets[image] = { subresourceRange, finalLayout, false };
+			return;
+		}
+		// Several copies into the same image share its transitions, which have to cover all of them
+		VkImageSubresourceRange& range = it->second.subresourceRange;
+		const uint32_t mipEnd = std::max(range.baseMipLevel + range.levelCount, subresourceRange.baseMipLevel + subresourceRange.levelCount);
+		const uint32_t layerEnd = std::max(range.baseArrayLayer + range.layerCount, subresourceRange.baseArrayLayer + subresourceRange.layerCount);
+		range.aspectMask |= subresourceRange.aspectMask;
+		range.baseMipLevel = std::min(range.baseMipLevel, subresourceRange.baseMipLevel);
+		range.baseArrayLayer = std::min(range.baseArrayLayer, subresourceRange.baseArrayLayer);
+		range.levelCount = mipEnd - range.baseMipLevel;
+		range.layerCount = layerEnd - range.baseArrayLayer;
+		it->second.finalLayout = finalLayout;
+	}
+
+	/** @brief Allocate staging space, if the ring is full the copies collected so far are recorded and submitted first so their space can be recycled */
+	vks::StagingRing::Region UploadBatch::allocate(VkDeviceSize size, VkDeviceSize alignment)
+	{
+		vks::StagingRing::Region region;
+		if (!stagingRing->tryAllocate(size, alignment, &region, &hold)) {
+			stagingRing->submitBatch(&hold, [this](VkCommandBuffer commandBuffer) { record(commandBuffer, false); });
+			region = stagingRing->allocate(size, alignment, &hold);
+		}
+		return region;
+	}
+
+	/**
+	* Record the collected copies
+	*
+	* @param commandBuffer Command buffer of the batch's submission
+	* @param finish Also transition the images to their final layout, partial recordings leave them in TRANSFER_DST_OPTIMAL for further copies
+	*/
+	void UploadBatch::record(VkCommandBuffer commandBuffer, bool finish)
+	{
+		// A single barrier moves all images that haven't been yet to the transfer layout
+		std::vector<VkImageMemoryBarrier> barriers;
+		for (auto& target : imageTargets) {
+			if (!target.second.transferLayout) {
+				VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
+				barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				barrier.srcAccessMask = 0;
+				barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.image = target.first;
+				barrier.subresourceRange = target.second.subresourceRange;
+				barriers.push_back(barrier);
+				target.second.transferLayout = true;
+			}
+		}
+		if (!barriers.empty()) {
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+		}
+
+		// One copy command per source and destination pair, with regions that continue each other in both buffers merged
+		for (auto& copies : bufferCopies) {
+			std::vector<VkBufferCopy>& regions = copies.second;
+			std::sort(regions.begin(), regions.end(), [](const VkBufferCopy& a, const VkBufferCopy& b) { return a.dstOffset < b.dstOffset; });
+			size_t merged = 0;
+			for (size_t i = 1; i < regions.size(); i++) {
+				VkBufferCopy& last = regions[merged];
+				if ((last.srcOffset + last.size == regions[i].srcOffset) && (last.dstOffset + last.size == regions[i].dstOffset)) {
+					last.size += regions[i].size;
+				}
+				else {
+					regions[++merged] = regions[i];
+				}
+			}
+			regions.resize(merged + 1);
+			vkCmdCopyBuffer(commandBuffer, copies.first.first, copies.first.second, static_cast<uint32_t>(regions.size()), regions.data());
+			pendingRecordedRegionCount += static_cast<uint32_t>(regions.size());
+		}
+		bufferCopies.clear();
+
+		for (auto& copies : imageCopies) {
+			vkCmdCopyBufferToImage(commandBuffer, copies.first.first, copies.first.second, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copies.second.size()), copies.second.data());
+			pendingRecordedRegionCount += static_cast<uint32_t>(copies.second.size());
+		}
+		imageCopies.clear();
+
+		if (!finish) {
+			return;
+		}
+
+		// And a single barrier moves them to the layouts they are used in, releasing them to the queue family using them if that is a different one.
+		// Shared buffers need no release, the using family's semaphore wait on the batch makes the copies visible
+		const bool release = (dstQueueFamilyIndex != VK_QUEUE_FAMILY_IGNORED);
+		barriers.clear();
+		for (auto& target : imageTargets) {
+			VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = target.second.finalLayout;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = release ? 0 : VK_ACCESS_MEMORY_READ_BIT;
+			barrier.image = target.first;
+			barrier.subresourceRange = target.second.subresourceRange;
+			if (release) {
+				barrier.srcQueueFamilyIndex = stagingRing->queueFamilyIndex;
+				barrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
+				// The acquire has to repeat the layout transition, its access masks describe the acquiring side
+				VkImageMemoryBarrier acquire = barrier;
+				acquire.srcAccessMask = 0;
+				acquire.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+				imageAcquireBarriers.push_back(acquire);
+			}
+			barriers.push_back(barrier);
+		}
+		if (!barriers.empty()) {
+			// Release barriers have no second scope on the releasing queue, the acquiring queue's semaphore wait provides it
+			const VkPipelineStageFlags dstStageMask = release ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+		}
+		imageTargets.clear();
+	}
+}
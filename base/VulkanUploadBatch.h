@@ -0,0 +1,113 @@
+/*
+* Upload batch
+*
+* Collects buffer and image copies for many resources and submits them at once
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanTimeline.h"
+#include "VulkanStagingRing.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* @brief Completion of submitted uploads, a value on the timeline of the queue that executes them
+	*
+	* Cheap to copy and to poll, the uploaded resources can be used by other queues once the value has been reached
+	* (or by waiting for it with vks::TimelineSubmit::waitTimeline)
+	*/
+	struct UploadToken
+	{
+		vks::Timeline* timeline = nullptr;
+		uint64_t value = 0;
+
+		/** @brief True once the uploads have finished executing (always true for an empty token) */
+		bool done() const
+		{
+			return (timeline == nullptr) || timeline->reached(value);
+		}
+		/** @brief Block until the uploads have finished */
+		void wait() const
+		{
+			if (timeline != nullptr) {
+				VK_CHECK_RESULT(timeline->wait(value));
+			}
+		}
+	};
+
+	/**
+	* @brief Batches copies to buffers and images into a single submission
+	*
+	* Copies are only collected while the batch is filled. submit() records them grouped by source and destination,
+	* merges buffer regions that are adjacent in both source and destination, wraps all image copies into one barrier
+	* before (to TRANSFER_DST_OPTIMAL) and one after (to each image's final layout), and submits everything in a command
+	* buffer of its own on the staging ring's queue without waiting. Data passed by pointer is written into the staging
+	* ring right away, the batch's regions are held until its own submission has finished (flushing the ring doesn't
+	* recycle them)
+	*
+	* If the batch is executed on a queue family other than the one using the resources (e.g. a dedicated transfer queue), the
+	* final barriers release the images to the using family and submit() fills the barriers that family has to record to
+	* acquire them (see vks::AsyncUploader). Images are uploaded completely, so they never have to be released back first.
+	* Buffers are written in parts (e.g. a mesh added to a vks::GeometryPool the graphics queue already draws from), so
+	* buffers written on another family have to be created with VulkanDevice::createSharedBuffer and are not transferred
+	*
+	* @note Destination ranges of a batch must not overlap and copies must not depend on each other.
+	* Image contents are discarded by the transition to TRANSFER_DST_OPTIMAL, so images have to be uploaded completely
+	*/
+	class UploadBatch
+	{
+	public:
+		explicit UploadBatch(vks::VulkanDevice* device);
+		UploadBatch(vks::StagingRing* stagingRing, uint32_t dstQueueFamilyIndex);
+		~UploadBatch();
+		// The staging ring keeps a pointer to the batch's hold
+		UploadBatch(const UploadBatch&) = delete;
+		UploadBatch& operator=(const UploadBatch&) = delete;
+
+		void copyBuffer(VkBuffer src, VkBuffer dst, const VkBufferCopy& region);
+		void upload(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+		void copyBufferToImage(VkBuffer src, VkImage dst, const VkBufferImageCopy& region, const VkImageSubresourceRange& subresourceRange, VkImageLayout finalLayout);
+		void uploadImage(VkImage dst, const void* data, VkDeviceSize size, const std::vector<VkBufferImageCopy>& regions, const VkImageSubresourceRange& subresourceRange, VkImageLayout finalLayout);
+		UploadToken submit();
+
+		bool empty() const;
+		/** @brief Number of copy regions added since the last submit */
+		uint32_t regionCount = 0;
+		/** @brief Number of regions recorded by the last submit after merging */
+		uint32_t recordedRegionCount = 0;
+		/** @brief Ownership acquire barriers for the images of the last submit, empty if no ownership transfer is needed */
+		std::vector<VkImageMemoryBarrier> imageAcquireBarriers;
+
+	private:
+		struct ImageTarget {
+			VkImageSubresourceRange subresourceRange;
+			VkImageLayout finalLayout;
+			/** @brief Already moved to TRANSFER_DST_OPTIMAL by an earlier partial recording */
+			bool transferLayout;
+		};
+		vks::StagingRing* stagingRing;
+		/** @brief Staging ring space of the data added since the last submission */
+		vks::StagingRing::Hold hold;
+		/** @brief Family the resources are released to, VK_QUEUE_FAMILY_IGNORED if they are used on the staging ring's family */
+		uint32_t dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		std::map<std::pair<VkBuffer, VkBuffer>, std::vector<VkBufferCopy>> bufferCopies;
+		std::map<std::pair<VkBuffer, VkImage>, std::vector<VkBufferImageCopy>> imageCopies;
+		std::map<VkImage, ImageTarget> imageTargets;
+		uint32_t pendingRecordedRegionCount = 0;
+
+		void record(VkCommandBuffer commandBuffer, bool finish);
+		void addImageTarget(VkImage image, const VkImageSubresourceRange& subresourceRange, VkImageLayout finalLayout);
+		vks::StagingRing::Region allocate(VkDeviceSize size, VkDeviceSize alignment);
+	};
+}
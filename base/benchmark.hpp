@@ -14,6 +14,7 @@
 #include <chrono>
 #include <iomanip>
 #include <numeric>
+#include <cmath>
 
 
 namespace vks
@@ -22,6 +23,8 @@ namespace vks
 	private:
 		FILE *stream;
 		VkPhysicalDeviceProperties deviceProps;
+		/** @brief Set during the benchmark phase (after warmup) */
+		bool measuring = false;
 	public:
 		bool active = false;
 		bool outputFrameTimes = false;
@@ -33,6 +36,228 @@ namespace vks
 
 		double runtime = 0.0;
 		uint32_t frameCount = 0;
+		/** @brief Time from prepare() to the first frame in ms, and whether the pipeline cache was loaded from disk */
+		double startupTime = 0.0;
+		bool warmPipelineCache = false;
+		/** @brief Pipeline lookups through vks::PipelineStateCache that found / didn't find a pipeline */
+		uint64_t pipelineHits = 0;
+		uint64_t pipelineMisses = 0;
+		/** @brief Batches streamed through vks::AsyncUploader, how many made the graphics queue wait and the longest time until one was acquired */
+		uint32_t asyncUploadBatches = 0;
+		uint32_t asyncUploadWaits = 0;
+		double asyncUploadLatency = 0.0;
+		bool asyncUploadDedicated = false;
+		/** @brief Bytes uploaded from mapped files by vks::FileUploader, copied from imported file pages or through the staging ring */
+		uint64_t fileImportedBytes = 0;
+		uint64_t fileStagedBytes = 0;
+		bool fileImportSupported = false;
+
+		/** @brief Throughput measured for a single number of frames in flight */
+		struct FramesInFlightResult {
+			uint32_t framesInFlight;
+			double runtime;
+			uint32_t frameCount;
+			double frameTimeStdDev;
+		};
+		std::vector<FramesInFlightResult> framesInFlightResults;
+
+		/** @brief Command buffer recording time measured for a single number of recording threads */
+		struct RecordingResult {
+			uint32_t threadCount;
+			double recordTime;
+			double runtime;
+			uint32_t frameCount;
+		};
+		std::vector<RecordingResult> recordingResults;
+
+		/** @brief Result of a micro benchmark that doesn't render frames */
+		struct MicroResult {
+			std::string name;
+			uint64_t operations;
+			double runtime;
+			/** @brief Spread and worst case of the time of a single call in ms, for comparing the variance of implementations */
+			double callStdDev;
+			double callMax;
+		};
+		std::vector<MicroResult> microResults;
+
+		/** @brief GPU time of a profiled pass, accumulated over the benchmark phases */
+		struct GpuPassResult {
+			std::string name;
+			double total;
+			double min;
+			double max;
+			uint32_t samples;
+		};
+		std::vector<GpuPassResult> gpuPassResults;
+
+		/** @brief Device memory use of a heap, peaks over the benchmark phases */
+		struct MemoryHeapResult {
+			uint32_t heapIndex;
+			VkDeviceSize budget;
+			VkDeviceSize peakUsage;
+			/** @brief Peak bytes in use per vks::MemoryTag */
+			std::vector<VkDeviceSize> peakTaggedSize;
+		};
+		std::vector<MemoryHeapResult> memoryHeapResults;
+
+		/** @brief Driver host allocations of an allocation scope (see vks::HostAllocator), accumulated over the benchmark phases */
+		struct HostAllocationResult {
+			uint32_t scope;
+			uint64_t allocations;
+			uint64_t bytes;
+			/** @brief Most allocations in a single frame */
+			uint64_t maxFrameAllocations;
+			uint64_t peakBytes;
+			uint32_t frames;
+		};
+		std::vector<HostAllocationResult> hostAllocationResults;
+
+		/** @brief Standard deviation of a list of times */
+		static double standardDeviation(const std::vector<double>& times) {
+			if (times.empty()) {
+				return 0.0;
+			}
+			const double mean = std::accumulate(times.begin(), times.end(), 0.0) / times.size();
+			double sumSquares = 0.0;
+			for (double time : times) {
+				sumSquares += (time - mean) * (time - mean);
+			}
+			return std::sqrt(sumSquares / times.size());
+		}
+
+		/**
+		* Sets the startup time for the results
+		*
+		* @param milliseconds Time from prepare() to the first frame
+		* @param warmPipelineCache True if pipelines came from a pipeline cache loaded from disk
+		*/
+		void setStartupTime(double milliseconds, bool warmPipelineCache) {
+			startupTime = milliseconds;
+			this->warmPipelineCache = warmPipelineCache;
+		}
+
+		/**
+		* Sets the pipeline lookup counts for the results and prints the hit rate
+		*
+		* @param hits Lookups answered with an already requested pipeline
+		* @param misses Lookups that compiled a new pipeline
+		*/
+		void setPipelineRequests(uint64_t hits, uint64_t misses) {
+			pipelineHits = hits;
+			pipelineMisses = misses;
+			if (hits + misses > 0) {
+				std::cout << "pipeline lookups: " << (hits + misses) << " (" << 100.0 * hits / (hits + misses) << " % hits)" << "\n";
+			}
+		}
+
+		/**
+		* Sets the asynchronous upload counts for the results and prints them
+		*
+		* @param batches Batches submitted through the uploader
+		* @param waits Batches the graphics queue had to wait for
+		* @param latency Longest time in ms from submitting a batch until its resources were acquired
+		* @param dedicated True if the batches ran on a dedicated transfer queue, else they ran on the graphics queue and never needed acquiring
+		*/
+		void setAsyncUploads(uint32_t batches, uint32_t waits, double latency, bool dedicated) {
+			asyncUploadBatches = batches;
+			asyncUploadWaits = waits;
+			asyncUploadLatency = latency;
+			asyncUploadDedicated = dedicated;
+			if (batches > 0) {
+				if (dedicated) {
+					std::cout << "async uploads: " << batches << " batches on the transfer queue, " << waits << " graphics queue waits, " << latency << " ms max until acquired" << "\n";
+				}
+				else {
+					std::cout << "async uploads: " << batches << " batches on the graphics queue (no dedicated transfer queue family)" << "\n";
+				}
+			}
+		}
+
+		/**
+		* Sets the bytes uploaded from mapped files for the results and prints them
+		*
+		* @param importedBytes Bytes copied straight from imported file pages
+		* @param stagedBytes Bytes that went through the staging ring
+		* @param importSupported True if the device can import host memory at all
+		*/
+		void setFileUploads(uint64_t importedBytes, uint64_t stagedBytes, bool importSupported) {
+			fileImportedBytes = importedBytes;
+			fileStagedBytes = stagedBytes;
+			fileImportSupported = importSupported;
+			if (importedBytes + stagedBytes > 0) {
+				std::cout << "file uploads: " << importedBytes << " bytes imported, " << stagedBytes << " bytes staged" << (importSupported ? "" : " (no host memory import)") << "\n";
+			}
+		}
+
+		/**
+		* Adds a GPU time sample for a pass (e.g. from vks::GpuProfiler), samples taken during warmup are ignored
+		*
+		* @param name Name of the pass
+		* @param milliseconds GPU time of the pass in a single frame
+		*/
+		void addGpuPassTime(const std::string& name, double milliseconds) {
+			if (!measuring) {
+				return;
+			}
+			auto pass = std::find_if(gpuPassResults.begin(), gpuPassResults.end(), [&](const GpuPassResult& result) { return result.name == name; });
+			if (pass == gpuPassResults.end()) {
+				gpuPassResults.push_back({ name, 0.0, std::numeric_limits<double>::max(), 0.0, 0 });
+				pass = gpuPassResults.end() - 1;
+			}
+			pass->total += milliseconds;
+			pass->min = std::min(pass->min, milliseconds);
+			pass->max = std::max(pass->max, milliseconds);
+			pass->samples++;
+		}
+
+		/**
+		* Adds the driver host allocations of a scope made during a single frame, samples taken during warmup are ignored
+		*
+		* @param scope Allocation scope (VkSystemAllocationScope)
+		* @param allocations Number of allocations since the last frame
+		* @param bytes Bytes allocated since the last frame
+		* @param peakBytes High-water mark of the scope's allocated bytes
+		*/
+		void addHostAllocations(uint32_t scope, uint64_t allocations, uint64_t bytes, uint64_t peakBytes) {
+			if (!measuring) {
+				return;
+			}
+			auto result = std::find_if(hostAllocationResults.begin(), hostAllocationResults.end(), [&](const HostAllocationResult& entry) { return entry.scope == scope; });
+			if (result == hostAllocationResults.end()) {
+				hostAllocationResults.push_back({ scope, 0, 0, 0, 0, 0 });
+				result = hostAllocationResults.end() - 1;
+			}
+			result->allocations += allocations;
+			result->bytes += bytes;
+			result->maxFrameAllocations = std::max(result->maxFrameAllocations, allocations);
+			result->peakBytes = std::max(result->peakBytes, peakBytes);
+			result->frames++;
+		}
+
+		/**
+		* Adds a memory usage sample for a heap, samples taken during warmup are ignored
+		*
+		* @param heapIndex Index of the memory heap
+		* @param usage Bytes of the heap in use
+		* @param budget Bytes of the heap available to the process
+		* @param taggedSize Bytes allocated per vks::MemoryTag
+		*/
+		void addMemoryUsage(uint32_t heapIndex, VkDeviceSize usage, VkDeviceSize budget, const std::vector<VkDeviceSize>& taggedSize) {
+			if (!measuring) {
+				return;
+			}
+			auto heap = std::find_if(memoryHeapResults.begin(), memoryHeapResults.end(), [&](const MemoryHeapResult& result) { return result.heapIndex == heapIndex; });
+			if (heap == memoryHeapResults.end()) {
+				memoryHeapResults.push_back({ heapIndex, budget, 0, std::vector<VkDeviceSize>(taggedSize.size(), 0) });
+				heap = memoryHeapResults.end() - 1;
+			}
+			heap->budget = budget;
+			heap->peakUsage = std::max(heap->peakUsage, usage);
+			for (size_t i = 0; i < taggedSize.size(); i++) {
+				heap->peakTaggedSize[i] = std::max(heap->peakTaggedSize[i], taggedSize[i]);
+			}
+		}
 
 		void run(std::function<void()> renderFunc, VkPhysicalDeviceProperties deviceProps) {
 			active = true;
@@ -57,6 +282,7 @@ namespace vks
 
 			// Benchmark phase
 			{
+				measuring = true;
 				while (runtime < (duration * 1000.0)) {
 					auto tStart = std::chrono::high_resolution_clock::now();
 					renderFunc();
@@ -66,12 +292,127 @@ namespace vks
 					frameCount++;
 					if (outputFrames != -1 && outputFrames == frameCount) break;
 				};
+				measuring = false;
 				std::cout << "Benchmark finished" << "\n";
 				std::cout << "device : " << deviceProps.deviceName << " (driver version: " << deviceProps.driverVersion << ")" << "\n";
 				std::cout << "runtime: " << (runtime / 1000.0) << "\n";
 				std::cout << "frames : " << frameCount << "\n";
 				std::cout << "fps    : " << frameCount / (runtime / 1000.0) << "\n";
+				std::cout << "stddev : " << standardDeviation(frameTimes) << " ms" << "\n";
+				// The same telemetry the overlay shows, which is disabled in benchmark and headless runs
+				for (auto& pass : gpuPassResults) {
+					std::cout << "gpu    : " << pass.name << " " << pass.total / pass.samples << " ms (min " << pass.min << ", max " << pass.max << ")" << "\n";
+				}
+				for (auto& heap : memoryHeapResults) {
+					std::cout << "heap " << heap.heapIndex << " : " << (heap.peakUsage >> 20) << " / " << (heap.budget >> 20) << " MB peak" << "\n";
+					for (uint32_t tag = 0; tag < heap.peakTaggedSize.size(); tag++) {
+						if (heap.peakTaggedSize[tag] > 0) {
+							std::cout << "         " << vks::memoryTagName(static_cast<vks::MemoryTag>(tag)) << " " << heap.peakTaggedSize[tag] / 1048576.0 << " MB peak" << "\n";
+						}
+					}
+				}
+				for (auto& host : hostAllocationResults) {
+					std::cout << "host   : " << vks::allocationScopeName(host.scope) << " " << static_cast<double>(host.allocations) / host.frames << " allocs/frame (max " << host.maxFrameAllocations << "), "
+						<< static_cast<double>(host.bytes) / host.frames << " bytes/frame, " << (host.peakBytes >> 10) << " KB peak" << "\n";
+				}
+			}
+		}
+
+		/**
+		* Runs the benchmark once for every frame ring depth and reports the throughput of each
+		*
+		* @param depths List of frames in flight counts to measure
+		* @param setDepth Called before each run to switch the sample to the given number of frames in flight
+		* @param renderFunc Renders a single frame
+		* @param deviceProps Properties of the device the benchmark runs on
+		*/
+		void runFramesInFlight(std::vector<uint32_t> depths, std::function<void(uint32_t)> setDepth, std::function<void()> renderFunc, VkPhysicalDeviceProperties deviceProps) {
+			framesInFlightResults.clear();
+			for (auto depth : depths) {
+				setDepth(depth);
+				runtime = 0.0;
+				frameCount = 0;
+				frameTimes.clear();
+				std::cout << "frames in flight: " << depth << "\n";
+				run(renderFunc, deviceProps);
+				framesInFlightResults.push_back({ depth, runtime, frameCount, standardDeviation(frameTimes) });
 			}
+			std::cout << "\n" << "frames in flight | fps | stddev (ms)" << "\n";
+			for (auto& result : framesInFlightResults) {
+				std::cout << std::setw(16) << result.framesInFlight << " | " << result.frameCount / (result.runtime / 1000.0) << " | " << result.frameTimeStdDev << "\n";
+			}
+		}
+
+		/**
+		* Runs the benchmark once for every number of recording threads and reports the average time spent recording a frame
+		*
+		* @param threadCounts List of recording thread counts to measure
+		* @param setThreadCount Called before each run to switch the sample to the given number of recording threads
+		* @param renderFunc Renders a single frame
+		* @param recordTime Returns the time in milliseconds spent recording the last frame
+		* @param deviceProps Properties of the device the benchmark runs on
+		*/
+		void runRecording(std::vector<uint32_t> threadCounts, std::function<void(uint32_t)> setThreadCount, std::function<void()> renderFunc, std::function<double()> recordTime, VkPhysicalDeviceProperties deviceProps) {
+			recordingResults.clear();
+			for (auto threadCount : threadCounts) {
+				setThreadCount(threadCount);
+				runtime = 0.0;
+				frameCount = 0;
+				frameTimes.clear();
+				std::vector<double> recordTimes;
+				std::cout << "recording threads: " << threadCount << "\n";
+				run([&] {
+					renderFunc();
+					recordTimes.push_back(recordTime());
+				}, deviceProps);
+				// Only the frames of the benchmark phase are averaged, the warmup frames come first
+				double recordTimeSum = std::accumulate(recordTimes.end() - frameCount, recordTimes.end(), 0.0);
+				recordingResults.push_back({ threadCount, recordTimeSum / std::max(frameCount, 1u), runtime, frameCount });
+			}
+			std::cout << "\n" << "recording threads | record (ms) | fps" << "\n";
+			for (auto& result : recordingResults) {
+				std::cout << std::setw(17) << result.threadCount << " | " << std::setw(11) << result.recordTime << " | " << result.frameCount / (result.runtime / 1000.0) << "\n";
+			}
+		}
+
+		/**
+		* Runs a micro benchmark (e.g. of a framework subsystem) for the configured warmup and duration times
+		*
+		* @param name Name of the benchmark in the results
+		* @param operationsPerCall Number of operations a single call of func performs
+		* @param func Function executing the operations
+		* @param deviceProps Properties of the device the benchmark runs on
+		*/
+		void runMicro(const std::string& name, uint64_t operationsPerCall, std::function<void()> func, VkPhysicalDeviceProperties deviceProps) {
+			active = true;
+			this->deviceProps = deviceProps;
+#if defined(_WIN32)
+			AttachConsole(ATTACH_PARENT_PROCESS);
+			freopen_s(&stream, "CONOUT$", "w+", stdout);
+			freopen_s(&stream, "CONOUT$", "w+", stderr);
+#endif
+			std::cout << std::fixed << std::setprecision(3);
+			double tMeasured = 0.0;
+			while (tMeasured < (warmup * 1000)) {
+				auto tStart = std::chrono::high_resolution_clock::now();
+				func();
+				tMeasured += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			}
+			MicroResult result = { name, 0, 0.0, 0.0, 0.0 };
+			std::vector<double> callTimes;
+			while (result.runtime < (duration * 1000.0)) {
+				auto tStart = std::chrono::high_resolution_clock::now();
+				func();
+				const double tCall = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+				result.runtime += tCall;
+				result.operations += operationsPerCall;
+				callTimes.push_back(tCall);
+			}
+			result.callStdDev = standardDeviation(callTimes);
+			result.callMax = *std::max_element(callTimes.begin(), callTimes.end());
+			microResults.push_back(result);
+			std::cout << name << ": " << (result.runtime * 1000000.0) / result.operations << " ns/op, " << result.operations / (result.runtime / 1000.0) << " ops/s, "
+				<< result.callStdDev * 1000.0 << " us stddev, " << result.callMax * 1000.0 << " us max per call" << "\n";
 		}
 
 		void saveResults() {
@@ -82,6 +423,74 @@ namespace vks
 				result << "device,driverversion,duration (ms),frames,fps" << "\n";
 				result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0) << "\n";
 
+				result << "\n" << "startup (ms),pipeline cache" << "\n";
+				result << startupTime << "," << (warmPipelineCache ? "warm" : "cold") << "\n";
+
+				result << "\n" << "pipeline lookups,hits,misses,hit rate (%)" << "\n";
+				result << (pipelineHits + pipelineMisses) << "," << pipelineHits << "," << pipelineMisses << "," << ((pipelineHits + pipelineMisses > 0) ? 100.0 * pipelineHits / (pipelineHits + pipelineMisses) : 0.0) << "\n";
+
+				if (asyncUploadBatches > 0) {
+					result << "\n" << "async upload batches,queue,graphics queue waits,max latency (ms)" << "\n";
+					result << asyncUploadBatches << "," << (asyncUploadDedicated ? "transfer" : "graphics") << "," << asyncUploadWaits << "," << asyncUploadLatency << "\n";
+				}
+
+				if (fileImportedBytes + fileStagedBytes > 0) {
+					result << "\n" << "file upload bytes imported,bytes staged,host memory import" << "\n";
+					result << fileImportedBytes << "," << fileStagedBytes << "," << (fileImportSupported ? "yes" : "no") << "\n";
+				}
+
+				if (!framesInFlightResults.empty()) {
+					result << "\n" << "frames in flight,duration (ms),frames,fps,frame time stddev (ms)" << "\n";
+					for (auto& depthResult : framesInFlightResults) {
+						result << depthResult.framesInFlight << "," << depthResult.runtime << "," << depthResult.frameCount << "," << depthResult.frameCount / (depthResult.runtime / 1000.0) << "," << depthResult.frameTimeStdDev << "\n";
+					}
+				}
+
+				if (!recordingResults.empty()) {
+					result << "\n" << "recording threads,record (ms),duration (ms),frames,fps" << "\n";
+					for (auto& recordingResult : recordingResults) {
+						result << recordingResult.threadCount << "," << recordingResult.recordTime << "," << recordingResult.runtime << "," << recordingResult.frameCount << "," << recordingResult.frameCount / (recordingResult.runtime / 1000.0) << "\n";
+					}
+				}
+
+				if (!microResults.empty()) {
+					result << "\n" << "micro benchmark,operations,duration (ms),ns/op,ops/s,call stddev (ms),call max (ms)" << "\n";
+					for (auto& microResult : microResults) {
+						result << microResult.name << "," << microResult.operations << "," << microResult.runtime << "," << (microResult.runtime * 1000000.0) / microResult.operations << "," << microResult.operations / (microResult.runtime / 1000.0)
+							<< "," << microResult.callStdDev << "," << microResult.callMax << "\n";
+					}
+				}
+
+				if (!gpuPassResults.empty()) {
+					result << "\n" << "gpu pass,avg (ms),min (ms),max (ms),samples" << "\n";
+					for (auto& pass : gpuPassResults) {
+						result << pass.name << "," << pass.total / pass.samples << "," << pass.min << "," << pass.max << "," << pass.samples << "\n";
+					}
+				}
+
+				if (!memoryHeapResults.empty()) {
+					result << "\n" << "memory heap,budget (MB),peak usage (MB)";
+					for (uint32_t tag = 0; tag < vks::memoryTagCount; tag++) {
+						result << "," << vks::memoryTagName(static_cast<vks::MemoryTag>(tag)) << " (MB)";
+					}
+					result << "\n";
+					for (auto& heap : memoryHeapResults) {
+						result << heap.heapIndex << "," << heap.budget / 1048576.0 << "," << heap.peakUsage / 1048576.0;
+						for (auto& taggedSize : heap.peakTaggedSize) {
+							result << "," << taggedSize / 1048576.0;
+						}
+						result << "\n";
+					}
+				}
+
+				if (!hostAllocationResults.empty()) {
+					result << "\n" << "host allocation scope,allocations/frame,max allocations/frame,bytes/frame,peak (KB)" << "\n";
+					for (auto& host : hostAllocationResults) {
+						result << vks::allocationScopeName(host.scope) << "," << static_cast<double>(host.allocations) / host.frames << "," << host.maxFrameAllocations << ","
+							<< static_cast<double>(host.bytes) / host.frames << "," << host.peakBytes / 1024.0 << "\n";
+					}
+				}
+
 				if (outputFrameTimes) {
 					result << "\n" << "frame,ms" << "\n";
 					for (size_t i = 0; i < frameTimes.size(); i++) {
@@ -0,0 +1,36 @@
+# Writes a SPIR-V binary as a constexpr uint32_t array, run in script mode:
+# cmake -DINPUT=<file.spv> -DOUTPUT=<file.spv.h> -DSYMBOL=<array name> -P SpirvToHeader.cmake
+
+file(READ "${INPUT}" SPIRV_HEX HEX)
+string(LENGTH "${SPIRV_HEX}" SPIRV_HEX_LENGTH)
+math(EXPR SPIRV_WORD_REMAINDER "${SPIRV_HEX_LENGTH} % 8")
+if (SPIRV_HEX_LENGTH EQUAL 0 OR NOT SPIRV_WORD_REMAINDER EQUAL 0)
+	message(FATAL_ERROR "${INPUT} is not a SPIR-V binary")
+endif()
+
+# SPIR-V is a stream of little endian words, eight words per line
+string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1u, " SPIRV_WORDS "${SPIRV_HEX}")
+set(SPIRV_LINE "0x........u, 0x........u, 0x........u, 0x........u, 0x........u, 0x........u, 0x........u, 0x........u, ")
+string(REGEX REPLACE "(${SPIRV_LINE})" "\\1\n\t\t\t" SPIRV_WORDS "${SPIRV_WORDS}")
+string(REGEX REPLACE " \n" "\n" SPIRV_WORDS "${SPIRV_WORDS}")
+string(STRIP "${SPIRV_WORDS}" SPIRV_WORDS)
+
+file(WRITE "${OUTPUT}.tmp"
+"// Generated from ${INPUT} by SpirvToHeader.cmake, do not edit\n"
+"\n"
+"#pragma once\n"
+"\n"
+"#include <stdint.h>\n"
+"\n"
+"namespace vks\n"
+"{\n"
+"\tnamespace shaders\n"
+"\t{\n"
+"\t\tconstexpr uint32_t ${SYMBOL}[] = {\n"
+"\t\t\t${SPIRV_WORDS}\n"
+"\t\t};\n"
+"\t}\n"
+"}\n")
+# Only touch the header if the code changed, everything including it would be rebuilt otherwise
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy_if_different "${OUTPUT}.tmp" "${OUTPUT}")
+file(REMOVE "${OUTPUT}.tmp")
@@ -0,0 +1,142 @@
+/*
+* Staging ring test
+*
+* Runs the staging ring against stubbed Vulkan entry points, the timeline is advanced by hand to finish batches in a chosen order
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanDevice.h"
+#include "VulkanStagingRing.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define CHECK(condition) if (!(condition)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); return EXIT_FAILURE; }
+
+namespace
+{
+	// Value the stubbed timeline semaphore has reached, the "device" finishes batches only when the test says so
+	uint64_t reachedValue = 0;
+	uintptr_t nextHandle = 0x1000;
+
+	template<typename T>
+	T newHandle()
+	{
+		T handle;
+		const uint64_t value = nextHandle += 0x10;
+		memcpy(&handle, &value, sizeof(handle));
+		return handle;
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL getSemaphoreCounterValue(VkDevice, VkSemaphore, uint64_t* value)
+	{
+		*value = reachedValue;
+		return VK_SUCCESS;
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL waitSemaphores(VkDevice, const VkSemaphoreWaitInfo* waitInfo, uint64_t)
+	{
+		return (reachedValue >= waitInfo->pValues[0]) ? VK_SUCCESS : VK_TIMEOUT;
+	}
+}
+
+// Only what device, allocator, timeline and ring call, with a single host visible and coherent memory type
+extern "C"
+{
+	VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties(VkPhysicalDevice, VkPhysicalDeviceProperties* properties) { *properties = {}; properties->limits.nonCoherentAtomSize = 64; properties->limits.bufferImageGranularity = 1; }
+	VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceFeatures(VkPhysicalDevice, VkPhysicalDeviceFeatures* features) { *features = {}; }
+	VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties(VkPhysicalDevice, VkPhysicalDeviceMemoryProperties* properties)
+	{
+		*properties = {};
+		properties->memoryTypeCount = 1;
+		properties->memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		properties->memoryHeapCount = 1;
+		properties->memoryHeaps[0].size = 256 * 1024 * 1024;
+	}
+	VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceQueueFamilyProperties(VkPhysicalDevice, uint32_t* count, VkQueueFamilyProperties* properties)
+	{
+		if (properties) { *properties = {}; properties->queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_TRANSFER_BIT; properties->queueCount = 1; }
+		*count = 1;
+	}
+	VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceExtensionProperties(VkPhysicalDevice, const char*, uint32_t* count, VkExtensionProperties*) { *count = 0; return VK_SUCCESS; }
+	VKAPI_ATTR VkResult VKAPI_CALL vkCreateBuffer(VkDevice, const VkBufferCreateInfo*, const VkAllocationCallbacks*, VkBuffer* buffer) { *buffer = newHandle<VkBuffer>(); return VK_SUCCESS; }
+	VKAPI_ATTR void VKAPI_CALL vkDestroyBuffer(VkDevice, VkBuffer, const VkAllocationCallbacks*) {}
+	VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements(VkDevice, VkBuffer, VkMemoryRequirements* requirements) { requirements->size = 4096; requirements->alignment = 256; requirements->memoryTypeBits = 1; }
+	VKAPI_ATTR VkResult VKAPI_CALL vkAllocateMemory(VkDevice, const VkMemoryAllocateInfo* allocateInfo, const VkAllocationCallbacks*, VkDeviceMemory* memory)
+	{
+		void* data = calloc(1, static_cast<size_t>(allocateInfo->allocationSize));
+		memcpy(memory, &data, sizeof(data));
+		return VK_SUCCESS;
+	}
+	VKAPI_ATTR void VKAPI_CALL vkFreeMemory(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks*) { void* data; memcpy(&data, &memory, sizeof(data)); free(data); }
+	VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(VkDevice, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize, VkMemoryMapFlags, void** data) { uint8_t* base; memcpy(&base, &memory, sizeof(base)); *data = base + offset; return VK_SUCCESS; }
+	VKAPI_ATTR void VKAPI_CALL vkUnmapMemory(VkDevice, VkDeviceMemory) {}
+	VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory(VkDevice, VkBuffer, VkDeviceMemory, VkDeviceSize) { return VK_SUCCESS; }
+	VKAPI_ATTR VkResult VKAPI_CALL vkCreateCommandPool(VkDevice, const VkCommandPoolCreateInfo*, const VkAllocationCallbacks*, VkCommandPool* pool) { *pool = newHandle<VkCommandPool>(); return VK_SUCCESS; }
+	VKAPI_ATTR void VKAPI_CALL vkDestroyCommandPool(VkDevice, VkCommandPool, const VkAllocationCallbacks*) {}
+	VKAPI_ATTR VkResult VKAPI_CALL vkAllocateCommandBuffers(VkDevice, const VkCommandBufferAllocateInfo*, VkCommandBuffer* commandBuffer) { *commandBuffer = reinterpret_cast<VkCommandBuffer>(nextHandle += 0x10); return VK_SUCCESS; }
+	VKAPI_ATTR VkResult VKAPI_CALL vkBeginCommandBuffer(VkCommandBuffer, const VkCommandBufferBeginInfo*) { return VK_SUCCESS; }
+	VKAPI_ATTR VkResult VKAPI_CALL vkEndCommandBuffer(VkCommandBuffer) { return VK_SUCCESS; }
+	VKAPI_ATTR void VKAPI_CALL vkCmdPipelineBarrier(VkCommandBuffer, VkPipelineStageFlags, VkPipelineStageFlags, VkDependencyFlags, uint32_t, const VkMemoryBarrier*, uint32_t, const VkBufferMemoryBarrier*, uint32_t, const VkImageMemoryBarrier*) {}
+	VKAPI_ATTR void VKAPI_CALL vkCmdCopyBuffer(VkCommandBuffer, VkBuffer, VkBuffer, uint32_t, const VkBufferCopy*) {}
+	VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(VkQueue, uint32_t, const VkSubmitInfo*, VkFence) { return VK_SUCCESS; }
+	VKAPI_ATTR VkResult VKAPI_CALL vkCreateSemaphore(VkDevice, const VkSemaphoreCreateInfo*, const VkAllocationCallbacks*, VkSemaphore* semaphore) { *semaphore = newHandle<VkSemaphore>(); return VK_SUCCESS; }
+	VKAPI_ATTR void VKAPI_CALL vkDestroySemaphore(VkDevice, VkSemaphore, const VkAllocationCallbacks*) {}
+	VKAPI_ATTR VkResult VKAPI_CALL vkFlushMappedMemoryRanges(VkDevice, uint32_t, const VkMappedMemoryRange*) { return VK_SUCCESS; }
+	VKAPI_ATTR VkResult VKAPI_CALL vkInvalidateMappedMemoryRanges(VkDevice, uint32_t, const VkMappedMemoryRange*) { return VK_SUCCESS; }
+	VKAPI_ATTR void VKAPI_CALL vkFreeCommandBuffers(VkDevice, VkCommandPool, uint32_t, const VkCommandBuffer*) {}
+	VKAPI_ATTR void VKAPI_CALL vkDestroyDevice(VkDevice, const VkAllocationCallbacks*) {}
+
+	// Linked in with the rest of the framework, but never reached by the ring
+	VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(VkPhysicalDevice, const VkDeviceCreateInfo*, const VkAllocationCallbacks*, VkDevice*) { abort(); }
+	VKAPI_ATTR void VKAPI_CALL vkGetDeviceQueue(VkDevice, uint32_t, uint32_t, VkQueue*) { abort(); }
+	VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetDeviceProcAddr(VkDevice, const char*) { abort(); }
+	VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceFormatProperties(VkPhysicalDevice, VkFormat, VkFormatProperties*) { abort(); }
+	VKAPI_ATTR VkResult VKAPI_CALL vkCreateImage(VkDevice, const VkImageCreateInfo*, const VkAllocationCallbacks*, VkImage*) { abort(); }
+	VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements(VkDevice, VkImage, VkMemoryRequirements*) { abort(); }
+	VKAPI_ATTR VkResult VKAPI_CALL vkBindImageMemory(VkDevice, VkImage, VkDeviceMemory, VkDeviceSize) { abort(); }
+	VKAPI_ATTR void VKAPI_CALL vkCmdCopyBufferToImage(VkCommandBuffer, VkBuffer, VkImage, VkImageLayout, uint32_t, const VkBufferImageCopy*) { abort(); }
+	VKAPI_ATTR VkResult VKAPI_CALL vkCreateShaderModule(VkDevice, const VkShaderModuleCreateInfo*, const VkAllocationCallbacks*, VkShaderModule*) { abort(); }
+}
+
+int main()
+{
+	vks::VulkanDevice device(reinterpret_cast<VkPhysicalDevice>(nextHandle += 0x10));
+	device.timelineFunctions.getSemaphoreCounterValue = getSemaphoreCounterValue;
+	device.timelineFunctions.waitSemaphores = waitSemaphores;
+	device.memoryAllocator.create(device.physicalDevice, device.logicalDevice);
+	vks::StagingRing ring;
+	ring.create(&device, reinterpret_cast<VkQueue>(nextHandle += 0x10), 0, 1024);
+
+	// Hold a takes the front of the ring, hold b the space after it, but b is submitted (and finishes) first
+	vks::StagingRing::Hold a, b;
+	vks::StagingRing::Region region;
+	CHECK(ring.tryAllocate(400, 16, &region, &a) && (region.offset == 0));
+	CHECK(ring.tryAllocate(400, 16, &region, &b) && (region.offset == 400));
+	const uint64_t valueB = ring.submitBatch(&b, [](VkCommandBuffer) {});
+	const uint64_t valueA = ring.submitBatch(&a, [](VkCommandBuffer) {});
+	CHECK(valueB < valueA);
+
+	// b has finished, but a still copies from the front of the ring, none of its space may be handed out again
+	reachedValue = valueB;
+	vks::StagingRing::Hold c;
+	CHECK(ring.used() == 800);
+	CHECK(!ring.tryAllocate(400, 16, &region, &c));
+	CHECK(ring.tryAllocate(200, 16, &region, &c) && (region.offset == 800));
+	const uint64_t valueC = ring.submitBatch(&c, [](VkCommandBuffer) {});
+
+	// Once a has finished only c's region is in use, and once c has finished the whole ring is available again
+	reachedValue = valueA;
+	vks::StagingRing::Hold d;
+	CHECK(!ring.tryAllocate(1024, 16, &region, &d));
+	CHECK(ring.used() == 200);
+	reachedValue = valueC;
+	CHECK(ring.tryAllocate(1024, 16, &region, &d) && (region.offset == 0));
+	reachedValue = ring.submitBatch(&d, [](VkCommandBuffer) {});
+
+	ring.destroy();
+	puts("staging ring: ok");
+	return EXIT_SUCCESS;
+}
@@ -4,29 +4,45 @@
 #include <iostream>
 #include "Triangle.h"
 
+std::shared_ptr<VulkanExample> vulkanExample;
+
+#if defined(_WIN32)
 LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
-	/*if (vulkanExample != NULL)
+	if (vulkanExample)
 	{
 		vulkanExample->handleMessages(hWnd, uMsg, wParam, lParam);
-	}*/
+	}
 	return (DefWindowProc(hWnd, uMsg, wParam, lParam));
 }
 
 int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR pCmdLine, int nCmdShow)
 {
-	std::shared_ptr<VulkanExample> vulkanExample = std::make_shared<VulkanExample>();
+	for (int32_t i = 0; i < __argc; i++) { VulkanBase::args.push_back(__argv[i]); };
+	vulkanExample = std::make_shared<VulkanExample>();
 
 	vulkanExample->initVulkan();
-	vulkanExample->setupWindow(hInstance, WndProc);
+	if (!vulkanExample->settings.headless) {
+		vulkanExample->setupWindow(hInstance, WndProc);
+	}
 
 	vulkanExample->prepare();
-	while (true)
-	{
-		vulkanExample->render();
-	}
+	vulkanExample->renderLoop();
+	return 0;
+}
+#else
+// Other platforms have no window system integration and always run headless (e.g. benchmarking on a software implementation like lavapipe)
+int main(const int argc, const char* argv[])
+{
+	for (int32_t i = 0; i < argc; i++) { VulkanBase::args.push_back(argv[i]); };
+	vulkanExample = std::make_shared<VulkanExample>();
+
+	vulkanExample->initVulkan();
+	vulkanExample->prepare();
+	vulkanExample->renderLoop();
 	return 0;
 }
+#endif
 //int main()
 //{
 //    std::cout << "Hello World!\n";